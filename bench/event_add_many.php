@@ -0,0 +1,42 @@
+<?php
+/* adding and deleting many events: one call per event against event_add_many()
+ *
+ *   php bench/event_add_many.php [events] [rounds]
+ */
+
+$n = isset($argv[1]) ? (int)$argv[1] : 100000;
+$rounds = isset($argv[2]) ? (int)$argv[2] : 10;
+
+function noop($fd, $events, $arg)
+{
+}
+
+$base = event_base_new();
+$events = array();
+for ($i = 0; $i < $n; $i++) {
+	$event = event_new();
+	event_timer_set($event, "noop");
+	event_base_set($event, $base);
+	$events[] = $event;
+}
+
+$start = microtime(true);
+for ($r = 0; $r < $rounds; $r++) {
+	foreach ($events as $event) {
+		event_add($event, 60000000);
+	}
+	foreach ($events as $event) {
+		event_del($event);
+	}
+}
+$single = microtime(true) - $start;
+
+$start = microtime(true);
+for ($r = 0; $r < $rounds; $r++) {
+	event_add_many($events, 60000000);
+	event_del_many($events);
+}
+$many = microtime(true) - $start;
+
+printf("%-16s %8d events x %d %8.3f s %10.0f ops/s\n", "event_add/del", $n, $rounds, $single, 2 * $n * $rounds / $single);
+printf("%-16s %8d events x %d %8.3f s %10.0f ops/s\n", "event_*_many", $n, $rounds, $many, 2 * $n * $rounds / $many);
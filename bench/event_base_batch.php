@@ -0,0 +1,58 @@
+<?php
+/* many ready fds per loop iteration: one PHP call per event against one per iteration,
+ * each fd is a socket pair so mind the open files limit
+ *
+ *   php bench/event_base_batch.php [fds] [iterations]
+ */
+
+$nfds = isset($argv[1]) ? (int)$argv[1] : 400;
+$iterations = isset($argv[2]) ? (int)$argv[2] : 1000;
+
+function on_ready($fd, $events, $arg)
+{
+	global $count;
+
+	++$count;
+}
+
+function on_batch($batch)
+{
+	global $count;
+
+	$count += count($batch);
+}
+
+/* the peers never read, so every socket stays writable */
+$pairs = array();
+for ($i = 0; $i < $nfds; $i++) {
+	$pairs[] = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+}
+
+foreach (array("per event", "batched") as $mode) {
+	$base = event_base_new();
+	$events = array();
+	foreach ($pairs as $i => $pair) {
+		$event = event_new();
+		event_set($event, $pair[0], EV_WRITE | EV_PERSIST, "on_ready", $i);
+		event_base_set($event, $base);
+		event_add($event);
+		$events[] = $event;
+	}
+	if ($mode == "batched") {
+		event_base_set_batch_callback($base, "on_batch");
+	}
+
+	$count = 0;
+	$start = microtime(true);
+	for ($i = 0; $i < $iterations; $i++) {
+		event_base_loop($base, EVLOOP_ONCE);
+	}
+	$elapsed = microtime(true) - $start;
+
+	printf("%-10s %6d fds %10d events %8.3f s %10.0f events/s\n", $mode, $nfds, $count, $elapsed, $count / $elapsed);
+
+	foreach ($events as $event) {
+		event_free($event);
+	}
+	event_base_free($base);
+}
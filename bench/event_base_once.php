@@ -0,0 +1,50 @@
+<?php
+/* one-shot timers through event_base_once() against event_new() + event_add()
+ *
+ *   php bench/event_base_once.php [timers]
+ */
+
+$n = isset($argv[1]) ? (int)$argv[1] : 1000000;
+$fired = 0;
+
+function on_timer($fd, $events, $arg)
+{
+	global $fired;
+
+	++$fired;
+}
+
+function report($name, $n, $start, $memory)
+{
+	$elapsed = microtime(true) - $start;
+	printf("%-12s %8d timers %8.3f s %10.0f timers/s %8.1f MB\n",
+		$name, $n, $elapsed, $n / $elapsed, (memory_get_peak_usage() - $memory) / 1048576);
+}
+
+$base = event_base_new();
+$memory = memory_get_usage();
+$start = microtime(true);
+for ($i = 0; $i < $n; $i++) {
+	event_base_once($base, -1, EV_TIMEOUT, $i % 1000, "on_timer", $i);
+}
+event_base_loop($base);
+report("base_once", $fired, $start, $memory);
+event_base_free($base);
+
+$fired = 0;
+$base = event_base_new();
+$memory = memory_get_usage();
+$start = microtime(true);
+$events = array();
+for ($i = 0; $i < $n; $i++) {
+	$event = event_new();
+	event_timer_set($event, "on_timer", $i);
+	event_base_set($event, $base);
+	event_add($event, $i % 1000);
+	$events[] = $event;
+}
+event_base_loop($base);
+foreach ($events as $event) {
+	event_free($event);
+}
+report("event_new", $fired, $start, $memory);
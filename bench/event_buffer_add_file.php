@@ -0,0 +1,77 @@
+<?php
+/* serving a large local file over loopback: fread() plus event_buffer_write()
+ * from the write callback against one event_buffer_add_file() call
+ *
+ *   php bench/event_buffer_add_file.php [megabytes] [rounds]
+ */
+
+$size = (isset($argv[1]) ? (int)$argv[1] : 256) << 20;
+$rounds = isset($argv[2]) ? (int)$argv[2] : 4;
+
+$path = tempnam(sys_get_temp_dir(), "evbench");
+$fp = fopen($path, "w");
+$chunk = str_repeat("0123456789abcdef", 1 << 12);
+for ($written = 0; $written < $size; $written += strlen($chunk)) {
+	fwrite($fp, $chunk);
+}
+fclose($fp);
+$size = filesize($path);
+
+function serve($path, $size, $zero_copy)
+{
+	$base = event_base_new();
+	$server = stream_socket_server("tcp://127.0.0.1:0", $errno, $errstr);
+	$client = stream_socket_client("tcp://" . stream_socket_get_name($server, false));
+	$conn = stream_socket_accept($server);
+	stream_set_blocking($client, 0);
+	stream_set_blocking($conn, 0);
+
+	$file = fopen($path, "r");
+	$error = function () {};
+
+	if ($zero_copy) {
+		$bevent = event_buffer_new($conn, NULL, NULL, $error);
+		event_buffer_add_file($bevent, $file, 0);
+	} else {
+		/* refill whenever the output has drained, as a PHP file server would */
+		$bevent = event_buffer_new($conn, NULL, function ($bevent) use ($file) {
+			if (!feof($file)) {
+				event_buffer_write($bevent, fread($file, 1 << 16));
+			}
+		}, $error);
+		event_buffer_write($bevent, fread($file, 1 << 16));
+	}
+	event_buffer_base_set($bevent, $base);
+
+	$received = 0;
+	$reader = event_new();
+	event_set($reader, $client, EV_READ | EV_PERSIST, function ($fd) use ($base, $size, &$received) {
+		$received += strlen(fread($fd, 1 << 20));
+		if ($received >= $size) {
+			event_base_loopexit($base);
+		}
+	});
+	event_base_set($reader, $base);
+	event_add($reader);
+	event_base_loop($base);
+
+	event_del($reader);
+	event_buffer_free($bevent);
+	fclose($file);
+	event_base_free($base);
+
+	return $received;
+}
+
+foreach (array("fread+write" => false, "add_file" => true) as $mode => $zero_copy) {
+	$total = 0;
+	$start = microtime(true);
+	for ($i = 0; $i < $rounds; $i++) {
+		$total += serve($path, $size, $zero_copy);
+	}
+	$elapsed = microtime(true) - $start;
+
+	printf("%-12s %8d MB %8.3f s %10.1f MB/s\n", $mode, $total >> 20, $elapsed, ($total >> 20) / $elapsed);
+}
+
+unlink($path);
@@ -0,0 +1,65 @@
+<?php
+/* proxy throughput: event_buffer_pipe() against relaying in a PHP read callback
+ *
+ *   php bench/event_buffer_pipe.php [megabytes]
+ */
+
+$total = (isset($argv[1]) ? (int)$argv[1] : 512) << 20;
+
+function proxy($total, $piped)
+{
+	$base = event_base_new();
+	list($client, $in) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	list($out, $server) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	foreach (array($client, $in, $out, $server) as $stream) {
+		stream_set_blocking($stream, 0);
+	}
+
+	$error = function () {};
+	$a = event_buffer_new($in, NULL, NULL, $error);
+	$b = event_buffer_new($out, NULL, NULL, $error);
+	event_buffer_base_set($a, $base);
+	event_buffer_base_set($b, $base);
+
+	if ($piped) {
+		$pipe = event_buffer_pipe($a, $b, $error);
+	} else {
+		event_buffer_set_callback($a, function ($bevent) use ($b) {
+			event_buffer_write($b, event_buffer_read($bevent, 1 << 20));
+		}, NULL, $error);
+		event_buffer_enable($a, EV_READ);
+		event_buffer_enable($b, EV_WRITE);
+	}
+
+	$chunk = str_repeat("x", 1 << 16);
+	$sent = $received = 0;
+
+	$writer = event_new();
+	event_set($writer, $client, EV_WRITE | EV_PERSIST, function ($fd) use ($total, $chunk, &$sent, &$writer) {
+		$sent += (int)fwrite($fd, $chunk, min(strlen($chunk), $total - $sent));
+		if ($sent >= $total) {
+			event_del($writer);
+		}
+	});
+	event_base_set($writer, $base);
+	event_add($writer);
+
+	$reader = event_new();
+	event_set($reader, $server, EV_READ | EV_PERSIST, function ($fd) use ($base, $total, &$received) {
+		$received += strlen(fread($fd, 1 << 16));
+		if ($received >= $total) {
+			event_base_loopexit($base);
+		}
+	});
+	event_base_set($reader, $base);
+	event_add($reader);
+
+	$start = microtime(true);
+	event_base_loop($base);
+	$elapsed = microtime(true) - $start;
+
+	printf("%-8s %6d MB %8.3f s %8.1f MB/s\n", $piped ? "pipe" : "php", $received >> 20, $elapsed, ($received >> 20) / $elapsed);
+}
+
+proxy($total, false);
+proxy($total, true);
@@ -0,0 +1,62 @@
+<?php
+/* many-part responses: implode() plus event_buffer_write() against
+ * event_buffer_write_array(), with a header block, a few small fragments
+ * and a body of the given size per response
+ *
+ *   php bench/event_buffer_write_array.php [responses] [parts] [body kilobytes]
+ */
+
+$responses = isset($argv[1]) ? (int)$argv[1] : 20000;
+$nparts = isset($argv[2]) ? (int)$argv[2] : 16;
+$body_size = (isset($argv[3]) ? (int)$argv[3] : 64) << 10;
+
+$parts = array("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n");
+for ($i = 1; $i < $nparts - 1; $i++) {
+	$parts[] = str_repeat(chr(ord("a") + $i % 26), 16 << ($i % 8));
+}
+$parts[] = str_repeat("x", $body_size);
+$response_len = strlen(implode("", $parts));
+
+foreach (array("implode", "write_array") as $mode) {
+	$base = event_base_new();
+	list($local, $remote) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	stream_set_blocking($remote, 0);
+
+	$sent = 0;
+	$send = function ($bevent) use ($mode, $parts, $responses, &$sent) {
+		if ($sent++ < $responses) {
+			if ($mode == "write_array") {
+				event_buffer_write_array($bevent, $parts);
+			} else {
+				event_buffer_write($bevent, implode("", $parts));
+			}
+		}
+	};
+	/* queue the next response whenever the previous one has drained */
+	$bevent = event_buffer_new($local, NULL, $send, function () {});
+	event_buffer_base_set($bevent, $base);
+	$send($bevent);
+
+	$total = $responses * $response_len;
+	$received = 0;
+	$reader = event_new();
+	event_set($reader, $remote, EV_READ | EV_PERSIST, function ($fd) use ($base, $total, &$received) {
+		$received += strlen(fread($fd, 1 << 20));
+		if ($received >= $total) {
+			event_base_loopexit($base);
+		}
+	});
+	event_base_set($reader, $base);
+	event_add($reader);
+
+	$start = microtime(true);
+	event_base_loop($base);
+	$elapsed = microtime(true) - $start;
+
+	printf("%-12s %8d responses %4d parts %8.3f s %10.0f responses/s %8.1f MB/s\n",
+		$mode, $responses, $nparts, $elapsed, $responses / $elapsed, ($received >> 20) / $elapsed);
+
+	event_del($reader);
+	event_buffer_free($bevent);
+	event_base_free($base);
+}
@@ -0,0 +1,61 @@
+<?php
+/* callback dispatch rate of a persistent, always ready event, per kind of callable
+ *
+ *   php bench/event_dispatch.php [dispatches]
+ */
+
+$n = isset($argv[1]) ? (int)$argv[1] : 1000000;
+
+function on_ready($fd, $events, $arg)
+{
+	global $count, $base;
+
+	if (++$count == $arg) {
+		event_base_loopbreak($base);
+	}
+}
+
+class Handler
+{
+	public function onReady($fd, $events, $arg)
+	{
+		on_ready($fd, $events, $arg);
+	}
+
+	public static function onReadyStatic($fd, $events, $arg)
+	{
+		on_ready($fd, $events, $arg);
+	}
+}
+
+$kinds = array(
+	"function" => "on_ready",
+	"static" => "Handler::onReadyStatic",
+	"method" => array(new Handler, "onReady"),
+	"closure" => function ($fd, $events, $arg) {
+		on_ready($fd, $events, $arg);
+	},
+);
+
+/* the peer never reads, so the socket stays writable */
+list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+
+foreach ($kinds as $name => $callback) {
+	$base = event_base_new();
+	$event = event_new();
+	event_set($event, $a, EV_WRITE | EV_PERSIST, $callback, $n);
+	event_base_set($event, $base);
+	event_add($event);
+
+	$count = 0;
+	$memory = memory_get_usage();
+	$start = microtime(true);
+	event_base_loop($base);
+	$elapsed = microtime(true) - $start;
+
+	printf("%-10s %8d calls %8.3f s %10.0f calls/s %8d bytes retained\n",
+		$name, $count, $elapsed, $count / $elapsed, memory_get_usage() - $memory);
+
+	event_free($event);
+	event_base_free($base);
+}
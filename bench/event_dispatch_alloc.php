@@ -0,0 +1,76 @@
+<?php
+/* argument zvals allocated per callback once the base has warmed up, for
+ * stream events, timers and buffer event reads
+ *
+ *   php bench/event_dispatch_alloc.php [callbacks]
+ */
+
+$n = isset($argv[1]) ? (int)$argv[1] : 200000;
+
+function run($base, $name, $n, &$count)
+{
+	/* the first callbacks fill the spare zvals of the base */
+	$count = 0;
+	$warmup = min(100, $n);
+	while ($count < $warmup) {
+		event_base_loop($base, EVLOOP_ONCE);
+	}
+	event_base_stats($base, true);
+
+	$count = 0;
+	$memory = memory_get_usage();
+	$start = microtime(true);
+	while ($count < $n) {
+		event_base_loop($base, EVLOOP_ONCE);
+	}
+	$elapsed = microtime(true) - $start;
+	$stats = event_base_stats($base);
+
+	printf("%-8s %8d calls %10.0f calls/s %6d args allocated %8.4f per call %8d bytes retained\n",
+		$name, $count, $count / $elapsed, $stats["args_allocated"], $stats["args_allocated"] / $count, memory_get_usage() - $memory);
+}
+
+/* the peer never reads, so the socket stays writable */
+list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+
+$base = event_base_new();
+$event = event_new();
+event_set($event, $a, EV_WRITE | EV_PERSIST, function ($fd, $events, $arg) use (&$count) {
+	++$count;
+});
+event_base_set($event, $base);
+event_add($event);
+run($base, "stream", $n, $count);
+event_free($event);
+event_base_free($base);
+
+$base = event_base_new();
+$timer = event_new();
+event_timer_set($timer, function ($fd, $events, $timer) use (&$count) {
+	++$count;
+	event_add($timer, 0);
+}, $timer);
+event_base_set($timer, $base);
+event_add($timer, 0);
+run($base, "timer", $n, $count);
+event_del($timer);
+event_free($timer);
+event_base_free($base);
+
+/* every write on one side is a read callback on the other */
+$base = event_base_new();
+list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+$writer = event_buffer_new($a, NULL, NULL, function () {});
+$reader = event_buffer_new($b, function ($bevent, $writer) use (&$count) {
+	event_buffer_read($bevent, 16);
+	event_buffer_write($writer, "x");
+	++$count;
+}, NULL, function () {}, $writer);
+event_buffer_base_set($writer, $base);
+event_buffer_base_set($reader, $base);
+event_buffer_enable($reader, EV_READ);
+event_buffer_write($writer, "x");
+run($base, "buffer", $n, $count);
+event_buffer_free($reader);
+event_buffer_free($writer);
+event_base_free($base);
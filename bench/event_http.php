@@ -0,0 +1,109 @@
+<?php
+/* keep-alive requests/s over loopback: event_http_new() against a userland
+ * HTTP/1.1 parser on bufferevents; the clients run on the same base and keep
+ * one request in flight per connection
+ *
+ *   php bench/event_http.php [connections] [seconds]
+ */
+
+$nconns = isset($argv[1]) ? (int)$argv[1] : 32;
+$seconds = isset($argv[2]) ? (int)$argv[2] : 5;
+
+$request = "GET /hello?name=world HTTP/1.1\r\nHost: localhost\r\nUser-Agent: bench\r\nAccept: */*\r\nX-Request-Id: 12345\r\n\r\n";
+
+/* parses what arrived on a server connection and answers every complete request */
+function userland_read($bevent, $arg)
+{
+	global $buffers;
+
+	$id = (int)$bevent;
+	$buffers[$id] .= event_buffer_read($bevent, 65536);
+
+	while (($end = strpos($buffers[$id], "\r\n\r\n")) !== false) {
+		$lines = explode("\r\n", substr($buffers[$id], 0, $end));
+		list($method, $uri, $version) = explode(" ", array_shift($lines), 3);
+		$headers = array();
+		foreach ($lines as $line) {
+			list($name, $value) = explode(":", $line, 2);
+			$headers[strtolower($name)] = trim($value);
+		}
+		$length = isset($headers["content-length"]) ? (int)$headers["content-length"] : 0;
+		if (strlen($buffers[$id]) < $end + 4 + $length) {
+			break;
+		}
+		$body = substr($buffers[$id], $end + 4, $length);
+		$buffers[$id] = (string)substr($buffers[$id], $end + 4 + $length);
+
+		$reply = "$method $uri";
+		event_buffer_write($bevent, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " . strlen($reply) . "\r\n\r\n" . $reply);
+	}
+}
+
+function userland_accept($listener, $conns)
+{
+	global $buffers, $server_conns;
+
+	foreach ($conns as $conn) {
+		$buffers[(int)$conn[0]] = "";
+		$server_conns[] = $conn[0];
+	}
+}
+
+function evhttp_handler($req)
+{
+	event_http_request_add_header($req, "Content-Type", "text/plain");
+	event_http_send_reply($req, 200, event_http_request_get_method($req) . " " . event_http_request_get_uri($req));
+}
+
+foreach (array("userland", "evhttp") as $mode) {
+	$base = event_base_new();
+	$server = stream_socket_server("tcp://127.0.0.1:0", $errno, $errstr);
+	$addr = stream_socket_get_name($server, false);
+	$buffers = $server_conns = array();
+
+	if ($mode == "evhttp") {
+		$http = event_http_new($base, "evhttp_handler");
+		event_http_accept($http, $server);
+	} else {
+		$listener = event_listener_new($base, $server, "userland_accept", "userland_read", NULL, function () {});
+	}
+
+	$count = 0;
+	$clients = $received = array();
+	for ($i = 0; $i < $nconns; $i++) {
+		$conn = stream_socket_client("tcp://$addr");
+		stream_set_blocking($conn, 0);
+		$received[$i] = "";
+		$clients[$i] = event_buffer_new($conn, function ($bevent, $i) use ($request, &$received, &$count) {
+			$received[$i] .= event_buffer_read($bevent, 65536);
+			/* every response carries a Content-Length */
+			while (($end = strpos($received[$i], "\r\n\r\n")) !== false
+					&& preg_match("/^Content-Length: *(\d+)/mi", substr($received[$i], 0, $end), $m)
+					&& strlen($received[$i]) >= $end + 4 + $m[1]) {
+				$received[$i] = (string)substr($received[$i], $end + 4 + $m[1]);
+				++$count;
+				event_buffer_write($bevent, $request);
+			}
+		}, NULL, function () {}, $i);
+		event_buffer_base_set($clients[$i], $base);
+		event_buffer_enable($clients[$i], EV_READ);
+		event_buffer_write($clients[$i], $request);
+	}
+
+	$start = microtime(true);
+	event_base_loopexit($base, $seconds * 1000000);
+	event_base_loop($base);
+	$elapsed = microtime(true) - $start;
+
+	printf("%-10s %4d connections %10d requests %8.3f s %10.0f requests/s\n", $mode, $nconns, $count, $elapsed, $count / $elapsed);
+
+	foreach ($clients as $client) {
+		event_buffer_free($client);
+	}
+	if ($mode == "evhttp") {
+		event_http_free($http);
+	} else {
+		event_listener_free($listener);
+	}
+	$server_conns = array();
+}
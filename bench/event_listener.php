@@ -0,0 +1,76 @@
+<?php
+/* connections/s through event_listener_new() against event_set() plus
+ * stream_socket_accept() and event_buffer_new() per connection; the clients
+ * connect in bursts from this process and are closed once all are accepted
+ *
+ *   php bench/event_listener.php [burst] [rounds]
+ */
+
+$burst = isset($argv[1]) ? (int)$argv[1] : 100;
+$rounds = isset($argv[2]) ? (int)$argv[2] : 200;
+
+function on_read($bevent, $arg)
+{
+}
+
+function on_accept($fd, $events, $arg)
+{
+	global $base, $accepted;
+
+	/* one connection per wakeup, as a PHP accept loop usually does */
+	$conn = stream_socket_accept($fd, 0);
+	$bevent = event_buffer_new($conn, "on_read", NULL, "on_read");
+	event_buffer_base_set($bevent, $base);
+	event_buffer_enable($bevent, EV_READ);
+	$accepted[] = array($bevent, $conn);
+}
+
+function on_listener($listener, $conns, $arg, $errno)
+{
+	global $accepted;
+
+	foreach ($conns as $conn) {
+		$accepted[] = $conn;
+	}
+}
+
+foreach (array("php accept", "listener") as $mode) {
+	$base = event_base_new();
+	$server = stream_socket_server("tcp://127.0.0.1:0", $errno, $errstr, STREAM_SERVER_BIND | STREAM_SERVER_LISTEN);
+	$addr = stream_socket_get_name($server, false);
+
+	if ($mode == "listener") {
+		$listener = event_listener_new($base, $server, "on_listener", "on_read", NULL, "on_read", NULL, $burst);
+	} else {
+		stream_set_blocking($server, 0);
+		$event = event_new();
+		event_set($event, $server, EV_READ | EV_PERSIST, "on_accept");
+		event_base_set($event, $base);
+		event_add($event);
+	}
+
+	$total = 0;
+	$start = microtime(true);
+	for ($i = 0; $i < $rounds; $i++) {
+		$clients = array();
+		for ($j = 0; $j < $burst; $j++) {
+			$clients[] = stream_socket_client("tcp://$addr", $errno, $errstr, 1, STREAM_CLIENT_CONNECT | STREAM_CLIENT_ASYNC_CONNECT);
+		}
+		$accepted = array();
+		while (count($accepted) < $burst) {
+			event_base_loop($base, EVLOOP_ONCE);
+		}
+		$total += count($accepted);
+		$accepted = $clients = array();
+	}
+	$elapsed = microtime(true) - $start;
+
+	printf("%-10s %6d burst %10d conns %8.3f s %10.0f conns/s\n", $mode, $burst, $total, $elapsed, $total / $elapsed);
+
+	if ($mode == "listener") {
+		event_listener_free($listener);
+	} else {
+		event_free($event);
+	}
+	event_base_free($base);
+}
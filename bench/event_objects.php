@@ -0,0 +1,85 @@
+<?php
+/* hot path calls through the functions on resources against the methods of
+ * the objects: event add/del pairs, and buffer event writes read back
+ *
+ *   php bench/event_objects.php [calls] [bytes per write]
+ */
+
+$n = isset($argv[1]) ? (int)$argv[1] : 1000000;
+$size = isset($argv[2]) ? (int)$argv[2] : 64;
+$data = str_repeat("x", $size);
+
+function report($name, $calls, $elapsed)
+{
+	printf("%-18s %8d calls %8.3f s %10.0f calls/s\n", $name, $calls, $elapsed, $calls / $elapsed);
+}
+
+foreach (array("functions", "methods") as $mode) {
+	$objects = $mode == "methods";
+	$base = $objects ? new EventBase() : event_base_new();
+	list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+
+	$event = $objects ? new Event() : event_new();
+	if ($objects) {
+		$event->setTimer(function () {});
+		$event->setBase($base);
+	} else {
+		event_timer_set($event, function () {});
+		event_base_set($event, $base);
+	}
+
+	$start = microtime(true);
+	if ($objects) {
+		for ($i = 0; $i < $n; $i++) {
+			$event->add(1000000);
+			$event->del();
+		}
+	} else {
+		for ($i = 0; $i < $n; $i++) {
+			event_add($event, 1000000);
+			event_del($event);
+		}
+	}
+	report("$mode add+del", $n * 2, microtime(true) - $start);
+
+	/* writes pile up in the output buffer until the loop moves them to the reader */
+	$writer = $objects ? new BufferEvent($a, NULL, NULL, function () {}) : event_buffer_new($a, NULL, NULL, function () {});
+	$reader = $objects ? new BufferEvent($b, NULL, NULL, function () {}) : event_buffer_new($b, NULL, NULL, function () {});
+	if ($objects) {
+		$writer->setBase($base);
+		$reader->setBase($base);
+		$reader->enable(EV_READ);
+	} else {
+		event_buffer_base_set($writer, $base);
+		event_buffer_base_set($reader, $base);
+		event_buffer_enable($reader, EV_READ);
+	}
+
+	$start = microtime(true);
+	for ($done = 0; $done < $n; $done += $batch) {
+		$batch = min(1000, $n - $done);
+		if ($objects) {
+			for ($i = 0; $i < $batch; $i++) {
+				$writer->write($data);
+			}
+		} else {
+			for ($i = 0; $i < $batch; $i++) {
+				event_buffer_write($writer, $data);
+			}
+		}
+		/* the same number of reads either way, each taking one write */
+		for ($left = $batch; $left > 0; ) {
+			event_base_loop($base, EVLOOP_ONCE);
+			if ($objects) {
+				while ($left > 0 && $reader->read($size) != "") {
+					$left--;
+				}
+			} else {
+				while ($left > 0 && event_buffer_read($reader, $size) != "") {
+					$left--;
+				}
+			}
+		}
+	}
+	report("$mode write+read", $n * 2, microtime(true) - $start);
+}
@@ -0,0 +1,35 @@
+<?php
+/* event churn, as with short lived connections: create, arm, delete and free events
+ *
+ *   php bench/event_pool.php [events] [live]
+ */
+
+$n = isset($argv[1]) ? (int)$argv[1] : 1000000;
+$live = isset($argv[2]) ? (int)$argv[2] : 1000;
+
+function on_timeout($fd, $events, $arg)
+{
+}
+
+$base = event_base_new();
+$ring = array_fill(0, $live, null);
+$memory = memory_get_usage();
+$start = microtime(true);
+for ($i = 0; $i < $n; $i++) {
+	$slot = $i % $live;
+	if ($ring[$slot]) {
+		event_del($ring[$slot]);
+		event_free($ring[$slot]);
+	}
+	$event = event_new();
+	event_timer_set($event, "on_timeout", $i);
+	event_base_set($event, $base);
+	event_add($event, 60000000);
+	$ring[$slot] = $event;
+}
+$elapsed = microtime(true) - $start;
+
+$stats = event_pool_stats();
+printf("%8d events, %d live %8.3f s %10.0f events/s %8d bytes retained\n",
+	$n, $live, $elapsed, $n / $elapsed, memory_get_usage() - $memory);
+printf("pool: %d hits, %d misses, %d slabs of %d bytes\n", $stats["hits"], $stats["misses"], $stats["slabs"], $stats["slab_size"]);
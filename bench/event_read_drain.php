@@ -0,0 +1,58 @@
+<?php
+/* reading a busy socket: level-triggered fread() against edge-triggered event_read_drain()
+ *
+ *   php bench/event_read_drain.php [megabytes]
+ */
+
+$total = (isset($argv[1]) ? (int)$argv[1] : 512) << 20;
+
+function run($total, $edge)
+{
+	$base = event_base_new();
+	list($writer, $reader) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	stream_set_blocking($writer, 0);
+	stream_set_blocking($reader, 0);
+
+	$chunk = str_repeat("x", 1 << 16);
+	$sent = $received = $wakeups = 0;
+
+	$out = event_new();
+	event_set($out, $writer, EV_WRITE | EV_PERSIST, function ($fd) use ($total, $chunk, &$sent, &$out) {
+		$sent += (int)fwrite($fd, $chunk, min(strlen($chunk), $total - $sent));
+		if ($sent >= $total) {
+			event_del($out);
+		}
+	});
+	event_base_set($out, $base);
+	event_add($out);
+
+	$in = event_new();
+	if ($edge) {
+		event_set($in, $reader, EV_READ | EV_PERSIST | EV_ET, function ($fd) use ($base, $total, &$received, &$wakeups) {
+			++$wakeups;
+			$received += strlen(event_read_drain($fd));
+			if ($received >= $total) {
+				event_base_loopexit($base);
+			}
+		});
+	} else {
+		event_set($in, $reader, EV_READ | EV_PERSIST, function ($fd) use ($base, $total, &$received, &$wakeups) {
+			++$wakeups;
+			$received += strlen(fread($fd, 8192));
+			if ($received >= $total) {
+				event_base_loopexit($base);
+			}
+		});
+	}
+	event_base_set($in, $base);
+	event_add($in);
+
+	$start = microtime(true);
+	event_base_loop($base);
+	$elapsed = microtime(true) - $start;
+
+	printf("%-6s %6d MB %8.3f s %8.1f MB/s %10d wakeups\n", $edge ? "drain" : "fread", $received >> 20, $elapsed, ($received >> 20) / $elapsed, $wakeups);
+}
+
+run($total, false);
+run($total, true);
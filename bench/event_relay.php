@@ -0,0 +1,79 @@
+<?php
+/* CPU per GB relayed over loopback TCP: event_relay_new() with splice()
+ * against event_buffer_pipe(), which copies through evbuffers; both ends
+ * are driven from this process and counted in for either mode
+ *
+ *   php bench/event_relay.php [megabytes]
+ */
+
+$total = (isset($argv[1]) ? (int)$argv[1] : 1024) << 20;
+
+function tcp_pair()
+{
+	$server = stream_socket_server("tcp://127.0.0.1:0", $errno, $errstr);
+	$client = stream_socket_client("tcp://" . stream_socket_get_name($server, false));
+	$conn = stream_socket_accept($server);
+	fclose($server);
+	stream_set_blocking($client, 0);
+	stream_set_blocking($conn, 0);
+	return array($client, $conn);
+}
+
+function cpu_time()
+{
+	$usage = getrusage();
+	return $usage["ru_utime.tv_sec"] + $usage["ru_utime.tv_usec"] / 1e6 + $usage["ru_stime.tv_sec"] + $usage["ru_stime.tv_usec"] / 1e6;
+}
+
+function relay($total, $mode)
+{
+	$base = event_base_new();
+	list($client, $in) = tcp_pair();
+	list($out, $server) = tcp_pair();
+
+	$error = function () {};
+	if ($mode == "splice") {
+		$relay = event_relay_new($base, $in, $out, $error);
+	} else {
+		$a = event_buffer_new($in, NULL, NULL, $error);
+		$b = event_buffer_new($out, NULL, NULL, $error);
+		event_buffer_base_set($a, $base);
+		event_buffer_base_set($b, $base);
+		$pipe = event_buffer_pipe($a, $b, $error);
+	}
+
+	$chunk = str_repeat("x", 1 << 18);
+	$sent = $received = 0;
+
+	$writer = event_new();
+	event_set($writer, $client, EV_WRITE | EV_PERSIST, function ($fd) use ($total, $chunk, &$sent, &$writer) {
+		$sent += (int)fwrite($fd, $chunk, min(strlen($chunk), $total - $sent));
+		if ($sent >= $total) {
+			event_del($writer);
+		}
+	});
+	event_base_set($writer, $base);
+	event_add($writer);
+
+	$reader = event_new();
+	event_set($reader, $server, EV_READ | EV_PERSIST, function ($fd) use ($base, $total, &$received) {
+		$received += strlen(fread($fd, 1 << 18));
+		if ($received >= $total) {
+			event_base_loopexit($base);
+		}
+	});
+	event_base_set($reader, $base);
+	event_add($reader);
+
+	$start = microtime(true);
+	$cpu = cpu_time();
+	event_base_loop($base);
+	$cpu = cpu_time() - $cpu;
+	$elapsed = microtime(true) - $start;
+
+	$gb = $received / (1 << 30);
+	printf("%-8s %6d MB %8.3f s %8.1f MB/s %8.3f cpu s/GB\n", $mode, $received >> 20, $elapsed, ($received >> 20) / $elapsed, $cpu / $gb);
+}
+
+relay($total, "pipe");
+relay($total, "splice");
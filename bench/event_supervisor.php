@@ -0,0 +1,103 @@
+<?php
+/* loopback echo throughput of event_supervisor_run() from 1 worker up to the
+ * given number, every worker owning its own SO_REUSEPORT listener; the load is
+ * generated by forked client processes, needs the pcntl and posix extensions
+ *
+ *   php bench/event_supervisor.php [max workers] [clients] [connections per client] [seconds]
+ */
+
+$max_workers = isset($argv[1]) ? (int)$argv[1] : 4;
+$nclients = isset($argv[2]) ? (int)$argv[2] : $max_workers;
+$nconns = isset($argv[3]) ? (int)$argv[3] : 32;
+$seconds = isset($argv[4]) ? (int)$argv[4] : 5;
+
+$message = str_repeat("m", 64);
+
+/* borrow a free port for the workers to share */
+$probe = stream_socket_server("tcp://127.0.0.1:0");
+$addr = stream_socket_get_name($probe, false);
+fclose($probe);
+
+function echo_worker($base, $listener, $worker, $arg)
+{
+	$GLOBALS["worker_listener"] = event_listener_new($base, $listener, function ($listener, $conns) {
+		/* the bufferevents live as long as their callbacks do */
+		foreach ($conns as $conn) {
+			$GLOBALS["worker_conns"][(int)$conn[0]] = $conn[0];
+		}
+	}, function ($bevent) {
+		event_buffer_write($bevent, event_buffer_read($bevent, 65536));
+	}, NULL, function ($bevent) {
+		unset($GLOBALS["worker_conns"][(int)$bevent]);
+	});
+}
+
+/* keeps nconns echo round trips in flight until the time is up, returns how many completed */
+function client($addr, $nconns, $seconds, $message)
+{
+	$base = event_base_new();
+	$count = 0;
+	$bevents = $received = array();
+
+	for ($i = 0; $i < $nconns; $i++) {
+		while (!($conn = @stream_socket_client("tcp://$addr"))) {
+			usleep(10000);
+		}
+		stream_set_blocking($conn, 0);
+		$received[$i] = 0;
+		$bevents[$i] = event_buffer_new($conn, function ($bevent, $i) use ($message, &$received, &$count) {
+			$received[$i] += strlen(event_buffer_read($bevent, 65536));
+			while ($received[$i] >= strlen($message)) {
+				$received[$i] -= strlen($message);
+				++$count;
+				event_buffer_write($bevent, $message);
+			}
+		}, NULL, function () {}, $i);
+		event_buffer_base_set($bevents[$i], $base);
+		event_buffer_enable($bevents[$i], EV_READ);
+		event_buffer_write($bevents[$i], $message);
+	}
+
+	event_base_loopexit($base, $seconds * 1000000);
+	event_base_loop($base);
+
+	return $count;
+}
+
+$steps = array();
+for ($workers = 1; $workers < $max_workers; $workers *= 2) {
+	$steps[] = $workers;
+}
+$steps[] = $max_workers;
+
+foreach ($steps as $workers) {
+	$driver = pcntl_fork();
+	if ($driver == 0) {
+		$results = tempnam(sys_get_temp_dir(), "evbench");
+		$pids = array();
+		for ($i = 0; $i < $nclients; $i++) {
+			$pid = pcntl_fork();
+			if ($pid == 0) {
+				file_put_contents($results, client($addr, $nconns, $seconds, $message) . "\n", FILE_APPEND | LOCK_EX);
+				exit(0);
+			}
+			$pids[] = $pid;
+		}
+		foreach ($pids as $pid) {
+			pcntl_waitpid($pid, $status);
+		}
+
+		$total = array_sum(file($results, FILE_IGNORE_NEW_LINES));
+		unlink($results);
+		printf("%3d workers %4d connections %10d round trips %8.3f s %10.0f round trips/s\n",
+			$workers, $nclients * $nconns, $total, $seconds, $total / $seconds);
+
+		posix_kill(posix_getppid(), SIGTERM);
+		exit(0);
+	}
+
+	$base = event_base_new();
+	event_supervisor_run($base, $workers, "echo_worker", $addr);
+	event_base_free($base);
+	pcntl_waitpid($driver, $status);
+}
@@ -0,0 +1,61 @@
+<?php
+/* idle timeouts that are mostly reset before they expire, as for keepalive connections:
+ * one event per timeout against a timer wheel
+ *
+ *   php bench/event_timer_wheel.php [timeouts] [resets]
+ */
+
+$n = isset($argv[1]) ? (int)$argv[1] : 100000;
+$resets = isset($argv[2]) ? (int)$argv[2] : 10;
+$timeout = 60000000;
+
+function on_timeout($fd, $events, $arg)
+{
+}
+
+function report($name, $n, $resets, $start, $memory)
+{
+	$elapsed = microtime(true) - $start;
+	printf("%-8s %8d timeouts x %d resets %8.3f s %10.0f ops/s %8.1f MB\n",
+		$name, $n, $resets, $elapsed, $n * ($resets + 1) / $elapsed, (memory_get_usage() - $memory) / 1048576);
+}
+
+$base = event_base_new();
+$memory = memory_get_usage();
+$start = microtime(true);
+$events = array();
+for ($i = 0; $i < $n; $i++) {
+	$event = event_new();
+	event_timer_set($event, "on_timeout", $i);
+	event_base_set($event, $base);
+	event_add($event, $timeout);
+	$events[] = $event;
+}
+for ($r = 0; $r < $resets; $r++) {
+	foreach ($events as $event) {
+		event_add($event, $timeout);
+	}
+	event_base_loop($base, EVLOOP_NONBLOCK);
+}
+report("events", $n, $resets, $start, $memory);
+foreach ($events as $event) {
+	event_free($event);
+}
+unset($events);
+
+$wheel = event_timer_wheel_new($base, 100000, 1024, function ($expired, $wheel) {
+});
+$memory = memory_get_usage();
+$start = microtime(true);
+$handles = array();
+for ($i = 0; $i < $n; $i++) {
+	$handles[] = event_timer_wheel_add($wheel, $timeout, $i);
+}
+for ($r = 0; $r < $resets; $r++) {
+	foreach ($handles as $handle) {
+		event_timer_wheel_reset($wheel, $handle, $timeout);
+	}
+	event_base_loop($base, EVLOOP_NONBLOCK);
+}
+report("wheel", $n, $resets, $start, $memory);
+event_timer_wheel_free($wheel);
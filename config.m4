@@ -46,6 +46,22 @@ if test "$PHP_LIBEVENT" != "no"; then
     -L$LIBEVENT_DIR/$PHP_LIBDIR 
   ])
 
+  dnl event_get_method() of 1.4 reads a base only event_init() sets up
+  PHP_CHECK_LIBRARY($LIBNAME, event_base_get_method,
+  [
+    AC_DEFINE(HAVE_EVENT_BASE_GET_METHOD, 1, [ ])
+  ],[],[
+    -L$LIBEVENT_DIR/$PHP_LIBDIR
+  ])
+
+  PHP_CHECK_FUNC(clock_gettime, rt)
+  AC_CHECK_FUNCS([accept4 splice])
+  AC_CHECK_HEADERS([pthread.h sys/eventfd.h sys/signalfd.h])
+
+  PHP_CHECK_LIBRARY(pthread, pthread_create, [
+    PHP_ADD_LIBRARY(pthread,, LIBEVENT_SHARED_LIBADD)
+  ])
+
   PHP_ADD_EXTENSION_DEP(libevent, sockets, true)
   PHP_SUBST(LIBEVENT_SHARED_LIBADD)
   PHP_NEW_EXTENSION(libevent, libevent.c, $ext_shared)
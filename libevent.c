@@ -23,14 +23,22 @@
 #include "config.h"
 #endif
 
+#if (defined(HAVE_ACCEPT4) || defined(HAVE_SPLICE)) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE
+#endif
+
 #include "php.h"
 #include "php_ini.h"
 #include "ext/standard/info.h"
 #include "php_streams.h"
 #include "php_network.h"
+#include "zend_exceptions.h"
 #include "php_libevent.h"
 
 #include <signal.h>
+#ifdef HAVE_CLOCK_GETTIME
+# include <time.h>
+#endif
 
 #if PHP_VERSION_ID >= 50301 && (HAVE_SOCKETS || defined(COMPILE_DL_SOCKETS))
 # include "ext/sockets/php_sockets.h"
@@ -51,10 +59,45 @@ never version, so this ifdefs would go away. */
 # include <event2/event_struct.h>
 # include <event2/bufferevent.h>
 # include <event2/bufferevent_compat.h>
+# include <event2/buffer.h>
 #else
 # include <event.h>
 #endif
 
+#if defined(LIBEVENT_VERSION_NUMBER) && LIBEVENT_VERSION_NUMBER >= 0x02000000
+# define LIBEVENT_2_API
+# include <event2/dns.h>
+# include <event2/http.h>
+# include <event2/keyvalq_struct.h>
+#endif
+
+#if !defined(PHP_WIN32) && defined(SO_REUSEPORT)
+# define LIBEVENT_SUPERVISOR_SUPPORT
+# include <sys/wait.h>
+# include <sys/select.h>
+#endif
+
+#if defined(__linux__) && defined(HAVE_SPLICE)
+# define LIBEVENT_SPLICE_SUPPORT
+# include <fcntl.h>
+#endif
+
+#if defined(__linux__) && defined(HAVE_SYS_SIGNALFD_H)
+# define LIBEVENT_SIGNALFD_SUPPORT
+# include <sys/signalfd.h>
+# include <pthread.h>
+#endif
+
+#if !defined(PHP_WIN32) && defined(HAVE_PTHREAD_H)
+# define LIBEVENT_ASYNC_SUPPORT
+# include <pthread.h>
+# include <netdb.h>
+# include <arpa/inet.h>
+# ifdef HAVE_SYS_EVENTFD_H
+#  include <sys/eventfd.h>
+# endif
+#endif
+
 #if PHP_MAJOR_VERSION < 5
 # ifdef PHP_WIN32
 typedef SOCKET php_socket_t;
@@ -75,31 +118,195 @@ typedef int php_socket_t;
 # endif
 #endif
 
+ZEND_DECLARE_MODULE_GLOBALS(libevent)
+
 static int le_event_base;
 static int le_event;
 static int le_bufferevent;
+static int le_timer_wheel;
+static int le_event_listener;
+#ifdef LIBEVENT_2_API
+static int le_event_config;
+static int le_event_dns;
+static int le_event_http;
+static int le_event_http_req;
+static int le_event_rate_group;
+static int le_event_pipe;
+#endif
+#ifdef LIBEVENT_SPLICE_SUPPORT
+static int le_event_relay;
+#endif
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+static int le_event_signal_watcher;
+#endif
+
+#if PHP_MAJOR_VERSION >= 5
+static zend_class_entry *php_event_base_ce;
+static zend_class_entry *php_event_ce;
+static zend_class_entry *php_bufferevent_ce;
+/* one table per class, so that telling our objects apart takes a pointer comparison */
+static zend_object_handlers php_event_base_object_handlers;
+static zend_object_handlers php_event_object_handlers;
+static zend_object_handlers php_bufferevent_object_handlers;
+
+static void _php_event_register_classes(TSRMLS_D);
+#endif
 
 #ifdef COMPILE_DL_LIBEVENT
 ZEND_GET_MODULE(libevent)
 #endif
 
+typedef struct _php_event_batch_entry_t { /* {{{ */
+	struct _php_event_t *event;
+	int fd;
+	short events;
+} php_event_batch_entry_t;
+/* }}} */
+
+enum {
+	PHP_EVENT_CB_EVENT,
+	PHP_EVENT_CB_READ,
+	PHP_EVENT_CB_WRITE,
+	PHP_EVENT_CB_ERROR,
+	PHP_EVENT_CB_TIMER_WHEEL,
+	PHP_EVENT_CB_BATCH,
+	PHP_EVENT_CB_ACCEPT,
+	PHP_EVENT_CB_ASYNC,
+	PHP_EVENT_CB_DNS,
+	PHP_EVENT_CB_HTTP,
+	PHP_EVENT_CB_PIPE,
+	PHP_EVENT_CB_RELAY,
+	PHP_EVENT_CB_SIGNAL,
+	PHP_EVENT_CB_DEFER,
+	PHP_EVENT_CB_TYPES
+};
+
+static const char *php_event_cb_names[PHP_EVENT_CB_TYPES] = {
+	"event", "read", "write", "error", "timer_wheel", "batch", "accept", "async", "dns", "http", "pipe", "relay", "signal", "defer"
+};
+
+typedef struct _php_event_base_stats_t { /* {{{ */
+	long iterations;
+	long callbacks[PHP_EVENT_CB_TYPES];
+	int64_t callback_time;
+	int64_t callback_time_max;
+	int64_t backend_time;
+	long deferred;
+	long defer_queue_max;
+	/* callback argument zvals the spare ones could not cover */
+	long args_allocated;
+} php_event_base_stats_t;
+/* }}} */
+
+#define LIBEVENT_HISTOGRAM_BUCKETS 31
+
+/* bucket 0 counts calls shorter than 1us, bucket i calls shorter than 2^i us,
+ * the last bucket also takes everything longer */
+typedef struct _php_event_histogram_t { /* {{{ */
+	long count;
+	int64_t sum;
+	long buckets[LIBEVENT_HISTOGRAM_BUCKETS];
+} php_event_histogram_t;
+/* }}} */
+
+typedef struct _php_event_profile_t { /* {{{ */
+	HashTable callables;
+	HashTable events;
+	int64_t threshold;
+	zval *hook;
+	zend_fcall_info hookfci;
+	zend_fcall_info_cache hookfcc;
+} php_event_profile_t;
+/* }}} */
+
+/* spare callback argument zvals kept by each base */
+#define LIBEVENT_ARGS_CACHE 8
+
+/* deferred tasks run per loop iteration before the rest wait for the next one */
+#define LIBEVENT_DEFER_BUDGET 256
+
+typedef struct _php_event_task_t { /* {{{ */
+	struct _php_event_task_t *next;
+	zval *func;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+} php_event_task_t;
+/* }}} */
+
 typedef struct _php_event_base_t { /* {{{ */
 	struct event_base *base;
 	int rsrc_id;
+	zend_uint handle;
+	/* things attached to the base, each holding a reference on its owner */
 	zend_uint events;
+	/* the owner went at shutdown with things still attached, the last one frees the base */
+	int orphaned;
+	php_event_base_stats_t stats;
+	int64_t iteration_callback_time;
+	php_event_profile_t *profile;
+	int in_slow_hook;
+	zval *batchcb;
+	zend_fcall_info batchfci;
+	zend_fcall_info_cache batchfcc;
+	int batching;
+	php_event_batch_entry_t *batch;
+	int batch_len;
+	int batch_size;
+	struct _php_event_async_t *async;
+	/* argument zvals of finished callbacks, reused when the callee kept no reference */
+	zval *args_cache[LIBEVENT_ARGS_CACHE];
+	int args_cached;
+	/* pending event_base_once() callbacks, released with the base */
+	struct _php_event_once_t *once_live;
+	struct _php_event_once_t *once_free;
+	/* FIFO of deferred tasks, drained once the outermost callback returns */
+	php_event_task_t *defer_head;
+	php_event_task_t *defer_tail;
+	php_event_task_t *task_free;
+	long defer_len;
+	long defer_budget;
+	long defer_ran;
+	int draining;
+	int fcall_depth;
+	struct event defer_event;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
 } php_event_base_t;
 /* }}} */
 
+typedef struct _php_event_once_t { /* {{{ */
+	struct _php_event_once_t *next;
+	struct _php_event_once_t *prev;
+	/* owned rather than left to event_base_once(), which 2.0 never frees when the base goes first */
+	struct event event;
+	php_event_base_t *base;
+	int stream_id;
+	zval *func;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_once_t;
+/* }}} */
+
 typedef struct _php_event_callback_t { /* {{{ */
 	zval *func;
 	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
 } php_event_callback_t;
 /* }}} */
 
 typedef struct _php_event_t { /* {{{ */
 	struct event *event;
 	int rsrc_id;
-	int stream_id;
+	zend_uint handle;
+	/* the stream resource watched, handed to callbacks as is */
+	zval *stream;
 	php_event_base_t *base;
 	php_event_callback_t *callback;
 #ifdef ZTS
@@ -109,1367 +316,8673 @@ typedef struct _php_event_t { /* {{{ */
 } php_event_t;
 /* }}} */
 
+/* events are carved from slabs of cache line aligned blocks, each block
+ * holding the wrapper, the libevent struct and the callback together */
+typedef struct _php_event_block_t { /* {{{ */
+	php_event_t event;
+	struct event ev;
+	php_event_callback_t callback;
+} php_event_block_t;
+/* }}} */
+
+#define LIBEVENT_CACHE_LINE 64
+#define LIBEVENT_SLAB_BLOCKS 64
+#define LIBEVENT_BLOCK_SIZE ((sizeof(php_event_block_t) + LIBEVENT_CACHE_LINE - 1) & ~(LIBEVENT_CACHE_LINE - 1))
+#define LIBEVENT_SLAB_HEADER ((sizeof(void *) + LIBEVENT_CACHE_LINE - 1) & ~(LIBEVENT_CACHE_LINE - 1))
+
+#define PHP_EVENT_BLOCK(e) ((php_event_block_t *)(e))
+
+#ifdef LIBEVENT_2_API
+# define PHP_BEVENT_FD(be) ((int)bufferevent_getfd(be))
+#else
+# define PHP_BEVENT_FD(be) ((be)->ev_read.ev_fd)
+#endif
+
+#define LIBEVENT_DRAIN_CHUNK 8192
+#define LIBEVENT_DRAIN_MAX_LENGTH (1024 * 1024)
+
+/* below this size copying a string is cheaper than pinning it in an evbuffer chain */
+#define LIBEVENT_WRITE_REF_MIN 1024
+
 typedef struct _php_bufferevent_t { /* {{{ */
 	struct bufferevent *bevent;
 	int rsrc_id;
+	zend_uint handle;
 	php_event_base_t *base;
 	zval *readcb;
 	zval *writecb;
 	zval *errorcb;
 	zval *arg;
+	zend_fcall_info readfci;
+	zend_fcall_info_cache readfcc;
+	zend_fcall_info writefci;
+	zend_fcall_info_cache writefcc;
+	zend_fcall_info errorfci;
+	zend_fcall_info_cache errorfcc;
+	php_socket_t owned_fd;
+#ifdef LIBEVENT_2_API
+	struct ev_token_bucket_cfg *rate_cfg;
+	struct _php_event_rate_group_t *rate_group;
+	struct _php_bufferevent_t *group_prev;
+	struct _php_bufferevent_t *group_next;
+	struct _php_event_pipe_end_t *pipe_end;
+	/* the write watermarks set by the user, restored once a pipe lets go */
+	size_t write_low;
+	size_t write_high;
+#endif
 #ifdef ZTS
 	void ***thread_ctx;
 #endif
 } php_bufferevent_t;
 /* }}} */
 
-#define ZVAL_TO_BASE(zval, base) \
-	ZEND_FETCH_RESOURCE(base, php_event_base_t *, &zval, -1, "event base", le_event_base)
+#ifdef LIBEVENT_2_API
+typedef struct _php_event_rate_group_t { /* {{{ */
+	struct bufferevent_rate_limit_group *group;
+	int rsrc_id;
+	php_event_base_t *base;
+	php_bufferevent_t *members;
+	long nmembers;
+} php_event_rate_group_t;
+/* }}} */
 
-#define ZVAL_TO_EVENT(zval, event) \
-	ZEND_FETCH_RESOURCE(event, php_event_t *, &zval, -1, "event", le_event)
+/* default refill period of token buckets, in milliseconds */
+#define LIBEVENT_RATE_LIMIT_TICK 100
 
-#define ZVAL_TO_BEVENT(zval, bevent) \
-	ZEND_FETCH_RESOURCE(bevent, php_bufferevent_t *, &zval, -1, "buffer event", le_bufferevent)
+typedef struct _php_event_pipe_end_t { /* {{{ */
+	struct _php_event_pipe_t *pipe;
+	struct _php_event_pipe_end_t *peer;
+	php_bufferevent_t *bevent;
+	/* reading is paused until the peer has flushed its output */
+	int paused;
+	ev_uint64_t moved;
+} php_event_pipe_end_t;
+/* }}} */
 
-/* {{{ internal funcs */
+typedef struct _php_event_pipe_t { /* {{{ */
+	int rsrc_id;
+	php_event_pipe_end_t ends[2];
+	zval *callback;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	size_t high;
+	size_t low;
+	long pauses;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_pipe_t;
+/* }}} */
 
-static inline void _php_event_callback_free(php_event_callback_t *callback) /* {{{ */
-{
-	if (!callback) {
-		return;
-	}
+/* default watermarks of the output a pipe writes to */
+#define LIBEVENT_PIPE_HIGH (256 * 1024)
+#define LIBEVENT_PIPE_LOW (64 * 1024)
+#endif
 
-	zval_ptr_dtor(&callback->func);
-	if (callback->arg) {
-		zval_ptr_dtor(&callback->arg);
-	}
-	efree(callback);
-}
+typedef struct _php_timer_wheel_node_t { /* {{{ */
+	zval *arg;
+	int next;
+	int prev;
+	int slot;
+	zend_uint rounds;
+	unsigned short gen;
+} php_timer_wheel_node_t;
 /* }}} */
 
-static void _php_event_base_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
-{
-	php_event_base_t *base = (php_event_base_t*)rsrc->ptr;
+typedef struct _php_timer_wheel_t { /* {{{ */
+	struct event timer;
+	int rsrc_id;
+	php_event_base_t *base;
+	zval *callback;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	long tick;
+	int nslots;
+	int *slots;
+	int current;
+	php_timer_wheel_node_t *nodes;
+	int nodes_len;
+	int nodes_size;
+	int free_head;
+	int count;
+	int armed;
+	int64_t start;
+	int64_t ticks;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_timer_wheel_t;
+/* }}} */
 
-	event_base_free(base->base);
-	efree(base);
-}
+typedef struct _php_event_listener_t { /* {{{ */
+	struct event event;
+	int rsrc_id;
+	int stream_id;
+	php_event_base_t *base;
+	zval *acceptcb;
+	zval *readcb;
+	zval *writecb;
+	zval *errorcb;
+	zval *arg;
+	zend_fcall_info acceptfci;
+	zend_fcall_info_cache acceptfcc;
+	zend_fcall_info readfci;
+	zend_fcall_info_cache readfcc;
+	zend_fcall_info writefci;
+	zend_fcall_info_cache writefcc;
+	zend_fcall_info errorfci;
+	zend_fcall_info_cache errorfcc;
+	long budget;
+	short events;
+	int enabled;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_listener_t;
 /* }}} */
 
-static void _php_event_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
-{
-	php_event_t *event = (php_event_t*)rsrc->ptr;
-	int base_id = -1;
+/* default number of connections accepted per wakeup of a listener */
+#define LIBEVENT_LISTENER_BUDGET 64
 
-	if (event->in_free) {
-		return;
-	}
+#ifdef LIBEVENT_2_API
+typedef struct _php_event_dns_waiter_t { /* {{{ */
+	struct _php_event_dns_waiter_t *next;
+	zval *callback;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	/* cache hits carry their answer, they are called back from the next loop iteration */
+	zval *result;
+	int ttl;
+} php_event_dns_waiter_t;
+/* }}} */
 
-	event->in_free = 1;
+/* a cached answer or a lookup in flight, keyed by query type and lowercased name */
+typedef struct _php_event_dns_entry_t { /* {{{ */
+	struct _php_event_dns_entry_t *prev;
+	struct _php_event_dns_entry_t *next;
+	struct _php_event_dns_t *dns;
+	char *key;
+	int key_len;
+	zval *result;
+	int64_t expires;
+	php_event_dns_waiter_t *waiters;
+} php_event_dns_entry_t;
+/* }}} */
 
-	if (event->base) {
-		base_id = event->base->rsrc_id;
-		--event->base->events;
-	}
-	if (event->stream_id >= 0) {
-		zend_list_delete(event->stream_id);
-	}
-	event_del(event->event);
+typedef struct _php_event_dns_t { /* {{{ */
+	struct evdns_base *evdns;
+	int rsrc_id;
+	php_event_base_t *base;
+	HashTable cache;
+	/* answered entries, most recently used first */
+	php_event_dns_entry_t *lru_head;
+	php_event_dns_entry_t *lru_tail;
+	long cache_size;
+	long cached;
+	long inflight;
+	struct event ready_event;
+	php_event_dns_waiter_t *ready;
+	long hits;
+	long misses;
+	long coalesced;
+	long expired;
+	long evictions;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_dns_t;
+/* }}} */
 
-	_php_event_callback_free(event->callback);
-	efree(event->event);
-	efree(event);
+#define LIBEVENT_DNS_CACHE_SIZE 1024
 
-	if (base_id >= 0) {
-		zend_list_delete(base_id);
-	}
-}
+#ifndef EVDNS_BASE_INITIALIZE_NAMESERVERS
+# define EVDNS_BASE_INITIALIZE_NAMESERVERS 1
+#endif
+
+/* an idle resolver must not keep the loop running */
+#ifdef EVDNS_BASE_DISABLE_WHEN_INACTIVE
+# define LIBEVENT_DNS_BASE_FLAGS EVDNS_BASE_DISABLE_WHEN_INACTIVE
+#else
+# define LIBEVENT_DNS_BASE_FLAGS 0
+#endif
+
+typedef struct _php_event_http_t { /* {{{ */
+	struct evhttp *http;
+	int rsrc_id;
+	php_event_base_t *base;
+	zval *handler;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_http_t;
 /* }}} */
 
-static void _php_bufferevent_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
-{
-	php_bufferevent_t *bevent = (php_bufferevent_t*)rsrc->ptr;
-	int base_id = -1;
+/* req is owned by evhttp and is gone once the reply has been sent */
+typedef struct _php_event_http_req_t { /* {{{ */
+	struct evhttp_request *req;
+	int rsrc_id;
+	php_event_http_t *http;
+	int chunked;
+} php_event_http_req_t;
+/* }}} */
+#endif
 
-	if (bevent->base) {
-		base_id = bevent->base->rsrc_id;
-		--bevent->base->events;
-	}
-	if (bevent->readcb) {
-		zval_ptr_dtor(&(bevent->readcb));
-	}
-	if (bevent->writecb) {
-		zval_ptr_dtor(&(bevent->writecb));
-	}
-	if (bevent->errorcb) {
-		zval_ptr_dtor(&(bevent->errorcb));
-	}
-	if (bevent->arg) {
-		zval_ptr_dtor(&(bevent->arg));
-	}
+#define TIMER_WHEEL_NONE -1
+/* handles are positive longs, a 32 bit long leaves 23 bits for the node index */
+#if SIZEOF_LONG > 4
+# define TIMER_WHEEL_GEN_BITS 16
+# define TIMER_WHEEL_MAX_NODES (INT_MAX / (int)sizeof(php_timer_wheel_node_t))
+#else
+# define TIMER_WHEEL_GEN_BITS 8
+# define TIMER_WHEEL_MAX_NODES (1 << (31 - TIMER_WHEEL_GEN_BITS))
+#endif
+#define TIMER_WHEEL_GEN_MASK ((1 << TIMER_WHEEL_GEN_BITS) - 1)
+#define TIMER_WHEEL_HANDLE(idx, gen) ((((long)(idx)) << TIMER_WHEEL_GEN_BITS) | (gen))
+#define TIMER_WHEEL_HANDLE_IDX(h) ((int)((h) >> TIMER_WHEEL_GEN_BITS))
+#define TIMER_WHEEL_HANDLE_GEN(h) ((unsigned short)((h) & TIMER_WHEEL_GEN_MASK))
+
+#ifdef LIBEVENT_SUPERVISOR_SUPPORT
+typedef struct _php_event_worker_t { /* {{{ */
+	pid_t pid;
+	php_socket_t fd;
+	time_t started;
+} php_event_worker_t;
+/* }}} */
 
-	bufferevent_free(bevent->bevent);
-	efree(bevent);
+/* workers dying younger than this (in seconds) are respawned with a delay */
+#define LIBEVENT_SUPERVISOR_MIN_UPTIME 1
+#define LIBEVENT_SUPERVISOR_SIGNALS 4
 
-	if (base_id >= 0) {
-		zend_list_delete(base_id);
-	}
-}
+static const int php_event_supervisor_signals[LIBEVENT_SUPERVISOR_SIGNALS] = {
+	SIGCHLD, SIGTERM, SIGINT, SIGHUP
+};
+
+static volatile sig_atomic_t php_event_supervisor_sigchld;
+static volatile sig_atomic_t php_event_supervisor_sigterm;
+static volatile sig_atomic_t php_event_supervisor_sighup;
+#endif
+
+#ifdef LIBEVENT_SPLICE_SUPPORT
+typedef struct _php_event_relay_dir_t { /* {{{ */
+	struct _php_event_relay_t *relay;
+	int idx;
+	/* the source became readable or the destination writable */
+	struct event read_event;
+	struct event write_event;
+	/* the kernel pipe spliced through, bytes in it are not written yet */
+	int pipe[2];
+	size_t pending;
+	uint64_t bytes;
+	int done;
+} php_event_relay_dir_t;
 /* }}} */
 
-static void _php_event_callback(int fd, short events, void *arg) /* {{{ */
-{
-	zval *args[3];
-	php_event_t *event = (php_event_t *)arg;
-	php_event_callback_t *callback;
-	zval retval;
-	TSRMLS_FETCH_FROM_CTX(event ? event->thread_ctx : NULL);
+typedef struct _php_event_relay_t { /* {{{ */
+	int rsrc_id;
+	php_event_base_t *base;
+	/* data read from fds[i] is written to the other fd by dirs[i] */
+	php_socket_t fds[2];
+	int stream_ids[2];
+	php_event_relay_dir_t dirs[2];
+	size_t chunk;
+	int closed;
+	int error;
+	zval *callback;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_relay_t;
+/* }}} */
 
-	if (!event || !event->callback || !event->base) {
-		return;
-	}
+#define LIBEVENT_SPLICE_CHUNK (64 * 1024)
+/* chunks moved per wakeup before the other events get their turn */
+#define LIBEVENT_SPLICE_ROUNDS 16
+#endif
 
-	callback = event->callback;
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+typedef struct _php_event_signal_watcher_t { /* {{{ */
+	int rsrc_id;
+	php_event_base_t *base;
+	struct event event;
+	int fd;
+	sigset_t mask;
+	long wakeups;
+	long received;
+	zval *callback;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_signal_watcher_t;
+/* }}} */
 
-	MAKE_STD_ZVAL(args[0]);
-	if (event->stream_id >= 0) {
-		ZVAL_RESOURCE(args[0], event->stream_id);
-		zend_list_addref(event->stream_id);
-	} else if (events & EV_SIGNAL) {
-		ZVAL_LONG(args[0], fd);
-	} else {
-		ZVAL_NULL(args[0]);
-	}
-	
-	MAKE_STD_ZVAL(args[1]);
-	ZVAL_LONG(args[1], events);
+/* siginfo records read from the signalfd at once */
+#define LIBEVENT_SIGNALFD_BATCH 32
 
-	args[2] = callback->arg;
-	Z_ADDREF_P(callback->arg);
-	
-	if (call_user_function(EG(function_table), NULL, callback->func, &retval, 3, args TSRMLS_CC) == SUCCESS) {
-		zval_dtor(&retval);
-	}
+/* watchers per signal, and the signals blocked by us rather than by the process */
+static int php_event_signalfd_refs[NSIG];
+static sigset_t php_event_signalfd_blocked;
+#endif
 
-	zval_ptr_dtor(&(args[0]));
-	zval_ptr_dtor(&(args[1]));
-	zval_ptr_dtor(&(args[2])); 
-	
-}
+#if PHP_MAJOR_VERSION >= 5
+/* the objects embed what the resources point to, their rsrc_id is 0 */
+typedef struct _php_event_base_object_t { /* {{{ */
+	zend_object zo;
+	php_event_base_t base;
+} php_event_base_object_t;
 /* }}} */
 
-static void _php_bufferevent_readcb(struct bufferevent *be, void *arg) /* {{{ */
-{
-	zval *args[2];
-	zval retval;
-	php_bufferevent_t *bevent = (php_bufferevent_t *)arg;
-	TSRMLS_FETCH_FROM_CTX(bevent ? bevent->thread_ctx : NULL);
+typedef struct _php_event_object_t { /* {{{ */
+	zend_object zo;
+	php_event_block_t block;
+} php_event_object_t;
+/* }}} */
 
-	if (!bevent || !bevent->base || !bevent->readcb) {
-		return;
-	}
+typedef struct _php_bufferevent_object_t { /* {{{ */
+	zend_object zo;
+	php_bufferevent_t bevent;
+} php_bufferevent_object_t;
+/* }}} */
+#endif
 
-	MAKE_STD_ZVAL(args[0]);
-	ZVAL_RESOURCE(args[0], bevent->rsrc_id);
-	zend_list_addref(bevent->rsrc_id); /* we do refcount-- later in zval_ptr_dtor */
-	
-	args[1] = bevent->arg;
-	Z_ADDREF_P(args[1]);
-	
-	if (call_user_function(EG(function_table), NULL, bevent->readcb, &retval, 2, args TSRMLS_CC) == SUCCESS) {
-		zval_dtor(&retval);
-	}
+#ifdef LIBEVENT_ASYNC_SUPPORT
+enum {
+	PHP_EVENT_JOB_READ_FILE,
+	PHP_EVENT_JOB_FSYNC,
+	PHP_EVENT_JOB_GETADDRINFO
+};
 
-	zval_ptr_dtor(&(args[0]));
-	zval_ptr_dtor(&(args[1])); 
+typedef struct _php_event_job_t { /* {{{ */
+	struct _php_event_job_t *next;
+	struct _php_event_async_t *async;
+	int type;
+	/* input, read by the worker thread */
+	char *path;
+	int fd;
+	int family;
+	off_t offset;
+	long length;
+	/* output, written by the worker thread */
+	char *data;
+	size_t data_len;
+	struct addrinfo *ai;
+	int error;
+	int64_t submitted;
+	int64_t started;
+	int64_t finished;
+	/* only ever touched on the loop thread */
+	int stream_id;
+	zval *callback;
+	zval *arg;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+} php_event_job_t;
+/* }}} */
 
-}
+/* per-base completion channel, workers hand finished jobs back through it */
+typedef struct _php_event_async_t { /* {{{ */
+	struct event event;
+	int fds[2];
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	php_event_job_t *done;
+	int outstanding;
+	unsigned int forks;
+	long pending;
+	long submitted;
+	long completed;
+	int64_t wait_time;
+	int64_t wait_time_max;
+	int64_t run_time;
+	int64_t run_time_max;
+#ifdef ZTS
+	void ***thread_ctx;
+#endif
+} php_event_async_t;
 /* }}} */
 
-static void _php_bufferevent_writecb(struct bufferevent *be, void *arg) /* {{{ */
-{
-	zval *args[2];
-	zval retval;
-	php_bufferevent_t *bevent = (php_bufferevent_t *)arg;
-	TSRMLS_FETCH_FROM_CTX(bevent ? bevent->thread_ctx : NULL);
+#define LIBEVENT_ASYNC_THREADS 4
+
+typedef struct _php_event_pool_t { /* {{{ */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t *threads;
+	int nthreads;
+	int shutdown;
+	pid_t pid;
+	php_event_job_t *head;
+	php_event_job_t *tail;
+	long queued;
+	/* fork() bookkeeping, jobs the child inherits but no thread will finish */
+	int atfork;
+	unsigned int forks;
+	php_event_job_t *running[LIBEVENT_ASYNC_THREADS];
+	php_event_job_t *orphans;
+} php_event_pool_t;
+/* }}} */
 
-	if (!bevent || !bevent->base || !bevent->writecb) {
-		return;
-	}
+static php_event_pool_t php_event_pool = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 0, 0, NULL, NULL, 0
+};
+#endif
 
-	MAKE_STD_ZVAL(args[0]);
-	ZVAL_RESOURCE(args[0], bevent->rsrc_id);
-	zend_list_addref(bevent->rsrc_id); /* we do refcount-- later in zval_ptr_dtor */
-	
-	args[1] = bevent->arg;
-	Z_ADDREF_P(args[1]);
-	
-	if (call_user_function(EG(function_table), NULL, bevent->writecb, &retval, 2, args TSRMLS_CC) == SUCCESS) {
-		zval_dtor(&retval);
-	}
+/* bases, events and buffer events are taken as resources or as objects */
+#define ZVAL_TO_BASE(zval, base) \
+	base = _php_event_base_fetch(zval TSRMLS_CC); \
+	ZEND_VERIFY_RESOURCE(base)
 
-	zval_ptr_dtor(&(args[0]));
-	zval_ptr_dtor(&(args[1])); 
-	
+#define ZVAL_TO_EVENT(zval, event) \
+	event = _php_event_fetch(zval TSRMLS_CC); \
+	ZEND_VERIFY_RESOURCE(event)
+
+#define ZVAL_TO_BEVENT(zval, bevent) \
+	bevent = _php_bufferevent_fetch(zval TSRMLS_CC); \
+	ZEND_VERIFY_RESOURCE(bevent)
+
+#define ZVAL_TO_CONFIG(zval, config) \
+	ZEND_FETCH_RESOURCE(config, struct event_config *, &zval, -1, "event config", le_event_config)
+
+#define ZVAL_TO_TIMER_WHEEL(zval, wheel) \
+	ZEND_FETCH_RESOURCE(wheel, php_timer_wheel_t *, &zval, -1, "event timer wheel", le_timer_wheel)
+
+#define ZVAL_TO_LISTENER(zval, listener) \
+	ZEND_FETCH_RESOURCE(listener, php_event_listener_t *, &zval, -1, "event listener", le_event_listener)
+
+#define ZVAL_TO_DNS(zval, dns) \
+	ZEND_FETCH_RESOURCE(dns, php_event_dns_t *, &zval, -1, "event dns base", le_event_dns)
+
+#define ZVAL_TO_RATE_GROUP(zval, group) \
+	ZEND_FETCH_RESOURCE(group, php_event_rate_group_t *, &zval, -1, "event rate limit group", le_event_rate_group)
+
+#define ZVAL_TO_PIPE(zval, pipe) \
+	ZEND_FETCH_RESOURCE(pipe, php_event_pipe_t *, &zval, -1, "event buffer pipe", le_event_pipe)
+
+#define ZVAL_TO_RELAY(zval, relay) \
+	ZEND_FETCH_RESOURCE(relay, php_event_relay_t *, &zval, -1, "event relay", le_event_relay)
+
+#define ZVAL_TO_SIGNAL_WATCHER(zval, watcher) \
+	ZEND_FETCH_RESOURCE(watcher, php_event_signal_watcher_t *, &zval, -1, "event signal watcher", le_event_signal_watcher)
+
+#define ZVAL_TO_HTTP(zval, http) \
+	ZEND_FETCH_RESOURCE(http, php_event_http_t *, &zval, -1, "event http", le_event_http)
+
+#define ZVAL_TO_HTTP_REQ(zval, hreq) \
+	ZEND_FETCH_RESOURCE(hreq, php_event_http_req_t *, &zval, -1, "event http request", le_event_http_req)
+
+/* {{{ internal funcs */
+
+/* a base, event or buffer event belongs either to its resource or, when its
+ * rsrc_id is 0, to the object embedding it; references go to the owner */
+static inline void _php_event_owner_addref(int rsrc_id, zend_uint handle TSRMLS_DC) /* {{{ */
+{
+#if PHP_MAJOR_VERSION >= 5
+	if (!rsrc_id) {
+		zend_objects_store_add_ref_by_handle(handle TSRMLS_CC);
+		return;
+	}
+#endif
+	zend_list_addref(rsrc_id);
 }
 /* }}} */
 
-static void _php_bufferevent_errorcb(struct bufferevent *be, short what, void *arg) /* {{{ */
+static inline void _php_event_owner_delref(int rsrc_id, zend_uint handle TSRMLS_DC) /* {{{ */
 {
-	zval *args[3];
-	zval retval;
-	php_bufferevent_t *bevent = (php_bufferevent_t *)arg;
-	TSRMLS_FETCH_FROM_CTX(bevent ? bevent->thread_ctx : NULL);
-
-	if (!bevent || !bevent->base || !bevent->errorcb) {
+#if PHP_MAJOR_VERSION >= 5
+	if (!rsrc_id) {
+		zend_objects_store_del_ref_by_handle(handle TSRMLS_CC);
 		return;
 	}
+#endif
+	zend_list_delete(rsrc_id);
+}
+/* }}} */
 
-	MAKE_STD_ZVAL(args[0]);
-	ZVAL_RESOURCE(args[0], bevent->rsrc_id);
-	zend_list_addref(bevent->rsrc_id); /* we do refcount-- later in zval_ptr_dtor */
-	
-	MAKE_STD_ZVAL(args[1]);
-	ZVAL_LONG(args[1], what);
+#define PHP_EVENT_OWNER_ADDREF(x) _php_event_owner_addref((x)->rsrc_id, (x)->handle TSRMLS_CC)
+#define PHP_EVENT_OWNER_DELREF(x) _php_event_owner_delref((x)->rsrc_id, (x)->handle TSRMLS_CC)
 
-	args[2] = bevent->arg;
-	Z_ADDREF_P(args[2]);
-	
-	if (call_user_function(EG(function_table), NULL, bevent->errorcb, &retval, 3, args TSRMLS_CC) == SUCCESS) {
-		zval_dtor(&retval);
-	}
+/* profiles tell objects from resources by a negative id, object handle h
+ * becomes -(h + 1) since -1 stands for callbacks without an owner */
+#define PHP_EVENT_OWNER_ID(x) ((x)->rsrc_id ? (x)->rsrc_id : -(int)(x)->handle - 1)
 
-	zval_ptr_dtor(&(args[0]));
-	zval_ptr_dtor(&(args[1]));
-	zval_ptr_dtor(&(args[2])); 
-	
+#if PHP_MAJOR_VERSION >= 5
+static inline void _php_event_owner_zval(zval *z, int rsrc_id, zend_uint handle, zend_object_handlers *handlers TSRMLS_DC) /* {{{ */
+{
+	if (rsrc_id) {
+		ZVAL_RESOURCE(z, rsrc_id);
+		zend_list_addref(rsrc_id);
+		return;
+	}
+	Z_TYPE_P(z) = IS_OBJECT;
+	Z_OBJ_HANDLE_P(z) = handle;
+	Z_OBJ_HT_P(z) = handlers;
+	zend_objects_store_add_ref_by_handle(handle TSRMLS_CC);
 }
 /* }}} */
 
-/* }}} */
-
+# define PHP_EVENT_OWNER_ZVAL(z, x, handlers) _php_event_owner_zval((z), (x)->rsrc_id, (x)->handle, &(handlers) TSRMLS_CC)
+#else
+# define PHP_EVENT_OWNER_ZVAL(z, x, handlers) \
+	ZVAL_RESOURCE((z), (x)->rsrc_id); \
+	zend_list_addref((x)->rsrc_id)
+#endif
 
-/* {{{ proto resource event_base_new() 
- */
-static PHP_FUNCTION(event_base_new)
+static php_event_base_t *_php_event_base_fetch(zval *zbase TSRMLS_DC) /* {{{ */
 {
-	php_event_base_t *base;
+#if PHP_MAJOR_VERSION >= 5
+	if (Z_TYPE_P(zbase) == IS_OBJECT && Z_OBJ_HT_P(zbase) == &php_event_base_object_handlers) {
+		php_event_base_object_t *obj = (php_event_base_object_t *)zend_object_store_get_object(zbase TSRMLS_CC);
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
-		return;
+		if (!obj->base.base) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "%s object has not been constructed", Z_OBJCE_P(zbase)->name);
+			return NULL;
+		}
+		return &obj->base;
 	}
+#endif
+	return (php_event_base_t *)zend_fetch_resource(&zbase TSRMLS_CC, -1, "event base", NULL, 1, le_event_base);
+}
+/* }}} */
 
-	base = emalloc(sizeof(php_event_base_t));
-	base->base = event_base_new();
-	if (!base->base) {
-		efree(base);
-		RETURN_FALSE;
+static php_event_t *_php_event_fetch(zval *zevent TSRMLS_DC) /* {{{ */
+{
+#if PHP_MAJOR_VERSION >= 5
+	/* Event objects are complete as soon as they are created */
+	if (Z_TYPE_P(zevent) == IS_OBJECT && Z_OBJ_HT_P(zevent) == &php_event_object_handlers) {
+		return &((php_event_object_t *)zend_object_store_get_object(zevent TSRMLS_CC))->block.event;
 	}
+#endif
+	return (php_event_t *)zend_fetch_resource(&zevent TSRMLS_CC, -1, "event", NULL, 1, le_event);
+}
+/* }}} */
 
-	base->events = 0;
+static php_bufferevent_t *_php_bufferevent_fetch(zval *zbevent TSRMLS_DC) /* {{{ */
+{
+#if PHP_MAJOR_VERSION >= 5
+	if (Z_TYPE_P(zbevent) == IS_OBJECT && Z_OBJ_HT_P(zbevent) == &php_bufferevent_object_handlers) {
+		php_bufferevent_object_t *obj = (php_bufferevent_object_t *)zend_object_store_get_object(zbevent TSRMLS_CC);
 
-#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
-	base->rsrc_id = zend_list_insert(base, le_event_base TSRMLS_CC);
-#else
-	base->rsrc_id = zend_list_insert(base, le_event_base);
+		if (!obj->bevent.bevent) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "%s object has not been constructed", Z_OBJCE_P(zbevent)->name);
+			return NULL;
+		}
+		return &obj->bevent;
+	}
 #endif
-	RETURN_RESOURCE(base->rsrc_id);
+	return (php_bufferevent_t *)zend_fetch_resource(&zbevent TSRMLS_CC, -1, "buffer event", NULL, 1, le_bufferevent);
 }
 /* }}} */
 
-/* {{{ proto bool event_base_reinit()
- */
-static PHP_FUNCTION(event_base_reinit) {
-    zval *zbase;
-    php_event_base_t *base;
-    int r = 0;
-    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zbase) != SUCCESS) {
-        return;
-    }
+static void _php_event_base_release(php_event_base_t *base TSRMLS_DC);
 
-    ZVAL_TO_BASE(zbase, base);
-    r = event_reinit(base->base);
-    if (r == -1) {
-        RETURN_FALSE
-    } else {
-        RETURN_TRUE;
-    }
+/* whatever is attached to a base keeps it alive until it lets go */
+static void _php_event_base_pin(php_event_base_t *base TSRMLS_DC) /* {{{ */
+{
+	++base->events;
+	if (!base->orphaned) {
+		PHP_EVENT_OWNER_ADDREF(base);
+	}
 }
 /* }}} */
 
-/* {{{ proto void event_base_free(resource base) 
- */
-static PHP_FUNCTION(event_base_free)
+static void _php_event_base_unpin(php_event_base_t *base TSRMLS_DC) /* {{{ */
 {
-	zval *zbase;
-	php_event_base_t *base;
-
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zbase) != SUCCESS) {
+	if (base->orphaned) {
+		if (--base->events == 0) {
+			_php_event_base_release(base TSRMLS_CC);
+		}
 		return;
 	}
+	--base->events;
+	PHP_EVENT_OWNER_DELREF(base);
+}
+/* }}} */
 
-	ZVAL_TO_BASE(zbase, base);
+static inline int64_t _php_event_clock_nsec(void) /* {{{ */
+{
+	struct timeval tv;
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
 
-	if (base->events > 0) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "base has events attached to it and cannot be freed");
-		RETURN_FALSE;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+		return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
 	}
-
-	zend_list_delete(base->rsrc_id);
+#endif
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000000 + (int64_t)tv.tv_usec * 1000;
 }
 /* }}} */
 
-/* {{{ proto int event_base_loop(resource base[, int flags]) 
- */
-static PHP_FUNCTION(event_base_loop)
+#define _php_event_clock_usec() (_php_event_clock_nsec() / 1000)
+
+static int _php_event_fcall_init(zval *callable, zend_fcall_info *fci, zend_fcall_info_cache *fcc, char **callable_name TSRMLS_DC) /* {{{ */
 {
-	zval *zbase;
-	php_event_base_t *base;
-	long flags = 0;
-	int ret;
+	if (zend_fcall_info_init(callable, 0, fci, fcc, callable_name, NULL TSRMLS_CC) != SUCCESS) {
+		return FAILURE;
+	}
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|l", &zbase, &flags) != SUCCESS) {
-		return;
+#ifdef ZEND_ACC_CALL_VIA_HANDLER
+	/* __call() trampolines are freed by the engine once called, so they
+	 * cannot be kept around; resolve them again on every dispatch instead */
+	if (fcc->function_handler && (fcc->function_handler->common.fn_flags & ZEND_ACC_CALL_VIA_HANDLER)) {
+		efree((char *)fcc->function_handler->common.function_name);
+		efree(fcc->function_handler);
+		fcc->function_handler = NULL;
+		fcc->initialized = 0;
 	}
+#endif
+	return SUCCESS;
+}
+/* }}} */
 
-	ZVAL_TO_BASE(zbase, base);
-	zend_list_addref(base->rsrc_id); /* make sure the base cannot be destroyed during the loop */
-	ret = event_base_loop(base->base, flags);
-	zend_list_delete(base->rsrc_id);
+static void _php_event_fcall(zend_fcall_info *cached_fci, zend_fcall_info_cache *cached_fcc, int argc, zval **args TSRMLS_DC) /* {{{ */
+{
+	/* work on copies, the callback may be replaced or freed while it runs */
+	zend_fcall_info fci = *cached_fci;
+	zend_fcall_info_cache fcc = *cached_fcc;
+	zval **params[4];
+	zval *retval = NULL;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		params[i] = &args[i];
+	}
 
-	RETURN_LONG(ret);
+	fci.params = params;
+	fci.param_count = argc;
+	fci.retval_ptr_ptr = &retval;
+
+	Z_ADDREF_P(fci.function_name);
+	zend_call_function(&fci, fcc.initialized ? &fcc : NULL TSRMLS_CC);
+	if (retval) {
+		zval_ptr_dtor(&retval);
+	}
+	zval_ptr_dtor(&fci.function_name);
 }
 /* }}} */
 
-/* {{{ proto bool event_base_loopbreak(resource base) 
- */
-static PHP_FUNCTION(event_base_loopbreak)
+static int _php_event_zval_to_fd(zval *zfd, php_socket_t *fd, php_stream **stream_p TSRMLS_DC) /* {{{ */
 {
-	zval *zbase;
-	php_event_base_t *base;
-	int ret;
+	php_stream *stream;
+#ifdef LIBEVENT_SOCKETS_SUPPORT
+	php_socket *php_sock;
+#endif
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zbase) != SUCCESS) {
-		return;
+	if (stream_p) {
+		*stream_p = NULL;
 	}
 
-	ZVAL_TO_BASE(zbase, base);
-	ret = event_base_loopbreak(base->base);
-	if (ret == 0) {
-		RETURN_TRUE;
+	if (Z_TYPE_P(zfd) == IS_RESOURCE) {
+		if (ZEND_FETCH_RESOURCE2_NO_RETURN(stream, php_stream *, &zfd, -1, NULL, php_file_le_stream(), php_file_le_pstream())) {
+			if (php_stream_cast(stream, PHP_STREAM_AS_FD_FOR_SELECT | PHP_STREAM_CAST_INTERNAL, (void*)fd, 1) != SUCCESS || *fd < 0) {
+				return FAILURE;
+			}
+			if (stream_p) {
+				*stream_p = stream;
+			}
+		} else {
+#ifdef LIBEVENT_SOCKETS_SUPPORT
+			if (ZEND_FETCH_RESOURCE_NO_RETURN(php_sock, php_socket *, &zfd, -1, NULL, php_sockets_le_socket())) {
+				*fd = php_sock->bsd_socket;
+			} else {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
+				return FAILURE;
+			}
+#else
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
+			return FAILURE;
+#endif
+		}
+	} else if (Z_TYPE_P(zfd) == IS_LONG) {
+		*fd = Z_LVAL_P(zfd);
+	} else {
+#ifdef LIBEVENT_SOCKETS_SUPPORT
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
+#else
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
+#endif
+		return FAILURE;
 	}
-	RETURN_FALSE;
+	return SUCCESS;
 }
 /* }}} */
 
-/* {{{ proto bool event_base_loopexit(resource base[, int timeout]) 
- */
-static PHP_FUNCTION(event_base_loopexit)
+static php_event_t *_php_event_alloc(TSRMLS_D) /* {{{ */
 {
-	zval *zbase;
-	php_event_base_t *base;
-	int ret;
-	long timeout = -1;
+	php_event_block_t *block;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|l", &zbase, &timeout) != SUCCESS) {
-		return;
-	}
+	if (LIBEVENT_G(event_free)) {
+		block = (php_event_block_t *)LIBEVENT_G(event_free);
+		LIBEVENT_G(event_free) = *(void **)block;
+		++LIBEVENT_G(event_pool_hits);
+	} else {
+		if (LIBEVENT_G(event_cursor_left) == 0) {
+			char *slab = pemalloc(LIBEVENT_SLAB_HEADER + LIBEVENT_CACHE_LINE + LIBEVENT_SLAB_BLOCKS * LIBEVENT_BLOCK_SIZE, 1);
 
-	ZVAL_TO_BASE(zbase, base);
+			/* slabs are chained through their first word so they can be released in GSHUTDOWN */
+			*(void **)slab = LIBEVENT_G(event_slabs);
+			LIBEVENT_G(event_slabs) = slab;
+			++LIBEVENT_G(event_pool_slabs);
 
-	if (timeout < 0) {
-		ret = event_base_loopexit(base->base, NULL);
-	} else {
-		struct timeval time;
-		
-		time.tv_usec = timeout % 1000000;
-		time.tv_sec = timeout / 1000000;
-		ret = event_base_loopexit(base->base, &time);
+			slab += LIBEVENT_SLAB_HEADER;
+			LIBEVENT_G(event_cursor) = (char *)(((zend_uintptr_t)slab + LIBEVENT_CACHE_LINE - 1) & ~((zend_uintptr_t)LIBEVENT_CACHE_LINE - 1));
+			LIBEVENT_G(event_cursor_left) = LIBEVENT_SLAB_BLOCKS;
+		}
+		block = (php_event_block_t *)LIBEVENT_G(event_cursor);
+		LIBEVENT_G(event_cursor) += LIBEVENT_BLOCK_SIZE;
+		--LIBEVENT_G(event_cursor_left);
+		++LIBEVENT_G(event_pool_misses);
 	}
+	++LIBEVENT_G(event_pool_used);
 
-	if (ret == 0) {
-		RETURN_TRUE;
-	}
-	RETURN_FALSE;
+	memset(&block->ev, 0, sizeof(struct event));
+	block->event.event = &block->ev;
+	return &block->event;
 }
 /* }}} */
 
-/* {{{ proto bool event_base_set(resource event, resource base) 
- */
-static PHP_FUNCTION(event_base_set)
+static void _php_event_free(php_event_t *event TSRMLS_DC) /* {{{ */
 {
-	zval *zbase, *zevent;
-	php_event_base_t *base, *old_base;
-	php_event_t *event;
-	int ret;
+	*(void **)event = LIBEVENT_G(event_free);
+	LIBEVENT_G(event_free) = event;
+	--LIBEVENT_G(event_pool_used);
+}
+/* }}} */
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rr", &zevent, &zbase) != SUCCESS) {
-		return;
+static void _php_event_profile_free(php_event_profile_t *profile) /* {{{ */
+{
+	zend_hash_destroy(&profile->callables);
+	zend_hash_destroy(&profile->events);
+	if (profile->hook) {
+		zval_ptr_dtor(&profile->hook);
 	}
+	efree(profile);
+}
+/* }}} */
 
-	ZVAL_TO_BASE(zbase, base);
-	ZVAL_TO_EVENT(zevent, event);
-
-	old_base = event->base;
-	ret = event_base_set(base->base, event->event);
+static int _php_event_callable_name(zend_fcall_info *fci, zend_fcall_info_cache *fcc, char *buf, size_t size TSRMLS_DC) /* {{{ */
+{
+	zend_function *func = fcc->initialized ? fcc->function_handler : NULL;
+	int len;
 
-	if (ret == 0) {
-		if (base != old_base) {
-			/* make sure the base is destroyed after the event */
-			zend_list_addref(base->rsrc_id);
-			++base->events;
+	if (func && func->common.function_name) {
+		if (func->common.scope) {
+			len = snprintf(buf, size, "%s::%s", func->common.scope->name, func->common.function_name);
+		} else {
+			len = snprintf(buf, size, "%s", func->common.function_name);
 		}
+	} else {
+		/* not cached (__call() trampolines), ask the engine */
+		char *name = NULL;
 
-		if (old_base && base != old_base) {
-			--old_base->events;
-			zend_list_delete(old_base->rsrc_id);
+		zend_is_callable(fci->function_name, IS_CALLABLE_CHECK_SYNTAX_ONLY, &name TSRMLS_CC);
+		len = snprintf(buf, size, "%s", name ? name : "unknown");
+		if (name) {
+			efree(name);
 		}
-
-		event->base = base;
-		RETURN_TRUE;
 	}
-	RETURN_FALSE;
+
+	return len < (int)size ? len : (int)size - 1;
 }
 /* }}} */
 
-/* {{{ proto bool event_base_priority_init(resource base, int npriorities) 
- */
-static PHP_FUNCTION(event_base_priority_init)
+static void _php_event_histogram_add(php_event_histogram_t *hist, int64_t elapsed) /* {{{ */
 {
-	zval *zbase;
-	php_event_base_t *base;
-	long npriorities;
-	int ret;
+	int64_t usec = elapsed / 1000;
+	int bucket = 0;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zbase, &npriorities) != SUCCESS) {
-		return;
+	while (usec && bucket < LIBEVENT_HISTOGRAM_BUCKETS - 1) {
+		usec >>= 1;
+		++bucket;
 	}
 
-	ZVAL_TO_BASE(zbase, base);
-
-	if (npriorities < 0) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "npriorities cannot be less than zero");
-		RETURN_FALSE;
-	}
+	++hist->count;
+	hist->sum += elapsed;
+	++hist->buckets[bucket];
+}
+/* }}} */
 
-	ret = event_base_priority_init(base->base, npriorities);
-	if (ret == 0) {
-		RETURN_TRUE;
+static void _php_event_histogram_to_zval(php_event_histogram_t *hist, zval *zhist) /* {{{ */
+{
+	zval *buckets;
+	int i;
+
+	array_init(zhist);
+	add_assoc_long(zhist, "count", hist->count);
+	add_assoc_double(zhist, "sum", hist->sum / 1e9);
+
+	MAKE_STD_ZVAL(buckets);
+	array_init(buckets);
+	for (i = 0; i < LIBEVENT_HISTOGRAM_BUCKETS; i++) {
+		if (hist->buckets[i]) {
+			/* keyed by the upper bound of the bucket in microseconds */
+			add_index_long(buckets, 1L << i, hist->buckets[i]);
+		}
 	}
-	RETURN_FALSE;
+	add_assoc_zval(zhist, "buckets", buckets);
 }
 /* }}} */
 
+static void _php_event_profile_record(php_event_base_t *base, int rsrc_id, int fd, const char *name, int name_len, int64_t elapsed TSRMLS_DC) /* {{{ */
+{
+	php_event_profile_t *profile = base->profile;
+	php_event_histogram_t *hist, empty;
+	zval *args[4];
 
-/* {{{ proto resource event_new() 
- */
-static PHP_FUNCTION(event_new)
-{
-	php_event_t *event;
+	memset(&empty, 0, sizeof(empty));
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+	if (zend_hash_find(&profile->callables, name, name_len + 1, (void **)&hist) != SUCCESS) {
+		zend_hash_add(&profile->callables, name, name_len + 1, &empty, sizeof(empty), (void **)&hist);
+	}
+	_php_event_histogram_add(hist, elapsed);
+
+	if (zend_hash_index_find(&profile->events, rsrc_id, (void **)&hist) != SUCCESS) {
+		zend_hash_index_update(&profile->events, rsrc_id, &empty, sizeof(empty), (void **)&hist);
+	}
+	_php_event_histogram_add(hist, elapsed);
+
+	if (!profile->hook || elapsed < profile->threshold || base->in_slow_hook) {
 		return;
 	}
 
-	event = emalloc(sizeof(php_event_t));
-	event->event = ecalloc(1, sizeof(struct event));
+	MAKE_STD_ZVAL(args[0]);
+	ZVAL_STRINGL(args[0], (char *)name, name_len, 1);
+	MAKE_STD_ZVAL(args[1]);
+	ZVAL_LONG(args[1], fd);
+	MAKE_STD_ZVAL(args[2]);
+	ZVAL_DOUBLE(args[2], elapsed / 1e9);
+	MAKE_STD_ZVAL(args[3]);
+	ZVAL_LONG(args[3], rsrc_id);
 
-	event->stream_id = -1;
-	event->callback = NULL;
-	event->base = NULL;
-	event->in_free = 0;
-	TSRMLS_SET_CTX(event->thread_ctx);
+	/* the hook may disable profiling, do not touch profile past this point */
+	base->in_slow_hook = 1;
+	_php_event_fcall(&profile->hookfci, &profile->hookfcc, 4, args TSRMLS_CC);
+	base->in_slow_hook = 0;
 
-#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
-	event->rsrc_id = zend_list_insert(event, le_event TSRMLS_CC);
-#else
-	event->rsrc_id = zend_list_insert(event, le_event);
-#endif
-	RETURN_RESOURCE(event->rsrc_id);
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+	zval_ptr_dtor(&(args[2]));
+	zval_ptr_dtor(&(args[3]));
 }
 /* }}} */
 
-/* {{{ proto void event_free(resource event) 
- */
-static PHP_FUNCTION(event_free)
+static void _php_event_defer_drain(php_event_base_t *base TSRMLS_DC);
+
+static void _php_event_base_fcall(php_event_base_t *base, int type, int rsrc_id, int fd, zend_fcall_info *fci, zend_fcall_info_cache *fcc, int argc, zval **args TSRMLS_DC) /* {{{ */
 {
-	zval *zevent;
-	php_event_t *event;
+	int64_t start, end, elapsed;
+	char name[256];
+	int name_len = -1;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zevent) != SUCCESS) {
-		return;
+	++base->stats.callbacks[type];
+
+	/* the callback may free its own event and with it fci and fcc, so the
+	 * name is taken while they are still valid */
+	if (base->profile && !base->in_slow_hook) {
+		name_len = _php_event_callable_name(fci, fcc, name, sizeof(name) TSRMLS_CC);
 	}
 
-	ZVAL_TO_EVENT(zevent, event);
-	zend_list_delete(event->rsrc_id);
+	start = _php_event_clock_nsec();
+	++base->fcall_depth;
+	_php_event_fcall(fci, fcc, argc, args TSRMLS_CC);
+	--base->fcall_depth;
+	end = _php_event_clock_nsec();
+	elapsed = end - start;
+
+	/* the loop keeps the base alive while callbacks run */
+	base->stats.callback_time += elapsed;
+	base->iteration_callback_time += elapsed;
+	if (elapsed > base->stats.callback_time_max) {
+		base->stats.callback_time_max = elapsed;
+	}
+
+	if (base->profile && !base->in_slow_hook && name_len >= 0) {
+		_php_event_profile_record(base, rsrc_id, fd, name, name_len, elapsed TSRMLS_CC);
+		base->iteration_callback_time += _php_event_clock_nsec() - end;
+	}
+
+	if (base->fcall_depth == 0 && base->defer_head && !base->draining) {
+		_php_event_defer_drain(base TSRMLS_CC);
+	}
 }
 /* }}} */
 
-/* {{{ proto bool event_add(resource event[, int timeout])
- */
-static PHP_FUNCTION(event_add)
+static void _php_event_defer_drain(php_event_base_t *base TSRMLS_DC) /* {{{ */
 {
-	zval *zevent;
-	php_event_t *event;
-	int ret;
-	long timeout = -1;
+	struct timeval tv = {0, 0};
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|l", &zevent, &timeout) != SUCCESS) {
-		return;
-	}
+	base->draining = 1;
 
-	ZVAL_TO_EVENT(zevent, event);
+	/* tasks deferred by tasks are appended and run in the same pass, the
+	 * budget is shared by all the drains of one loop iteration */
+	while (base->defer_head && base->defer_ran < base->defer_budget) {
+		php_event_task_t *task = base->defer_head;
+		zval *args[1];
 
-	if (!event->base) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to add event without an event base");
-		RETURN_FALSE;
-	}
+		base->defer_head = task->next;
+		if (!base->defer_head) {
+			base->defer_tail = NULL;
+		}
+		--base->defer_len;
+		++base->defer_ran;
+		++base->stats.deferred;
 
-	if (timeout < 0) {
-		ret = event_add(event->event, NULL);
-	} else {
-		struct timeval time;
-		
-		time.tv_usec = timeout % 1000000;
-		time.tv_sec = timeout / 1000000;
-		ret = event_add(event->event, &time);
-	}
+		args[0] = task->arg;
+		_php_event_base_fcall(base, PHP_EVENT_CB_DEFER, -1, -1, &task->fci, &task->fcc, 1, args TSRMLS_CC);
 
-	if (ret != 0) {
-		RETURN_FALSE;
+		zval_ptr_dtor(&task->func);
+		zval_ptr_dtor(&task->arg);
+		task->next = base->task_free;
+		base->task_free = task;
 	}
 
-	RETURN_TRUE;
+	base->draining = 0;
+
+	/* over budget, let the loop poll once before going on: an active event
+	 * would still run in this iteration, a timer only after the next poll */
+	if (base->defer_head) {
+		event_add(&base->defer_event, &tv);
+	}
 }
 /* }}} */
 
-/* {{{ proto bool event_set(resource event, mixed fd, int events, mixed callback[, mixed arg]) 
- */
-static PHP_FUNCTION(event_set)
+static void _php_event_defer_callback(int fd, short events, void *arg) /* {{{ */
 {
-	zval *zevent, **fd, *zcallback, *zarg = NULL;
-	php_event_t *event;
-	long events;
-	php_event_callback_t *callback, *old_callback;
-	char *func_name;
-	php_stream *stream;
-	php_socket_t file_desc;
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-	php_socket *php_sock;
-#endif
-	int ret;
+	php_event_base_t *base = (php_event_base_t *)arg;
+	TSRMLS_FETCH_FROM_CTX(base->thread_ctx);
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rZlz|z", &zevent, &fd, &events, &zcallback, &zarg) != SUCCESS) {
-		return;
+#ifndef LIBEVENT_2_API
+	/* the loop is not driven one iteration at a time here, so the budget
+	 * starts over whenever the queue is picked up by the loop again */
+	base->defer_ran = 0;
+#endif
+	if (base->defer_head && !base->draining) {
+		_php_event_defer_drain(base TSRMLS_CC);
 	}
+}
+/* }}} */
 
-	ZVAL_TO_EVENT(zevent, event);
 
-	if (events & EV_SIGNAL) {
-		/* signal support */
-		convert_to_long_ex(fd);
-		file_desc = Z_LVAL_PP(fd);
-		if (file_desc < 0 || file_desc >= NSIG) {
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "invalid signal passed");
-			RETURN_FALSE;
-		}
-	} else {
-		if (Z_TYPE_PP(fd) == IS_RESOURCE) {
-			if (ZEND_FETCH_RESOURCE2_NO_RETURN(stream, php_stream *, fd, -1, NULL, php_file_le_stream(), php_file_le_pstream())) {
-				if (php_stream_cast(stream, PHP_STREAM_AS_FD_FOR_SELECT | PHP_STREAM_CAST_INTERNAL, (void*)&file_desc, 1) != SUCCESS || file_desc < 0) {
-					RETURN_FALSE;
-				}
-			} else {
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-				if (ZEND_FETCH_RESOURCE_NO_RETURN(php_sock, php_socket *, fd, -1, NULL, php_sockets_le_socket())) {
-					file_desc = php_sock->bsd_socket;
-				} else {
-					php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be either valid PHP stream or valid PHP socket resource");
-					RETURN_FALSE;
-				}
-#else
-				php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource");
-				RETURN_FALSE;
-#endif
-			}
-		} else if (Z_TYPE_PP(fd) == IS_LONG) {
-			file_desc = Z_LVAL_PP(fd);
-			if (file_desc < 0) {
-				php_error_docref(NULL TSRMLS_CC, E_WARNING, "invalid file descriptor passed");
-				RETURN_FALSE;
-			}
-		} else {
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
-#else
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
-#endif
-			RETURN_FALSE;
-		}
+static inline void _php_event_callback_dtor(php_event_callback_t *callback) /* {{{ */
+{
+	if (!callback) {
+		return;
 	}
 
-	if (!zend_is_callable(zcallback, 0, &func_name TSRMLS_CC)) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
-		efree(func_name);
-		RETURN_FALSE;
+	zval_ptr_dtor(&callback->func);
+	if (callback->arg) {
+		zval_ptr_dtor(&callback->arg);
 	}
-	efree(func_name);
+}
+/* }}} */
 
-	zval_add_ref(&zcallback);
-	if (zarg) {
-		zval_add_ref(&zarg);
-	} else {
-		ALLOC_INIT_ZVAL(zarg);
-	}
+static void _php_event_callback_set(php_event_t *event, zval *func, zval *arg, zend_fcall_info *fci, zend_fcall_info_cache *fcc) /* {{{ */
+{
+	php_event_callback_t *callback = &PHP_EVENT_BLOCK(event)->callback;
+	php_event_callback_t old_callback;
+	int had_callback = (event->callback != NULL);
 
-	callback = emalloc(sizeof(php_event_callback_t));
-	callback->func = zcallback;
-	callback->arg = zarg;
+	if (had_callback) {
+		old_callback = *callback;
+	}
 
-	old_callback = event->callback;
+	callback->func = func;
+	callback->arg = arg;
+	callback->fci = *fci;
+	callback->fcc = *fcc;
 	event->callback = callback;
-	if (events & EV_SIGNAL) {
-		event->stream_id = -1;
-	} else {
-		zend_list_addref(Z_LVAL_PP(fd));
-		event->stream_id = Z_LVAL_PP(fd);
+
+	if (had_callback) {
+		_php_event_callback_dtor(&old_callback);
 	}
+}
+/* }}} */
 
-	event_set(event->event, (int)file_desc, (short)events, _php_event_callback, event);
+#ifdef LIBEVENT_ASYNC_SUPPORT
+static void _php_event_job_run(php_event_job_t *job) /* {{{ */
+{
+	struct addrinfo hints;
+	struct stat st;
+	size_t len;
+	ssize_t n;
+	int fd, ret;
+
+	switch (job->type) {
+		case PHP_EVENT_JOB_READ_FILE:
+#ifdef O_CLOEXEC
+			fd = open(job->path, O_RDONLY | O_CLOEXEC);
+#else
+			fd = open(job->path, O_RDONLY);
+#endif
+			if (fd < 0) {
+				job->error = errno;
+				break;
+			}
+
+			if (job->length >= 0) {
+				len = (size_t)job->length;
+			} else if (fstat(fd, &st) == 0) {
+				len = st.st_size > job->offset ? (size_t)(st.st_size - job->offset) : 0;
+			} else {
+				job->error = errno;
+				close(fd);
+				break;
+			}
+
+			if (len > INT_MAX || (job->data = malloc(len + 1)) == NULL) {
+				job->error = len > INT_MAX ? EFBIG : ENOMEM;
+				close(fd);
+				break;
+			}
+
+			while (job->data_len < len) {
+				n = pread(fd, job->data + job->data_len, len - job->data_len, job->offset + job->data_len);
+				if (n < 0 && errno == EINTR) {
+					continue;
+				}
+				if (n < 0) {
+					job->error = errno;
+					break;
+				}
+				if (n == 0) {
+					break;
+				}
+				job->data_len += n;
+			}
+			close(fd);
+			break;
 
-	if (old_callback) {
-		_php_event_callback_free(old_callback);
+		case PHP_EVENT_JOB_FSYNC:
+			if (fsync(job->fd) != 0) {
+				job->error = errno;
+			}
+			break;
+
+		case PHP_EVENT_JOB_GETADDRINFO:
+			memset(&hints, 0, sizeof(hints));
+			hints.ai_family = job->family;
+			hints.ai_socktype = SOCK_STREAM;
+			ret = getaddrinfo(job->path, NULL, &hints, &job->ai);
+			if (ret != 0) {
+				job->error = ret;
+				job->ai = NULL;
+			}
+			break;
 	}
+}
+/* }}} */
 
-	if (event->base) {
-		ret = event_base_set(event->base->base, event->event);
-		if (ret != 0) {
-			RETURN_FALSE;
+static void *_php_event_pool_worker(void *arg) /* {{{ */
+{
+	php_event_job_t *job;
+	php_event_async_t *async;
+	uint64_t one = 1;
+	int wake, slot = (int)(intptr_t)arg;
+
+	for (;;) {
+		pthread_mutex_lock(&php_event_pool.lock);
+		while (!php_event_pool.head && !php_event_pool.shutdown) {
+			pthread_cond_wait(&php_event_pool.cond, &php_event_pool.lock);
+		}
+		if (php_event_pool.shutdown) {
+			pthread_mutex_unlock(&php_event_pool.lock);
+			break;
 		}
+		job = php_event_pool.head;
+		php_event_pool.head = job->next;
+		if (!php_event_pool.head) {
+			php_event_pool.tail = NULL;
+		}
+		--php_event_pool.queued;
+		php_event_pool.running[slot] = job;
+		pthread_mutex_unlock(&php_event_pool.lock);
+
+		job->started = _php_event_clock_nsec();
+		_php_event_job_run(job);
+		job->finished = _php_event_clock_nsec();
+
+		/* the loop thread may free the channel as soon as outstanding drops,
+		   so everything including the wakeup happens under its lock; the pool
+		   lock is held too so that fork() sees the job either running or done */
+		async = job->async;
+		pthread_mutex_lock(&php_event_pool.lock);
+		pthread_mutex_lock(&async->lock);
+		wake = async->done == NULL;
+		job->next = async->done;
+		async->done = job;
+		--async->outstanding;
+		if (wake) {
+#ifdef HAVE_SYS_EVENTFD_H
+			(void)!write(async->fds[1], &one, sizeof(one));
+#else
+			(void)!write(async->fds[1], &one, 1);
+#endif
+		}
+		pthread_cond_broadcast(&async->cond);
+		php_event_pool.running[slot] = NULL;
+		pthread_mutex_unlock(&async->lock);
+		pthread_mutex_unlock(&php_event_pool.lock);
 	}
-	RETURN_TRUE;
+	return NULL;
 }
 /* }}} */
 
-/* {{{ proto bool event_del(resource event) 
- */
-static PHP_FUNCTION(event_del)
+static void _php_event_pool_prepare(void) /* {{{ */
 {
-	zval *zevent;
-	php_event_t *event;
-
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zevent) != SUCCESS) {
-		return;
-	}
+	pthread_mutex_lock(&php_event_pool.lock);
+}
+/* }}} */
 
-	ZVAL_TO_EVENT(zevent, event);
+static void _php_event_pool_parent(void) /* {{{ */
+{
+	pthread_mutex_unlock(&php_event_pool.lock);
+}
+/* }}} */
 
-	if (!event->base) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to delete event without an event base");
-		RETURN_FALSE;
+static void _php_event_pool_child(void) /* {{{ */
+{
+	php_event_job_t *job, *next;
+	int i;
+
+	/* threads do not survive fork(): queued and running jobs are set aside
+	   for their channels to cancel, and the pool starts over on next use */
+	for (job = php_event_pool.head; job; job = next) {
+		next = job->next;
+		job->next = php_event_pool.orphans;
+		php_event_pool.orphans = job;
 	}
-
-	if (event_del(event->event) == 0) {
-		RETURN_TRUE;
+	for (i = 0; i < LIBEVENT_ASYNC_THREADS; i++) {
+		job = php_event_pool.running[i];
+		if (job) {
+			job->next = php_event_pool.orphans;
+			php_event_pool.orphans = job;
+			php_event_pool.running[i] = NULL;
+		}
 	}
-	RETURN_FALSE;
+	php_event_pool.head = php_event_pool.tail = NULL;
+	php_event_pool.queued = 0;
+
+	free(php_event_pool.threads);
+	php_event_pool.threads = NULL;
+	php_event_pool.nthreads = 0;
+	++php_event_pool.forks;
+
+	/* the dead workers may have been waiting on the condition */
+	pthread_cond_init(&php_event_pool.cond, NULL);
+	pthread_mutex_unlock(&php_event_pool.lock);
 }
 /* }}} */
 
-/* {{{ proto bool event_priority_set(resource event, int priority) 
- */
-static PHP_FUNCTION(event_priority_set)
+static int _php_event_pool_start(TSRMLS_D) /* {{{ */
 {
-	zval *zevent;
-	php_event_t *event;
-	long priority;
-	int ret;
+	sigset_t all, old;
+	int i, ret = SUCCESS;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zevent, &priority) != SUCCESS) {
-		return;
+	pthread_mutex_lock(&php_event_pool.lock);
+
+	if (!php_event_pool.atfork) {
+		if (pthread_atfork(_php_event_pool_prepare, _php_event_pool_parent, _php_event_pool_child) != 0) {
+			pthread_mutex_unlock(&php_event_pool.lock);
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to register the fork handlers");
+			return FAILURE;
+		}
+		php_event_pool.atfork = 1;
 	}
 
-	ZVAL_TO_EVENT(zevent, event);
+	if (!php_event_pool.nthreads) {
+		php_event_pool.threads = malloc(LIBEVENT_ASYNC_THREADS * sizeof(pthread_t));
+		php_event_pool.pid = getpid();
+		php_event_pool.shutdown = 0;
+
+		/* signals must keep being delivered to the loop thread */
+		sigfillset(&all);
+		pthread_sigmask(SIG_BLOCK, &all, &old);
+		for (i = 0; php_event_pool.threads && i < LIBEVENT_ASYNC_THREADS; i++) {
+			if (pthread_create(&php_event_pool.threads[i], NULL, _php_event_pool_worker, (void *)(intptr_t)i) != 0) {
+				break;
+			}
+			php_event_pool.nthreads++;
+		}
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
 
-	if (!event->base) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to set event priority without an event base");
-		RETURN_FALSE;
+		if (!php_event_pool.nthreads) {
+			free(php_event_pool.threads);
+			php_event_pool.threads = NULL;
+			ret = FAILURE;
+		}
 	}
 
-	ret = event_priority_set(event->event, priority);
+	pthread_mutex_unlock(&php_event_pool.lock);
 
-	if (ret == 0) {
-		RETURN_TRUE;
+	if (ret != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to start the worker threads");
 	}
-	RETURN_FALSE;
+	return ret;
 }
 /* }}} */
 
-/* {{{ proto bool event_timer_set(resource event, mixed callback[, mixed arg]) 
- */
-static PHP_FUNCTION(event_timer_set)
+static void _php_event_pool_stop(void) /* {{{ */
 {
-	zval *zevent, *zcallback, *zarg = NULL;
-	php_event_t *event;
-	php_event_callback_t *callback, *old_callback;
-	char *func_name;
+	int i;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz|z", &zevent, &zcallback, &zarg) != SUCCESS) {
+	pthread_mutex_lock(&php_event_pool.lock);
+	if (!php_event_pool.nthreads || php_event_pool.pid != getpid()) {
+		pthread_mutex_unlock(&php_event_pool.lock);
 		return;
 	}
+	php_event_pool.shutdown = 1;
+	pthread_cond_broadcast(&php_event_pool.cond);
+	pthread_mutex_unlock(&php_event_pool.lock);
 
-	ZVAL_TO_EVENT(zevent, event);
+	for (i = 0; i < php_event_pool.nthreads; i++) {
+		pthread_join(php_event_pool.threads[i], NULL);
+	}
+	free(php_event_pool.threads);
+	php_event_pool.threads = NULL;
+	php_event_pool.nthreads = 0;
+}
+/* }}} */
 
-	if (!zend_is_callable(zcallback, 0, &func_name TSRMLS_CC)) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
-		efree(func_name);
-		RETURN_FALSE;
+static php_event_job_t *_php_event_job_new(int type, zval *zcallback, zval *zarg, zend_fcall_info *fci, zend_fcall_info_cache *fcc) /* {{{ */
+{
+	php_event_job_t *job = calloc(1, sizeof(php_event_job_t));
+
+	if (!job) {
+		return NULL;
 	}
-	efree(func_name);
+
+	job->type = type;
+	job->fd = -1;
+	job->length = -1;
+	job->stream_id = -1;
 
 	zval_add_ref(&zcallback);
+	job->callback = zcallback;
+	job->fci = *fci;
+	job->fcc = *fcc;
+
 	if (zarg) {
 		zval_add_ref(&zarg);
+		job->arg = zarg;
 	} else {
-		ALLOC_INIT_ZVAL(zarg);
+		ALLOC_INIT_ZVAL(job->arg);
 	}
+	return job;
+}
+/* }}} */
 
-	callback = emalloc(sizeof(php_event_callback_t));
-	callback->func = zcallback;
-	callback->arg = zarg;
-
-	old_callback = event->callback;
-	event->callback = callback;
-	if (event->stream_id >= 0) {
-		zend_list_delete(event->stream_id);
+static void _php_event_job_free(php_event_job_t *job TSRMLS_DC) /* {{{ */
+{
+	zval_ptr_dtor(&job->callback);
+	zval_ptr_dtor(&job->arg);
+	if (job->stream_id >= 0) {
+		zend_list_delete(job->stream_id);
 	}
-	event->stream_id = -1;
-
-	event_set(event->event, -1, 0, _php_event_callback, event);
-
-	if (old_callback) {
-		_php_event_callback_free(old_callback);
+	if (job->ai) {
+		freeaddrinfo(job->ai);
 	}
-	RETURN_TRUE;
+	free(job->data);
+	free(job->path);
+	free(job);
 }
 /* }}} */
 
-/* {{{ proto bool event_timer_pending(resource event[, int timeout])
- */
-static PHP_FUNCTION(event_timer_pending)
+static void _php_event_job_deliver(php_event_base_t *base, php_event_job_t *job TSRMLS_DC) /* {{{ */
 {
-	zval *zevent;
-	php_event_t *event;
-	int ret;
-	long timeout = -1;
+	php_event_async_t *async = base->async;
+	struct addrinfo *ai;
+	char addr[INET6_ADDRSTRLEN];
+	const void *src;
+	zval *args[3];
+	int64_t wait = job->started - job->submitted, run = job->finished - job->started;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|l", &zevent, &timeout) != SUCCESS) {
-		return;
+	++async->completed;
+	async->wait_time += wait;
+	async->run_time += run;
+	if (wait > async->wait_time_max) {
+		async->wait_time_max = wait;
+	}
+	if (run > async->run_time_max) {
+		async->run_time_max = run;
 	}
 
-	ZVAL_TO_EVENT(zevent, event);
-
-	if (timeout < 0) {
-		ret = event_pending(event->event, EV_TIMEOUT, NULL);
+	MAKE_STD_ZVAL(args[0]);
+	if (job->error) {
+		ZVAL_FALSE(args[0]);
+	} else if (job->type == PHP_EVENT_JOB_READ_FILE) {
+		job->data[job->data_len] = '\0';
+		ZVAL_STRINGL(args[0], job->data, job->data_len, 1);
+	} else if (job->type == PHP_EVENT_JOB_GETADDRINFO) {
+		array_init(args[0]);
+		for (ai = job->ai; ai; ai = ai->ai_next) {
+			if (ai->ai_family == AF_INET) {
+				src = &((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+			} else if (ai->ai_family == AF_INET6) {
+				src = &((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr;
+			} else {
+				continue;
+			}
+			if (inet_ntop(ai->ai_family, src, addr, sizeof(addr))) {
+				add_next_index_string(args[0], addr, 1);
+			}
+		}
 	} else {
-		struct timeval time;
-		
-		time.tv_usec = timeout % 1000000;
-		time.tv_sec = timeout / 1000000;
-		ret = event_pending(event->event, EV_TIMEOUT, &time);
+		ZVAL_TRUE(args[0]);
 	}
 
-	if (ret != 0) {
-		RETURN_FALSE;
-	}
-	RETURN_TRUE;
-}
-/* }}} */
+	MAKE_STD_ZVAL(args[1]);
+	ZVAL_LONG(args[1], job->error);
 
+	args[2] = job->arg;
+	Z_ADDREF_P(args[2]);
 
+	_php_event_base_fcall(base, PHP_EVENT_CB_ASYNC, PHP_EVENT_OWNER_ID(base), -1, &job->fci, &job->fcc, 3, args TSRMLS_CC);
 
-/* {{{ proto resource event_buffer_new(mixed fd, mixed readcb, mixed writecb, mixed errorcb[, mixed arg]) 
- */
-static PHP_FUNCTION(event_buffer_new)
-{
-	php_bufferevent_t *bevent;
-	php_stream *stream;
-	zval *zfd, *zreadcb, *zwritecb, *zerrorcb, *zarg = NULL;
-	php_socket_t fd;
-	char *func_name;
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-	php_socket *php_sock;
-#endif
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+	zval_ptr_dtor(&(args[2]));
+}
+/* }}} */
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzzz|z", &zfd, &zreadcb, &zwritecb, &zerrorcb, &zarg) != SUCCESS) {
-		return;
-	}
-	
-	if (Z_TYPE_P(zfd) == IS_RESOURCE) {
-		if (ZEND_FETCH_RESOURCE2_NO_RETURN(stream, php_stream *, &zfd, -1, NULL, php_file_le_stream(), php_file_le_pstream())) {
-			if (php_stream_cast(stream, PHP_STREAM_AS_FD_FOR_SELECT | PHP_STREAM_CAST_INTERNAL, (void*)&fd, 1) != SUCCESS || fd < 0) {
-				RETURN_FALSE;
-			}
-		} else {
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-			if (ZEND_FETCH_RESOURCE_NO_RETURN(php_sock, php_socket *, &zfd, -1, NULL, php_sockets_le_socket())) {
-				fd = php_sock->bsd_socket;
-			} else {
-				php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
-				RETURN_FALSE;
-			}
-#else
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
-			RETURN_FALSE;
-#endif
-		}
-	} else if (Z_TYPE_P(zfd) == IS_LONG) {
-		fd = Z_LVAL_P(zfd);
-	} else {
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
+static int _php_event_async_channel(php_event_async_t *async TSRMLS_DC) /* {{{ */
+{
+#ifdef HAVE_SYS_EVENTFD_H
+	async->fds[0] = async->fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (async->fds[0] < 0) {
 #else
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
+	if (pipe(async->fds) != 0) {
 #endif
-		RETURN_FALSE;
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to create the completion channel: %s", strerror(errno));
+		async->fds[0] = async->fds[1] = -1;
+		return FAILURE;
 	}
+#ifndef HAVE_SYS_EVENTFD_H
+	fcntl(async->fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(async->fds[1], F_SETFL, O_NONBLOCK);
+	fcntl(async->fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(async->fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+	return SUCCESS;
+}
+/* }}} */
 
-	if (Z_TYPE_P(zreadcb) != IS_NULL) {
-		if (!zend_is_callable(zreadcb, 0, &func_name TSRMLS_CC)) {
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid read callback", func_name);
-			efree(func_name);
-			RETURN_FALSE;
-		}
-		efree(func_name);
-	} else {
-		zreadcb = NULL;
+static void _php_event_async_close(php_event_async_t *async) /* {{{ */
+{
+	if (async->fds[0] >= 0) {
+		close(async->fds[0]);
 	}
+	if (async->fds[1] >= 0 && async->fds[1] != async->fds[0]) {
+		close(async->fds[1]);
+	}
+	async->fds[0] = async->fds[1] = -1;
+}
+/* }}} */
 
-	if (Z_TYPE_P(zwritecb) != IS_NULL) {
-		if (!zend_is_callable(zwritecb, 0, &func_name TSRMLS_CC)) {
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid write callback", func_name);
-			efree(func_name);
-			RETURN_FALSE;
+static void _php_event_async_adopt(php_event_async_t *async) /* {{{ */
+{
+	php_event_job_t **link, *job;
+	int64_t now = _php_event_clock_nsec();
+
+	/* only this thread is left after fork(), nobody else touches the lists */
+	for (link = &php_event_pool.orphans; *link; ) {
+		job = *link;
+		if (job->async != async) {
+			link = &job->next;
+			continue;
 		}
-		efree(func_name);
-	} else {
-		zwritecb = NULL;
-	}
+		*link = job->next;
 
-	if (!zend_is_callable(zerrorcb, 0, &func_name TSRMLS_CC)) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid error callback", func_name);
-		efree(func_name);
-		RETURN_FALSE;
+		if (!job->started) {
+			job->started = now;
+		}
+		job->finished = now;
+		job->error = ECANCELED;
+		job->next = async->done;
+		async->done = job;
 	}
-	efree(func_name);
+	async->outstanding = 0;
+	async->forks = php_event_pool.forks;
+	pthread_mutex_init(&async->lock, NULL);
+	pthread_cond_init(&async->cond, NULL);
+}
+/* }}} */
 
-	bevent = emalloc(sizeof(php_bufferevent_t));
-	bevent->bevent = bufferevent_new(fd, _php_bufferevent_readcb, _php_bufferevent_writecb, _php_bufferevent_errorcb, bevent);
+static void _php_event_async_callback(int fd, short events, void *arg);
 
-	bevent->base = NULL;
+static int _php_event_async_fork_check(php_event_base_t *base TSRMLS_DC) /* {{{ */
+{
+	php_event_async_t *async = base->async;
+	uint64_t one = 1;
 
-	if (zreadcb) {
-		zval_add_ref(&zreadcb);
-	}
-	bevent->readcb = zreadcb;
-	
-	if (zwritecb) {
-		zval_add_ref(&zwritecb);
+	if (async->forks == php_event_pool.forks) {
+		return async->fds[0] >= 0 ? SUCCESS : FAILURE;
 	}
-	bevent->writecb = zwritecb;
-		
-	zval_add_ref(&zerrorcb);
-	bevent->errorcb = zerrorcb;
 
-	if (zarg) {
-		zval_add_ref(&zarg);
-		bevent->arg = zarg;
-	} else {
-		ALLOC_INIT_ZVAL(bevent->arg);
+	/* the jobs the parent was running are cancelled, and the channel is
+	   replaced so that parent and child do not steal each other's wakeups */
+	_php_event_async_adopt(async);
+	event_del(&async->event);
+	_php_event_async_close(async);
+	if (_php_event_async_channel(async TSRMLS_CC) != SUCCESS) {
+		return FAILURE;
 	}
 
-	TSRMLS_SET_CTX(bevent->thread_ctx);
-
-#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
-	bevent->rsrc_id = zend_list_insert(bevent, le_bufferevent TSRMLS_CC);
+	event_set(&async->event, async->fds[0], EV_READ | EV_PERSIST, _php_event_async_callback, base);
+	event_base_set(base->base, &async->event);
+	if (async->pending > 0) {
+		event_add(&async->event, NULL);
+	}
+	if (async->done) {
+#ifdef HAVE_SYS_EVENTFD_H
+		(void)!write(async->fds[1], &one, sizeof(one));
 #else
-	bevent->rsrc_id = zend_list_insert(bevent, le_bufferevent);
+		(void)!write(async->fds[1], &one, 1);
 #endif
-	RETURN_RESOURCE(bevent->rsrc_id);
+	}
+	return SUCCESS;
 }
 /* }}} */
 
-/* {{{ proto void event_buffer_free(resource bevent) 
- */
-static PHP_FUNCTION(event_buffer_free)
+static void _php_event_async_callback(int fd, short events, void *arg) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
+	php_event_base_t *base = (php_event_base_t *)arg;
+	php_event_async_t *async = base->async;
+	php_event_job_t *job, *next, *jobs = NULL;
+	char buf[64];
+	TSRMLS_FETCH_FROM_CTX(async->thread_ctx);
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zbevent) != SUCCESS) {
+	/* a channel inherited through fork() is replaced and fires again */
+	if (async->forks != php_event_pool.forks) {
+		_php_event_async_fork_check(base TSRMLS_CC);
 		return;
 	}
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
-	zend_list_delete(bevent->rsrc_id);
-}
-/* }}} */
+	while (read(fd, buf, sizeof(buf)) > 0);
 
-/* {{{ proto bool event_buffer_base_set(resource bevent, resource base) 
- */
-static PHP_FUNCTION(event_buffer_base_set)
-{
-	zval *zbase, *zbevent;
-	php_event_base_t *base, *old_base;
-	php_bufferevent_t *bevent;
-	int ret;
+	pthread_mutex_lock(&async->lock);
+	job = async->done;
+	async->done = NULL;
+	pthread_mutex_unlock(&async->lock);
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rr", &zbevent, &zbase) != SUCCESS) {
-		return;
+	/* workers push in completion order onto a stack, deliver oldest first */
+	for (; job; job = next) {
+		next = job->next;
+		job->next = jobs;
+		jobs = job;
 	}
 
-	ZVAL_TO_BASE(zbase, base);
-	ZVAL_TO_BEVENT(zbevent, bevent);
-
-	old_base = bevent->base;
-	ret = bufferevent_base_set(base->base, bevent->bevent);
-
-	if (ret == 0) {
-		if (base != old_base) {
-			/* make sure the base is destroyed after the event */
-			zend_list_addref(base->rsrc_id);
-			++base->events;
-		}
+	_php_event_base_pin(base TSRMLS_CC);
+	for (job = jobs; job; job = next) {
+		next = job->next;
+		_php_event_job_deliver(base, job TSRMLS_CC);
+		_php_event_job_free(job TSRMLS_CC);
 
-		if (old_base) {
-			--old_base->events;
-			zend_list_delete(old_base->rsrc_id);
+		_php_event_base_unpin(base TSRMLS_CC);
+		if (--async->pending == 0) {
+			/* an idle channel must not keep the loop running */
+			event_del(&async->event);
 		}
-
-		bevent->base = base;
-		RETURN_TRUE;
 	}
-	RETURN_FALSE;
+	_php_event_base_unpin(base TSRMLS_CC);
 }
 /* }}} */
 
-/* {{{ proto bool event_buffer_priority_set(resource bevent, int priority) 
- */
-static PHP_FUNCTION(event_buffer_priority_set)
+static int _php_event_async_submit(php_event_base_t *base, php_event_job_t *job TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
-	long priority;
-	int ret;
+	php_event_async_t *async = base->async;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zbevent, &priority) != SUCCESS) {
-		return;
+	if (_php_event_pool_start(TSRMLS_C) != SUCCESS) {
+		return FAILURE;
 	}
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
+	if (!async) {
+		async = calloc(1, sizeof(php_event_async_t));
+		if (!async) {
+			return FAILURE;
+		}
+		if (_php_event_async_channel(async TSRMLS_CC) != SUCCESS) {
+			free(async);
+			return FAILURE;
+		}
+		async->forks = php_event_pool.forks;
+		pthread_mutex_init(&async->lock, NULL);
+		pthread_cond_init(&async->cond, NULL);
+		TSRMLS_SET_CTX(async->thread_ctx);
+
+		event_set(&async->event, async->fds[0], EV_READ | EV_PERSIST, _php_event_async_callback, base);
+		event_base_set(base->base, &async->event);
+		base->async = async;
+	} else if (_php_event_async_fork_check(base TSRMLS_CC) != SUCCESS) {
+		return FAILURE;
+	}
 
-	if (!bevent->base) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to set event priority without an event base");
-		RETURN_FALSE;
+	if (async->pending == 0 && event_add(&async->event, NULL) != 0) {
+		return FAILURE;
 	}
+	++async->pending;
+	++async->submitted;
 
-	ret = bufferevent_priority_set(bevent->bevent, priority);
+	job->async = async;
+	job->submitted = _php_event_clock_nsec();
 
-	if (ret == 0) {
-		RETURN_TRUE;
+	pthread_mutex_lock(&async->lock);
+	++async->outstanding;
+	pthread_mutex_unlock(&async->lock);
+
+	pthread_mutex_lock(&php_event_pool.lock);
+	if (php_event_pool.tail) {
+		php_event_pool.tail->next = job;
+	} else {
+		php_event_pool.head = job;
 	}
-	RETURN_FALSE;
+	php_event_pool.tail = job;
+	++php_event_pool.queued;
+	pthread_cond_signal(&php_event_pool.cond);
+	pthread_mutex_unlock(&php_event_pool.lock);
+
+	/* make sure the base is destroyed after the job */
+	_php_event_base_pin(base TSRMLS_CC);
+	return SUCCESS;
 }
 /* }}} */
 
-/* {{{ proto bool event_buffer_write(resource bevent, string data[, int data_size]) 
- */
-static PHP_FUNCTION(event_buffer_write)
+static int _php_event_async_free(php_event_async_t *async TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
-	char *data;
-	int data_len;
-	long data_size = -1;
-	int ret;
+	php_event_job_t **link, *job, *next, *dropped = NULL;
+	int discarded = 0;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rs|l", &zbevent, &data, &data_len, &data_size) != SUCCESS) {
-		return;
-	}
-
-	ZVAL_TO_BEVENT(zbevent, bevent);
+	event_del(&async->event);
 
-	if (ZEND_NUM_ARGS() < 3 || data_size < 0) {
-		data_size = data_len;
-	} else if (data_size > data_len) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "data_size out of range");
-		RETURN_FALSE;
+	/* in a child of fork() nothing would ever finish the inherited jobs */
+	if (async->forks != php_event_pool.forks) {
+		_php_event_async_adopt(async);
 	}
 
-	ret = bufferevent_write(bevent->bevent, (const void *)data, data_size);
+	/* jobs no worker has picked up yet are dropped right away */
+	pthread_mutex_lock(&php_event_pool.lock);
+	php_event_pool.tail = NULL;
+	for (link = &php_event_pool.head; *link; ) {
+		job = *link;
+		if (job->async == async) {
+			*link = job->next;
+			job->next = dropped;
+			dropped = job;
+			--php_event_pool.queued;
+		} else {
+			php_event_pool.tail = job;
+			link = &job->next;
+		}
+	}
+	pthread_mutex_unlock(&php_event_pool.lock);
 
-	if (ret == 0) {
-		RETURN_TRUE;
+	pthread_mutex_lock(&async->lock);
+	for (job = dropped; job; job = job->next) {
+		--async->outstanding;
 	}
-	RETURN_FALSE;
+	while (async->outstanding > 0) {
+		pthread_cond_wait(&async->cond, &async->lock);
+	}
+	job = async->done;
+	async->done = NULL;
+	pthread_mutex_unlock(&async->lock);
+
+	/* the base is going away, results are discarded without calling back */
+	for (; job; job = next) {
+		next = job->next;
+		_php_event_job_free(job TSRMLS_CC);
+		++discarded;
+	}
+	for (job = dropped; job; job = next) {
+		next = job->next;
+		_php_event_job_free(job TSRMLS_CC);
+		++discarded;
+	}
+
+	_php_event_async_close(async);
+	pthread_mutex_destroy(&async->lock);
+	pthread_cond_destroy(&async->cond);
+	free(async);
+	return discarded;
 }
 /* }}} */
+#endif
 
-/* {{{ proto string event_buffer_read(resource bevent, int data_size) 
- */
-static PHP_FUNCTION(event_buffer_read)
+static void _php_event_base_release(php_event_base_t *base TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
-	char *data;
-	long data_size;
-	int ret;
+	while (base->args_cached > 0) {
+		FREE_ZVAL(base->args_cache[--base->args_cached]);
+	}
+	while (base->once_live) {
+		php_event_once_t *once = base->once_live;
+
+		base->once_live = once->next;
+		event_del(&once->event);
+		zval_ptr_dtor(&once->func);
+		zval_ptr_dtor(&once->arg);
+		if (once->stream_id >= 0) {
+			zend_list_delete(once->stream_id);
+		}
+		efree(once);
+	}
+	while (base->once_free) {
+		php_event_once_t *once = base->once_free;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zbevent, &data_size) != SUCCESS) {
-		return;
+		base->once_free = once->next;
+		efree(once);
 	}
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
+	/* tasks still queued are dropped along with the base */
+	event_del(&base->defer_event);
+	while (base->defer_head) {
+		php_event_task_t *task = base->defer_head;
 
-	if (data_size == 0) {
-		RETURN_EMPTY_STRING();
-	} else if (data_size < 0) {
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "data_size cannot be less than zero");
-		RETURN_FALSE;
+		base->defer_head = task->next;
+		zval_ptr_dtor(&task->func);
+		zval_ptr_dtor(&task->arg);
+		efree(task);
 	}
+	while (base->task_free) {
+		php_event_task_t *task = base->task_free;
 
-	data = safe_emalloc((int)data_size, sizeof(char), 1);
-
-	ret = bufferevent_read(bevent->bevent, data, data_size);
-	if (ret > 0) {
-		if (ret > data_size) { /* paranoia */
-			ret = data_size;
-		}
-		data[ret] = '\0';
-		RETURN_STRINGL(data, ret, 0);
+		base->task_free = task->next;
+		efree(task);
 	}
-	efree(data);
-	RETURN_EMPTY_STRING();
+	if (base->batchcb) {
+		zval_ptr_dtor(&base->batchcb);
+	}
+	if (base->batch) {
+		efree(base->batch);
+	}
+	if (base->profile) {
+		_php_event_profile_free(base->profile);
+	}
+#ifdef LIBEVENT_ASYNC_SUPPORT
+	if (base->async) {
+		_php_event_async_free(base->async TSRMLS_CC);
+	}
+#endif
+	event_base_free(base->base);
+#if PHP_MAJOR_VERSION >= 5
+	if (!base->rsrc_id) {
+		efree((char *)base - XtOffsetOf(php_event_base_object_t, base));
+		return;
+	}
+#endif
+	efree(base);
 }
 /* }}} */
 
-/* {{{ proto bool event_buffer_enable(resource bevent, int events) 
- */
-static PHP_FUNCTION(event_buffer_enable)
+static void _php_event_base_disown(php_event_base_t *base TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
-	long events;
-	int ret;
-
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zbevent, &events) != SUCCESS) {
+	/* nothing attached lets go of a base, so it is left with some only when
+	 * a shutdown destroys what is left in whatever order */
+#ifdef LIBEVENT_ASYNC_SUPPORT
+	if (base->events > 0 && base->async) {
+		/* nobody is going to deliver the jobs still pinning the base */
+		base->events -= _php_event_async_free(base->async TSRMLS_CC);
+		base->async = NULL;
+	}
+#endif
+	if (base->events > 0) {
+		base->orphaned = 1;
 		return;
 	}
+	_php_event_base_release(base TSRMLS_CC);
+}
+/* }}} */
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
-
-	ret = bufferevent_enable(bevent->bevent, events);
-
-	if (ret == 0) {
-		RETURN_TRUE;
-	}
-	RETURN_FALSE;
+static void _php_event_base_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	_php_event_base_disown((php_event_base_t *)rsrc->ptr TSRMLS_CC);
 }
 /* }}} */
 
-/* {{{ proto bool event_buffer_disable(resource bevent, int events) 
- */
-static PHP_FUNCTION(event_buffer_disable)
+static void _php_event_base_init(php_event_base_t *base, struct event_base *evbase TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
-	long events;
-	int ret;
+	base->base = evbase;
+	base->rsrc_id = 0;
+	base->handle = 0;
+	base->events = 0;
+	base->orphaned = 0;
+	memset(&base->stats, 0, sizeof(base->stats));
+	base->iteration_callback_time = 0;
+	base->profile = NULL;
+	base->in_slow_hook = 0;
+	base->batchcb = NULL;
+	base->batching = 0;
+	base->batch = NULL;
+	base->async = NULL;
+	base->batch_len = 0;
+	base->batch_size = 0;
+	base->args_cached = 0;
+	base->once_live = NULL;
+	base->once_free = NULL;
+	base->defer_head = NULL;
+	base->defer_tail = NULL;
+	base->task_free = NULL;
+	base->defer_len = 0;
+	base->defer_budget = LIBEVENT_DEFER_BUDGET;
+	base->defer_ran = 0;
+	base->draining = 0;
+	base->fcall_depth = 0;
+	event_set(&base->defer_event, -1, 0, _php_event_defer_callback, base);
+	event_base_set(evbase, &base->defer_event);
+	TSRMLS_SET_CTX(base->thread_ctx);
+}
+/* }}} */
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zbevent, &events) != SUCCESS) {
-		return;
-	}
+static php_event_base_t *_php_event_base_register(struct event_base *evbase TSRMLS_DC) /* {{{ */
+{
+	php_event_base_t *base = emalloc(sizeof(php_event_base_t));
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
+	_php_event_base_init(base, evbase TSRMLS_CC);
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	base->rsrc_id = zend_list_insert(base, le_event_base TSRMLS_CC);
+#else
+	base->rsrc_id = zend_list_insert(base, le_event_base);
+#endif
+	return base;
+}
+/* }}} */
 
-	ret = bufferevent_disable(bevent->bevent, events);
+#ifdef LIBEVENT_2_API
+static void _php_event_config_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	event_config_free((struct event_config *)rsrc->ptr);
+}
+/* }}} */
+#endif
 
-	if (ret == 0) {
-		RETURN_TRUE;
-	}
-	RETURN_FALSE;
+static void _php_event_init(php_event_t *event TSRMLS_DC) /* {{{ */
+{
+	event->rsrc_id = 0;
+	event->handle = 0;
+	event->stream = NULL;
+	event->callback = NULL;
+	event->base = NULL;
+	event->in_free = 0;
+	TSRMLS_SET_CTX(event->thread_ctx);
 }
 /* }}} */
 
-/* {{{ proto void event_buffer_timeout_set(resource bevent, int read_timeout, int write_timeout) 
- */
-static PHP_FUNCTION(event_buffer_timeout_set)
+static void _php_event_clear(php_event_t *event TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
-	long read_timeout, write_timeout;
+	event->in_free = 1;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rll", &zbevent, &read_timeout, &write_timeout) != SUCCESS) {
-		return;
+	if (event->stream) {
+		zval_ptr_dtor(&event->stream);
 	}
+	event_del(event->event);
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
-	bufferevent_settimeout(bevent->bevent, read_timeout, write_timeout);
+	_php_event_callback_dtor(event->callback);
 }
 /* }}} */
 
-/* {{{ proto void event_buffer_watermark_set(resource bevent, int events, int lowmark, int highmark) 
- */
-static PHP_FUNCTION(event_buffer_watermark_set)
+static void _php_event_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent;
-	php_bufferevent_t *bevent;
-	long events, lowmark, highmark;
+	php_event_t *event = (php_event_t*)rsrc->ptr;
+	php_event_base_t *base = event->base;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rlll", &zbevent, &events, &lowmark, &highmark) != SUCCESS) {
+	if (event->in_free) {
 		return;
 	}
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
-	bufferevent_setwatermark(bevent->bevent, events, lowmark, highmark);
+	_php_event_clear(event TSRMLS_CC);
+	_php_event_free(event TSRMLS_CC);
+
+	/* the base goes last, it may go with the event */
+	if (base) {
+		_php_event_base_unpin(base TSRMLS_CC);
+	}
 }
 /* }}} */
 
-/* {{{ proto void event_buffer_fd_set(resource bevent, resource fd) 
- */
-static PHP_FUNCTION(event_buffer_fd_set)
+#ifdef LIBEVENT_2_API
+static void _php_bufferevent_group_leave(php_bufferevent_t *bevent TSRMLS_DC) /* {{{ */
 {
-	zval *zbevent, *zfd;
-	php_stream *stream;
-	php_bufferevent_t *bevent;
-	php_socket_t fd;
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-	php_socket *php_sock;
-#endif
+	php_event_rate_group_t *group = bevent->rate_group;
 
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz", &zbevent, &zfd) != SUCCESS) {
+	if (!group) {
 		return;
 	}
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
+	bufferevent_remove_from_rate_limit_group(bevent->bevent);
 
-	if (Z_TYPE_P(zfd) == IS_RESOURCE) {
-		if (ZEND_FETCH_RESOURCE2_NO_RETURN(stream, php_stream *, &zfd, -1, NULL, php_file_le_stream(), php_file_le_pstream())) {
-			if (php_stream_cast(stream, PHP_STREAM_AS_FD_FOR_SELECT | PHP_STREAM_CAST_INTERNAL, (void*)&fd, 1) != SUCCESS || fd < 0) {
-				RETURN_FALSE;
-			}
-		} else {
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-			if (ZEND_FETCH_RESOURCE_NO_RETURN(php_sock, php_socket *, &zfd, -1, NULL, php_sockets_le_socket())) {
-				fd = php_sock->bsd_socket;
-			} else {
-				php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
-				RETURN_FALSE;
-			}
-#else
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
-			RETURN_FALSE;
-#endif
-		}
-	} else if (Z_TYPE_P(zfd) == IS_LONG) {
-		fd = Z_LVAL_P(zfd);
+	if (bevent->group_prev) {
+		bevent->group_prev->group_next = bevent->group_next;
 	} else {
-#ifdef LIBEVENT_SOCKETS_SUPPORT
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
-#else
-		php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
-#endif
-		RETURN_FALSE;
+		group->members = bevent->group_next;
 	}
+	if (bevent->group_next) {
+		bevent->group_next->group_prev = bevent->group_prev;
+	}
+	bevent->group_prev = bevent->group_next = NULL;
+	bevent->rate_group = NULL;
+	--group->nmembers;
 
-	bufferevent_setfd(bevent->bevent, fd);
+	zend_list_delete(group->rsrc_id);
 }
 /* }}} */
 
-/* {{{ proto resource event_buffer_set_callback(resource bevent, mixed readcb, mixed writecb, mixed errorcb[, mixed arg]) 
- */
-static PHP_FUNCTION(event_buffer_set_callback)
+static void _php_event_rate_group_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
 {
-	php_bufferevent_t *bevent;
-	zval *zbevent, *zreadcb, *zwritecb, *zerrorcb, *zarg = NULL;
-	char *func_name;
-
-	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rzzz|z", &zbevent, &zreadcb, &zwritecb, &zerrorcb, &zarg) != SUCCESS) {
-		return;
+	php_event_rate_group_t *group = (php_event_rate_group_t *)rsrc->ptr;
+	php_bufferevent_t *bevent, *next;
+	php_event_base_t *base = group->base;
+
+	/* members keep the group alive, only a shutdown can leave some behind */
+	for (bevent = group->members; bevent; bevent = next) {
+		next = bevent->group_next;
+		bufferevent_remove_from_rate_limit_group(bevent->bevent);
+		bevent->group_prev = bevent->group_next = NULL;
+		bevent->rate_group = NULL;
 	}
 
-	ZVAL_TO_BEVENT(zbevent, bevent);
+	bufferevent_rate_limit_group_free(group->group);
+	efree(group);
 
-	if (Z_TYPE_P(zreadcb) != IS_NULL) {
-		if (!zend_is_callable(zreadcb, 0, &func_name TSRMLS_CC)) {
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid read callback", func_name);
-			efree(func_name);
-			RETURN_FALSE;
-		}
-		efree(func_name);
-	} else {
-		zreadcb = NULL;
-	}
+	_php_event_base_unpin(base TSRMLS_CC);
+}
+/* }}} */
 
-	if (Z_TYPE_P(zwritecb) != IS_NULL) {
-		if (!zend_is_callable(zwritecb, 0, &func_name TSRMLS_CC)) {
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid write callback", func_name);
-			efree(func_name);
-			RETURN_FALSE;
-		}
-		efree(func_name);
-	} else {
-		zwritecb = NULL;
+static struct ev_token_bucket_cfg *_php_event_rate_cfg_new(long read_rate, long read_burst, long write_rate, long write_burst, long tick TSRMLS_DC) /* {{{ */
+{
+	struct timeval tv;
+	size_t rates[4];
+	long args[4];
+	int i;
+
+	args[0] = read_rate;
+	args[1] = read_burst;
+	args[2] = write_rate;
+	args[3] = write_burst;
+
+	if (read_rate < 0 || read_burst < 0 || write_rate < 0 || write_burst < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "rates and bursts cannot be less than zero");
+		return NULL;
 	}
 
-	if (Z_TYPE_P(zerrorcb) != IS_NULL) {
-		if (!zend_is_callable(zerrorcb, 0, &func_name TSRMLS_CC)) {
-			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid error callback", func_name);
-			efree(func_name);
-			RETURN_FALSE;
-		}
-		efree(func_name);
-	} else {
-		zerrorcb = NULL;
+	if (tick <= 0 || tick > 1000) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "tick must be between 1 and 1000 milliseconds");
+		return NULL;
 	}
 
-	if (zreadcb) {
-		zval_add_ref(&zreadcb);
-		
-		if (bevent->readcb) {
-			zval_ptr_dtor(&bevent->readcb);
+	/* rates are given per second but the buckets are refilled every tick, a zero
+	   rate means unlimited and a burst is at least what one tick brings in */
+	for (i = 0; i < 4; i += 2) {
+		if (args[i] == 0) {
+			rates[i] = rates[i + 1] = EV_RATE_LIMIT_MAX;
+			continue;
 		}
-		bevent->readcb = zreadcb;
-	} else {
-		if (bevent->readcb) {
-			zval_ptr_dtor(&bevent->readcb);
+		rates[i] = (size_t)((double)args[i] * tick / 1000);
+		if (rates[i] == 0) {
+			rates[i] = 1;
 		}
-		bevent->readcb = NULL;
+		rates[i + 1] = (size_t)args[i + 1] < rates[i] ? rates[i] : (size_t)args[i + 1];
 	}
 
-	if (zwritecb) {
-		zval_add_ref(&zwritecb);
-		
-		if (bevent->writecb) {
-			zval_ptr_dtor(&bevent->writecb);
-		}
-		bevent->writecb = zwritecb;
-	} else {
-		if (bevent->writecb) {
-			zval_ptr_dtor(&bevent->writecb);
-		}
-		bevent->writecb = NULL;
+	tv.tv_sec = tick / 1000;
+	tv.tv_usec = (tick % 1000) * 1000;
+
+	return ev_token_bucket_cfg_new(rates[0], rates[1], rates[2], rates[3], &tv);
+}
+/* }}} */
+#endif
+
+static void _php_bufferevent_clear(php_bufferevent_t *bevent TSRMLS_DC) /* {{{ */
+{
+	if (bevent->readcb) {
+		zval_ptr_dtor(&(bevent->readcb));
 	}
-	
-	if (zerrorcb) {
-		zval_add_ref(&zerrorcb);
-		
-		if (bevent->errorcb) {
-			zval_ptr_dtor(&bevent->errorcb);
-		}
-		bevent->errorcb = zerrorcb;
+	if (bevent->writecb) {
+		zval_ptr_dtor(&(bevent->writecb));
 	}
-	
-	if (zarg) {
-		zval_add_ref(&zarg);
-		if (bevent->arg) {
-			zval_ptr_dtor(&bevent->arg);
-		}
-		bevent->arg = zarg;
+	if (bevent->errorcb) {
+		zval_ptr_dtor(&(bevent->errorcb));
+	}
+	if (bevent->arg) {
+		zval_ptr_dtor(&(bevent->arg));
 	}
 
-	RETURN_TRUE;
+#ifdef LIBEVENT_2_API
+	_php_bufferevent_group_leave(bevent TSRMLS_CC);
+#endif
+	bufferevent_free(bevent->bevent);
+#ifdef LIBEVENT_2_API
+	if (bevent->rate_cfg) {
+		ev_token_bucket_cfg_free(bevent->rate_cfg);
+	}
+#endif
+	if (bevent->owned_fd >= 0) {
+		closesocket(bevent->owned_fd);
+	}
 }
 /* }}} */
 
-
-/* {{{ PHP_MINIT_FUNCTION
- */
-static PHP_MINIT_FUNCTION(libevent)
+static void _php_bufferevent_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
 {
-	le_event_base = zend_register_list_destructors_ex(_php_event_base_dtor, NULL, "event base", module_number);
-	le_event = zend_register_list_destructors_ex(_php_event_dtor, NULL, "event", module_number);
-	le_bufferevent = zend_register_list_destructors_ex(_php_bufferevent_dtor, NULL, "buffer event", module_number);
+	php_bufferevent_t *bevent = (php_bufferevent_t*)rsrc->ptr;
+	php_event_base_t *base = bevent->base;
 
-	REGISTER_LONG_CONSTANT("EV_TIMEOUT", EV_TIMEOUT, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EV_READ", EV_READ, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EV_WRITE", EV_WRITE, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EV_SIGNAL", EV_SIGNAL, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EV_PERSIST", EV_PERSIST, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EVLOOP_NONBLOCK", EVLOOP_NONBLOCK, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EVLOOP_ONCE", EVLOOP_ONCE, CONST_CS | CONST_PERSISTENT);
-	
-	REGISTER_LONG_CONSTANT("EVBUFFER_READ", EVBUFFER_READ, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EVBUFFER_WRITE", EVBUFFER_WRITE, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EVBUFFER_EOF", EVBUFFER_EOF, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EVBUFFER_ERROR", EVBUFFER_ERROR, CONST_CS | CONST_PERSISTENT);
-	REGISTER_LONG_CONSTANT("EVBUFFER_TIMEOUT", EVBUFFER_TIMEOUT, CONST_CS | CONST_PERSISTENT);
+	_php_bufferevent_clear(bevent TSRMLS_CC);
+	efree(bevent);
 
-	return SUCCESS;
+	if (base) {
+		_php_event_base_unpin(base TSRMLS_CC);
+	}
 }
 /* }}} */
 
-/* {{{ PHP_MINFO_FUNCTION
- */
-static PHP_MINFO_FUNCTION(libevent)
+static zend_always_inline zval *_php_event_args_get(php_event_base_t *base) /* {{{ */
 {
-	char buf[64];
-
+	zval *z;
 
-	php_info_print_table_start();
-	php_info_print_table_header(2, "libevent support", "enabled");
-	php_info_print_table_row(2, "extension version", PHP_LIBEVENT_VERSION);
-	php_info_print_table_row(2, "Revision", "$Revision$");
-	
-	snprintf(buf, sizeof(buf) - 1, "%s", event_get_version());
-	php_info_print_table_row(2, "libevent version", buf);
+	if (base->args_cached > 0) {
+		return base->args_cache[--base->args_cached];
+	}
+	++base->stats.args_allocated;
+	MAKE_STD_ZVAL(z);
+	return z;
+}
+/* }}} */
 
-	php_info_print_table_end();
+static zend_always_inline void _php_event_args_put(php_event_base_t *base, zval *z) /* {{{ */
+{
+	/* anything the callee held on to has to be left to it */
+	if (Z_REFCOUNT_P(z) > 1 || base->args_cached == LIBEVENT_ARGS_CACHE) {
+		zval_ptr_dtor(&z);
+		return;
+	}
+	zval_dtor(z);
+	INIT_PZVAL(z);
+	base->args_cache[base->args_cached++] = z;
 }
 /* }}} */
 
-#if PHP_MAJOR_VERSION >= 5
-/* {{{ arginfo */
-#if (PHP_MAJOR_VERSION == 5 && PHP_MINOR_VERSION >= 3) || PHP_MAJOR_VERSION > 5
-# define EVENT_ARGINFO
-#else
-# define EVENT_ARGINFO static
+static inline zval *_php_event_fd_to_zval(php_event_t *event, int fd, short events) /* {{{ */
+{
+	zval *zfd;
+
+	/* the stream zval is shared with the callee, its resource is left alone */
+	if (event->stream) {
+		Z_ADDREF_P(event->stream);
+		return event->stream;
+	}
+
+	zfd = _php_event_args_get(event->base);
+	if (fd >= 0) {
+		ZVAL_LONG(zfd, fd);
+	} else {
+		ZVAL_NULL(zfd);
+	}
+	return zfd;
+}
+/* }}} */
+
+static void _php_event_once_callback(int fd, short events, void *arg) /* {{{ */
+{
+	php_event_once_t *once = (php_event_once_t *)arg;
+	php_event_base_t *base = once->base;
+	zval *args[3];
+	TSRMLS_FETCH_FROM_CTX(once->thread_ctx);
+
+	if (once->prev) {
+		once->prev->next = once->next;
+	} else {
+		base->once_live = once->next;
+	}
+	if (once->next) {
+		once->next->prev = once->prev;
+	}
+
+	args[0] = _php_event_args_get(base);
+	if (once->stream_id >= 0) {
+		/* takes over the reference held while waiting */
+		ZVAL_RESOURCE(args[0], once->stream_id);
+	} else if (fd >= 0) {
+		ZVAL_LONG(args[0], fd);
+	} else {
+		ZVAL_NULL(args[0]);
+	}
+
+	args[1] = _php_event_args_get(base);
+	ZVAL_LONG(args[1], events);
+
+	args[2] = once->arg;
+
+	_php_event_base_fcall(base, PHP_EVENT_CB_EVENT, -1, fd, &once->fci, &once->fcc, 3, args TSRMLS_CC);
+
+	_php_event_args_put(base, args[0]);
+	_php_event_args_put(base, args[1]);
+	zval_ptr_dtor(&(args[2]));
+	zval_ptr_dtor(&once->func);
+
+	/* back to the pool, which lives as long as the base */
+	once->next = base->once_free;
+	base->once_free = once;
+}
+/* }}} */
+
+static void _php_event_dispatch(php_event_t *event, int fd, short events TSRMLS_DC) /* {{{ */
+{
+	zval *args[3];
+	php_event_callback_t *callback = event->callback;
+	php_event_base_t *base = event->base;
+
+	args[0] = _php_event_fd_to_zval(event, fd, events);
+
+	args[1] = _php_event_args_get(base);
+	ZVAL_LONG(args[1], events);
+
+	args[2] = callback->arg;
+	Z_ADDREF_P(callback->arg);
+	
+	_php_event_base_fcall(base, PHP_EVENT_CB_EVENT, PHP_EVENT_OWNER_ID(event), fd, &callback->fci, &callback->fcc, 3, args TSRMLS_CC);
+
+	_php_event_args_put(base, args[0]);
+	_php_event_args_put(base, args[1]);
+	zval_ptr_dtor(&(args[2])); 
+	
+}
+/* }}} */
+
+static void _php_event_batch_add(php_event_base_t *base, php_event_t *event, int fd, short events) /* {{{ */
+{
+	php_event_batch_entry_t *entry;
+
+	if (base->batch_len == base->batch_size) {
+		base->batch_size = base->batch_size ? base->batch_size * 2 : 64;
+		base->batch = safe_erealloc(base->batch, base->batch_size, sizeof(php_event_batch_entry_t), 0);
+	}
+
+	entry = &base->batch[base->batch_len++];
+	entry->event = event;
+	entry->fd = fd;
+	entry->events = events;
+
+	/* keep the event alive until the batch is delivered */
+	PHP_EVENT_OWNER_ADDREF(event);
+}
+/* }}} */
+
+#ifdef LIBEVENT_2_API
+static void _php_event_batch_flush(php_event_base_t *base TSRMLS_DC) /* {{{ */
+{
+	php_event_batch_entry_t *batch = base->batch;
+	int i, len = base->batch_len, size = base->batch_size;
+	zval *args[1], *tuple, *zev;
+
+	if (len == 0) {
+		return;
+	}
+
+	/* detach the queue, callbacks may fire new events on this base */
+	base->batch = NULL;
+	base->batch_len = 0;
+	base->batch_size = 0;
+
+	if (!base->batchcb) {
+		/* batch mode was switched off during this iteration */
+		for (i = 0; i < len; i++) {
+			if (batch[i].event->callback) {
+				_php_event_dispatch(batch[i].event, batch[i].fd, batch[i].events TSRMLS_CC);
+			}
+			PHP_EVENT_OWNER_DELREF(batch[i].event);
+		}
+	} else {
+		MAKE_STD_ZVAL(args[0]);
+		array_init_size(args[0], len);
+
+		for (i = 0; i < len; i++) {
+			php_event_t *event = batch[i].event;
+
+			MAKE_STD_ZVAL(tuple);
+			array_init_size(tuple, 4);
+
+			/* the tuple holds the event from here on instead of the queue */
+			MAKE_STD_ZVAL(zev);
+			PHP_EVENT_OWNER_ZVAL(zev, event, php_event_object_handlers);
+			add_next_index_zval(tuple, zev);
+			PHP_EVENT_OWNER_DELREF(event);
+
+			add_next_index_zval(tuple, _php_event_fd_to_zval(event, batch[i].fd, batch[i].events));
+
+			add_next_index_long(tuple, batch[i].events);
+
+			if (event->callback) {
+				Z_ADDREF_P(event->callback->arg);
+				add_next_index_zval(tuple, event->callback->arg);
+			} else {
+				add_next_index_null(tuple);
+			}
+
+			add_next_index_zval(args[0], tuple);
+		}
+
+		_php_event_base_fcall(base, PHP_EVENT_CB_BATCH, PHP_EVENT_OWNER_ID(base), -1, &base->batchfci, &base->batchfcc, 1, args TSRMLS_CC);
+		zval_ptr_dtor(&(args[0]));
+	}
+
+	if (base->batch == NULL) {
+		/* nothing was queued meanwhile, keep the buffer for the next iteration */
+		base->batch = batch;
+		base->batch_size = size;
+	} else {
+		efree(batch);
+	}
+}
+/* }}} */
+
+static int _php_event_base_run(php_event_base_t *base, int flags TSRMLS_DC) /* {{{ */
+{
+	/* the loop is driven one iteration at a time, so that fired events can
+	 * be delivered in batches and the time spent outside of PHP callbacks
+	 * can be accounted to the backend */
+	int own_batch = !base->batching;
+	int ret;
+
+	do {
+		int64_t start;
+
+		if (own_batch) {
+			base->batching = (base->batchcb != NULL);
+		}
+		base->iteration_callback_time = 0;
+		base->defer_ran = 0;
+
+		start = _php_event_clock_nsec();
+		ret = event_base_loop(base->base, flags | EVLOOP_ONCE);
+		base->stats.backend_time += _php_event_clock_nsec() - start - base->iteration_callback_time;
+		++base->stats.iterations;
+
+		if (own_batch) {
+			_php_event_batch_flush(base TSRMLS_CC);
+		}
+	} while (ret == 0 && !(flags & (EVLOOP_ONCE | EVLOOP_NONBLOCK))
+			&& !event_base_got_break(base->base) && !event_base_got_exit(base->base));
+
+	if (own_batch) {
+		base->batching = 0;
+	}
+	return ret;
+}
+/* }}} */
+#endif
+
+static void _php_event_callback(int fd, short events, void *arg) /* {{{ */
+{
+	php_event_t *event = (php_event_t *)arg;
+	TSRMLS_FETCH_FROM_CTX(event ? event->thread_ctx : NULL);
+
+	if (!event || !event->callback || !event->base) {
+		return;
+	}
+
+	if (event->base->batching) {
+		_php_event_batch_add(event->base, event, fd, events);
+		return;
+	}
+
+	_php_event_dispatch(event, fd, events TSRMLS_CC);
+}
+/* }}} */
+
+static void _php_bufferevent_readcb(struct bufferevent *be, void *arg) /* {{{ */
+{
+	zval *args[2];
+	php_bufferevent_t *bevent = (php_bufferevent_t *)arg;
+	php_event_base_t *base;
+	TSRMLS_FETCH_FROM_CTX(bevent ? bevent->thread_ctx : NULL);
+
+	if (!bevent || !bevent->base || !bevent->readcb) {
+		return;
+	}
+	base = bevent->base;
+
+	args[0] = _php_event_args_get(base);
+	PHP_EVENT_OWNER_ZVAL(args[0], bevent, php_bufferevent_object_handlers);
+	
+	args[1] = bevent->arg;
+	Z_ADDREF_P(args[1]);
+	
+	_php_event_base_fcall(base, PHP_EVENT_CB_READ, PHP_EVENT_OWNER_ID(bevent), PHP_BEVENT_FD(be), &bevent->readfci, &bevent->readfcc, 2, args TSRMLS_CC);
+
+	_php_event_args_put(base, args[0]);
+	zval_ptr_dtor(&(args[1])); 
+
+}
+/* }}} */
+
+static void _php_bufferevent_writecb(struct bufferevent *be, void *arg) /* {{{ */
+{
+	zval *args[2];
+	php_bufferevent_t *bevent = (php_bufferevent_t *)arg;
+	php_event_base_t *base;
+	TSRMLS_FETCH_FROM_CTX(bevent ? bevent->thread_ctx : NULL);
+
+	if (!bevent || !bevent->base || !bevent->writecb) {
+		return;
+	}
+	base = bevent->base;
+
+	args[0] = _php_event_args_get(base);
+	PHP_EVENT_OWNER_ZVAL(args[0], bevent, php_bufferevent_object_handlers);
+	
+	args[1] = bevent->arg;
+	Z_ADDREF_P(args[1]);
+	
+	_php_event_base_fcall(base, PHP_EVENT_CB_WRITE, PHP_EVENT_OWNER_ID(bevent), PHP_BEVENT_FD(be), &bevent->writefci, &bevent->writefcc, 2, args TSRMLS_CC);
+
+	_php_event_args_put(base, args[0]);
+	zval_ptr_dtor(&(args[1])); 
+	
+}
+/* }}} */
+
+#ifdef LIBEVENT_2_API
+static void _php_bufferevent_ref_cleanup(const void *data, size_t datalen, void *extra) /* {{{ */
+{
+	zval *zdata = (zval *)extra;
+
+	zval_ptr_dtor(&zdata);
+}
+/* }}} */
+
+static int _php_event_evbuffer_add_zval(struct evbuffer *buf, zval *zdata) /* {{{ */
+{
+	zval tmp;
+	int ret;
+
+	if (Z_TYPE_P(zdata) != IS_STRING) {
+		tmp = *zdata;
+		zval_copy_ctor(&tmp);
+		convert_to_string(&tmp);
+		ret = evbuffer_add(buf, Z_STRVAL(tmp), Z_STRLEN(tmp));
+		zval_dtor(&tmp);
+		return ret;
+	}
+
+	if (Z_ISREF_P(zdata) || Z_STRLEN_P(zdata) < LIBEVENT_WRITE_REF_MIN) {
+		return evbuffer_add(buf, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata));
+	}
+
+	/* pinned like in event_buffer_write_array() */
+	Z_ADDREF_P(zdata);
+	ret = evbuffer_add_reference(buf, Z_STRVAL_P(zdata), Z_STRLEN_P(zdata), _php_bufferevent_ref_cleanup, zdata);
+	if (ret != 0) {
+		zval_ptr_dtor(&zdata);
+	}
+	return ret;
+}
+/* }}} */
+#endif
+
+static void _php_bufferevent_errorcb(struct bufferevent *be, short what, void *arg) /* {{{ */
+{
+	zval *args[3];
+	php_bufferevent_t *bevent = (php_bufferevent_t *)arg;
+	php_event_base_t *base;
+	TSRMLS_FETCH_FROM_CTX(bevent ? bevent->thread_ctx : NULL);
+
+	if (!bevent || !bevent->base || !bevent->errorcb) {
+		return;
+	}
+	base = bevent->base;
+
+	args[0] = _php_event_args_get(base);
+	PHP_EVENT_OWNER_ZVAL(args[0], bevent, php_bufferevent_object_handlers);
+	
+	args[1] = _php_event_args_get(base);
+	ZVAL_LONG(args[1], what);
+
+	args[2] = bevent->arg;
+	Z_ADDREF_P(args[2]);
+	
+	_php_event_base_fcall(base, PHP_EVENT_CB_ERROR, PHP_EVENT_OWNER_ID(bevent), PHP_BEVENT_FD(be), &bevent->errorfci, &bevent->errorfcc, 3, args TSRMLS_CC);
+
+	_php_event_args_put(base, args[0]);
+	_php_event_args_put(base, args[1]);
+	zval_ptr_dtor(&(args[2])); 
+	
+}
+/* }}} */
+
+static void _php_bufferevent_init(php_bufferevent_t *bevent, php_socket_t fd TSRMLS_DC) /* {{{ */
+{
+	bevent->bevent = bufferevent_new(fd, _php_bufferevent_readcb, _php_bufferevent_writecb, _php_bufferevent_errorcb, bevent);
+	bevent->rsrc_id = 0;
+	bevent->handle = 0;
+	bevent->base = NULL;
+	bevent->readcb = NULL;
+	bevent->writecb = NULL;
+	bevent->errorcb = NULL;
+	bevent->arg = NULL;
+	bevent->owned_fd = -1;
+#ifdef LIBEVENT_2_API
+	bevent->rate_cfg = NULL;
+	bevent->rate_group = NULL;
+	bevent->group_prev = NULL;
+	bevent->group_next = NULL;
+	bevent->pipe_end = NULL;
+	bevent->write_low = 0;
+	bevent->write_high = 0;
+#endif
+
+	TSRMLS_SET_CTX(bevent->thread_ctx);
+}
+/* }}} */
+
+static php_bufferevent_t *_php_bufferevent_new(php_socket_t fd TSRMLS_DC) /* {{{ */
+{
+	php_bufferevent_t *bevent = emalloc(sizeof(php_bufferevent_t));
+
+	_php_bufferevent_init(bevent, fd TSRMLS_CC);
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	bevent->rsrc_id = zend_list_insert(bevent, le_bufferevent TSRMLS_CC);
+#else
+	bevent->rsrc_id = zend_list_insert(bevent, le_bufferevent);
+#endif
+	return bevent;
+}
+/* }}} */
+
+#ifdef LIBEVENT_2_API
+static void _php_event_pipe_readcb(struct bufferevent *be, void *arg) /* {{{ */
+{
+	php_event_pipe_end_t *end = (php_event_pipe_end_t *)arg;
+	struct evbuffer *input = bufferevent_get_input(be);
+	struct evbuffer *output = bufferevent_get_output(end->peer->bevent->bevent);
+	size_t len = evbuffer_get_length(input);
+
+	if (len == 0) {
+		return;
+	}
+
+	/* chains are handed over, the data itself is not copied */
+	if (evbuffer_add_buffer(output, input) == 0) {
+		end->moved += len;
+	}
+
+	if (!end->paused && evbuffer_get_length(output) >= end->pipe->high) {
+		bufferevent_disable(be, EV_READ);
+		end->paused = 1;
+		++end->pipe->pauses;
+	}
+}
+/* }}} */
+
+static void _php_event_pipe_writecb(struct bufferevent *be, void *arg) /* {{{ */
+{
+	php_event_pipe_end_t *end = (php_event_pipe_end_t *)arg;
+	php_event_pipe_end_t *source = end->peer;
+
+	/* the output has drained to the low watermark, let the source read again */
+	if (source->paused) {
+		source->paused = 0;
+		bufferevent_enable(source->bevent->bevent, EV_READ);
+	}
+}
+/* }}} */
+
+static void _php_event_pipe_errorcb(struct bufferevent *be, short what, void *arg) /* {{{ */
+{
+	php_event_pipe_end_t *end = (php_event_pipe_end_t *)arg;
+	php_event_pipe_t *pipe = end->pipe;
+	zval *args[4];
+	TSRMLS_FETCH_FROM_CTX(pipe->thread_ctx);
+
+	/* whatever was read before the EOF still has to reach the peer */
+	_php_event_pipe_readcb(be, arg);
+
+	MAKE_STD_ZVAL(args[0]);
+	ZVAL_RESOURCE(args[0], pipe->rsrc_id);
+	zend_list_addref(pipe->rsrc_id); /* keeps the pipe alive if the callback frees it */
+
+	MAKE_STD_ZVAL(args[1]);
+	PHP_EVENT_OWNER_ZVAL(args[1], end->bevent, php_bufferevent_object_handlers);
+
+	MAKE_STD_ZVAL(args[2]);
+	ZVAL_LONG(args[2], what);
+
+	args[3] = pipe->arg;
+	Z_ADDREF_P(args[3]);
+
+	_php_event_base_fcall(end->bevent->base, PHP_EVENT_CB_PIPE, pipe->rsrc_id, PHP_BEVENT_FD(be), &pipe->fci, &pipe->fcc, 4, args TSRMLS_CC);
+
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+	zval_ptr_dtor(&(args[2]));
+	zval_ptr_dtor(&(args[3]));
+}
+/* }}} */
+
+static void _php_event_pipe_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_event_pipe_t *pipe = (php_event_pipe_t *)rsrc->ptr;
+	int i;
+
+	/* hand both buffer events back to their own callbacks */
+	for (i = 0; i < 2; i++) {
+		php_bufferevent_t *bevent = pipe->ends[i].bevent;
+
+		bufferevent_setcb(bevent->bevent, _php_bufferevent_readcb, _php_bufferevent_writecb, _php_bufferevent_errorcb, bevent);
+		bufferevent_setwatermark(bevent->bevent, EV_WRITE, bevent->write_low, bevent->write_high);
+		if (pipe->ends[i].paused) {
+			bufferevent_enable(bevent->bevent, EV_READ);
+		}
+		bevent->pipe_end = NULL;
+	}
+
+	zval_ptr_dtor(&pipe->callback);
+	zval_ptr_dtor(&pipe->arg);
+
+	for (i = 0; i < 2; i++) {
+		PHP_EVENT_OWNER_DELREF(pipe->ends[i].bevent);
+	}
+	efree(pipe);
+}
+/* }}} */
+#endif
+
+static void _php_event_listener_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_event_listener_t *listener = (php_event_listener_t*)rsrc->ptr;
+	php_event_base_t *base = listener->base;
+
+	event_del(&listener->event);
+
+	zval_ptr_dtor(&listener->acceptcb);
+	if (listener->readcb) {
+		zval_ptr_dtor(&listener->readcb);
+	}
+	if (listener->writecb) {
+		zval_ptr_dtor(&listener->writecb);
+	}
+	if (listener->errorcb) {
+		zval_ptr_dtor(&listener->errorcb);
+	}
+	zval_ptr_dtor(&listener->arg);
+
+	if (listener->stream_id >= 0) {
+		zend_list_delete(listener->stream_id);
+	}
+
+	efree(listener);
+
+	_php_event_base_unpin(base TSRMLS_CC);
+}
+/* }}} */
+
+static php_socket_t _php_event_listener_accept(php_socket_t fd, struct sockaddr *sa, socklen_t *salen TSRMLS_DC) /* {{{ */
+{
+	php_socket_t cfd;
+
+#ifdef HAVE_ACCEPT4
+	cfd = accept4(fd, sa, salen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (cfd >= 0 || errno != ENOSYS) {
+		return cfd;
+	}
+#endif
+	cfd = accept(fd, sa, salen);
+	if (cfd >= 0) {
+		php_set_sock_blocking(cfd, 0 TSRMLS_CC);
+#ifdef FD_CLOEXEC
+		fcntl(cfd, F_SETFD, FD_CLOEXEC);
+#endif
+	}
+	return cfd;
+}
+/* }}} */
+
+static void _php_event_listener_callback(int fd, short events, void *arg) /* {{{ */
+{
+	php_event_listener_t *listener = (php_event_listener_t *)arg;
+	php_bufferevent_t *bevent;
+	zval *args[4], *conn;
+	struct sockaddr_storage sa;
+	socklen_t salen;
+	php_socket_t cfd;
+	char *peer;
+	long peer_len, i;
+	int err, failed = 0;
+	TSRMLS_FETCH_FROM_CTX(listener ? listener->thread_ctx : NULL);
+
+	MAKE_STD_ZVAL(args[1]);
+	array_init(args[1]);
+
+	/* drain the backlog up to the budget so a flood of connections costs one callback */
+	for (i = 0; i < listener->budget; i++) {
+		salen = sizeof(sa);
+		cfd = _php_event_listener_accept(fd, (struct sockaddr *)&sa, &salen TSRMLS_CC);
+		if (cfd < 0) {
+			err = php_socket_errno();
+			if (err == EINTR || err == ECONNABORTED) {
+				continue;
+			}
+			if (err != EAGAIN && err != EWOULDBLOCK) {
+				char buf[256];
+
+				/* the backlog stays readable on EMFILE and friends, stop watching it
+				 * until the callback has made room and enabled the listener again */
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "accept() failed: %s", php_socket_strerror(err, buf, sizeof(buf)));
+				if (listener->enabled) {
+					event_del(&listener->event);
+					listener->enabled = 0;
+				}
+				failed = err;
+			}
+			break;
+		}
+
+		bevent = _php_bufferevent_new(cfd TSRMLS_CC);
+		bevent->owned_fd = cfd;
+
+		if (listener->readcb) {
+			zval_add_ref(&listener->readcb);
+			bevent->readcb = listener->readcb;
+			bevent->readfci = listener->readfci;
+			bevent->readfcc = listener->readfcc;
+		}
+		if (listener->writecb) {
+			zval_add_ref(&listener->writecb);
+			bevent->writecb = listener->writecb;
+			bevent->writefci = listener->writefci;
+			bevent->writefcc = listener->writefcc;
+		}
+		if (listener->errorcb) {
+			zval_add_ref(&listener->errorcb);
+			bevent->errorcb = listener->errorcb;
+			bevent->errorfci = listener->errorfci;
+			bevent->errorfcc = listener->errorfcc;
+		}
+		zval_add_ref(&listener->arg);
+		bevent->arg = listener->arg;
+
+		/* make sure the base is destroyed after the event */
+		bufferevent_base_set(listener->base->base, bevent->bevent);
+		bevent->base = listener->base;
+		_php_event_base_pin(listener->base TSRMLS_CC);
+
+		if (listener->events) {
+			bufferevent_enable(bevent->bevent, listener->events);
+		}
+
+		/* the array holds the only reference, so unclaimed connections are closed */
+		MAKE_STD_ZVAL(conn);
+		array_init_size(conn, 2);
+		add_next_index_resource(conn, bevent->rsrc_id);
+
+		peer = NULL;
+		peer_len = 0;
+		php_network_populate_name_from_sockaddr((struct sockaddr *)&sa, salen, &peer, &peer_len, NULL, NULL TSRMLS_CC);
+		if (peer) {
+			add_next_index_stringl(conn, peer, peer_len, 0);
+		} else {
+			add_next_index_null(conn);
+		}
+
+		add_next_index_zval(args[1], conn);
+	}
+
+	if (zend_hash_num_elements(Z_ARRVAL_P(args[1])) > 0 || failed) {
+		MAKE_STD_ZVAL(args[0]);
+		ZVAL_RESOURCE(args[0], listener->rsrc_id);
+		zend_list_addref(listener->rsrc_id); /* we do refcount-- later in zval_ptr_dtor */
+
+		args[2] = listener->arg;
+		Z_ADDREF_P(args[2]);
+
+		MAKE_STD_ZVAL(args[3]);
+		ZVAL_LONG(args[3], failed);
+
+		_php_event_base_fcall(listener->base, PHP_EVENT_CB_ACCEPT, listener->rsrc_id, fd, &listener->acceptfci, &listener->acceptfcc, 4, args TSRMLS_CC);
+
+		zval_ptr_dtor(&(args[0]));
+		zval_ptr_dtor(&(args[2]));
+		zval_ptr_dtor(&(args[3]));
+	}
+
+	zval_ptr_dtor(&(args[1]));
+}
+/* }}} */
+
+static void _php_timer_wheel_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_timer_wheel_t *wheel = (php_timer_wheel_t*)rsrc->ptr;
+	php_event_base_t *base = wheel->base;
+	int i;
+
+	event_del(&wheel->timer);
+
+	for (i = 0; i < wheel->nodes_len; i++) {
+		if (wheel->nodes[i].arg) {
+			zval_ptr_dtor(&wheel->nodes[i].arg);
+		}
+	}
+	if (wheel->nodes) {
+		efree(wheel->nodes);
+	}
+	efree(wheel->slots);
+	zval_ptr_dtor(&wheel->callback);
+
+	efree(wheel);
+
+	_php_event_base_unpin(base TSRMLS_CC);
+}
+/* }}} */
+
+static void _php_timer_wheel_link(php_timer_wheel_t *wheel, int idx, long timeout) /* {{{ */
+{
+	php_timer_wheel_node_t *node = &wheel->nodes[idx];
+	int64_t deadline = _php_event_clock_usec() - wheel->start + timeout;
+	int64_t ticks;
+
+	/* the first tick starting at or after the deadline, the current one may be well under way */
+	ticks = (deadline + wheel->tick - 1) / wheel->tick - wheel->ticks;
+	if (ticks < 1) {
+		ticks = 1;
+	}
+
+	/* the slot is visited every nslots ticks, rounds counts the visits to skip */
+	node->slot = (int)((wheel->current + ticks) % wheel->nslots);
+	node->rounds = (zend_uint)((ticks - 1) / wheel->nslots);
+	node->prev = TIMER_WHEEL_NONE;
+	node->next = wheel->slots[node->slot];
+	if (node->next != TIMER_WHEEL_NONE) {
+		wheel->nodes[node->next].prev = idx;
+	}
+	wheel->slots[node->slot] = idx;
+}
+/* }}} */
+
+static void _php_timer_wheel_unlink(php_timer_wheel_t *wheel, int idx) /* {{{ */
+{
+	php_timer_wheel_node_t *node = &wheel->nodes[idx];
+
+	if (node->prev != TIMER_WHEEL_NONE) {
+		wheel->nodes[node->prev].next = node->next;
+	} else {
+		wheel->slots[node->slot] = node->next;
+	}
+	if (node->next != TIMER_WHEEL_NONE) {
+		wheel->nodes[node->next].prev = node->prev;
+	}
+	node->slot = TIMER_WHEEL_NONE;
+}
+/* }}} */
+
+static void _php_timer_wheel_release(php_timer_wheel_t *wheel, int idx) /* {{{ */
+{
+	php_timer_wheel_node_t *node = &wheel->nodes[idx];
+
+	node->arg = NULL;
+	node->gen = (node->gen + 1) & TIMER_WHEEL_GEN_MASK;
+	if (node->gen == 0) {
+		node->gen = 1;
+	}
+	node->next = wheel->free_head;
+	wheel->free_head = idx;
+	--wheel->count;
+}
+/* }}} */
+
+static php_timer_wheel_node_t *_php_timer_wheel_find(php_timer_wheel_t *wheel, long handle, int *idx) /* {{{ */
+{
+	php_timer_wheel_node_t *node;
+
+	if (handle <= 0) {
+		return NULL;
+	}
+
+	*idx = TIMER_WHEEL_HANDLE_IDX(handle);
+	if (*idx >= wheel->nodes_len) {
+		return NULL;
+	}
+
+	node = &wheel->nodes[*idx];
+	if (!node->arg || node->gen != TIMER_WHEEL_HANDLE_GEN(handle)) {
+		return NULL;
+	}
+	return node;
+}
+/* }}} */
+
+static void _php_timer_wheel_arm(php_timer_wheel_t *wheel) /* {{{ */
+{
+	struct timeval time;
+	int64_t delay;
+
+	if (!wheel->armed) {
+		wheel->start = _php_event_clock_usec();
+		wheel->ticks = 0;
+		wheel->armed = 1;
+		delay = wheel->tick;
+	} else {
+		delay = wheel->start + (wheel->ticks + 1) * wheel->tick - _php_event_clock_usec();
+		if (delay < 0) {
+			delay = 0;
+		}
+	}
+
+	time.tv_usec = (long)(delay % 1000000);
+	time.tv_sec = (long)(delay / 1000000);
+	event_add(&wheel->timer, &time);
+}
+/* }}} */
+
+static void _php_timer_wheel_callback(int fd, short events, void *arg) /* {{{ */
+{
+	php_timer_wheel_t *wheel = (php_timer_wheel_t *)arg;
+	zval *args[2], *expired = NULL;
+	int64_t due;
+	TSRMLS_FETCH_FROM_CTX(wheel->thread_ctx);
+
+	/* a tick is only processed once its time has come, the timer may fire a bit early */
+	due = (_php_event_clock_usec() - wheel->start) / wheel->tick;
+
+	/* catch up with every tick elapsed since the last run */
+	while (wheel->ticks < due) {
+		int idx, next;
+
+		++wheel->ticks;
+		wheel->current = (wheel->current + 1) % wheel->nslots;
+
+		for (idx = wheel->slots[wheel->current]; idx != TIMER_WHEEL_NONE; idx = next) {
+			php_timer_wheel_node_t *node = &wheel->nodes[idx];
+
+			next = node->next;
+			if (node->rounds > 0) {
+				--node->rounds;
+				continue;
+			}
+
+			_php_timer_wheel_unlink(wheel, idx);
+			if (!expired) {
+				MAKE_STD_ZVAL(expired);
+				array_init(expired);
+			}
+			/* the array takes over the reference to arg */
+			add_index_zval(expired, TIMER_WHEEL_HANDLE(idx, node->gen), node->arg);
+			_php_timer_wheel_release(wheel, idx);
+		}
+	}
+
+	if (wheel->count > 0) {
+		_php_timer_wheel_arm(wheel);
+	} else {
+		wheel->armed = 0;
+	}
+
+	if (!expired) {
+		return;
+	}
+
+	args[0] = expired;
+
+	MAKE_STD_ZVAL(args[1]);
+	ZVAL_RESOURCE(args[1], wheel->rsrc_id);
+	zend_list_addref(wheel->rsrc_id); /* we do refcount-- later in zval_ptr_dtor */
+
+	_php_event_base_fcall(wheel->base, PHP_EVENT_CB_TIMER_WHEEL, wheel->rsrc_id, -1, &wheel->fci, &wheel->fcc, 2, args TSRMLS_CC);
+
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+}
+/* }}} */
+
+#ifdef LIBEVENT_2_API
+static void _php_event_dns_waiter_free(php_event_dns_waiter_t *waiter) /* {{{ */
+{
+	zval_ptr_dtor(&waiter->callback);
+	zval_ptr_dtor(&waiter->arg);
+	if (waiter->result) {
+		zval_ptr_dtor(&waiter->result);
+	}
+	efree(waiter);
+}
+/* }}} */
+
+static void _php_event_dns_entry_dtor(void *data) /* {{{ */
+{
+	php_event_dns_entry_t *entry = *(php_event_dns_entry_t **)data;
+	php_event_dns_waiter_t *waiter, *next;
+
+	for (waiter = entry->waiters; waiter; waiter = next) {
+		next = waiter->next;
+		_php_event_dns_waiter_free(waiter);
+	}
+	if (entry->result) {
+		zval_ptr_dtor(&entry->result);
+	}
+	efree(entry->key);
+	efree(entry);
+}
+/* }}} */
+
+static void _php_event_dns_link(php_event_dns_t *dns, php_event_dns_entry_t *entry) /* {{{ */
+{
+	entry->prev = NULL;
+	entry->next = dns->lru_head;
+	if (dns->lru_head) {
+		dns->lru_head->prev = entry;
+	} else {
+		dns->lru_tail = entry;
+	}
+	dns->lru_head = entry;
+	++dns->cached;
+}
+/* }}} */
+
+static void _php_event_dns_unlink(php_event_dns_t *dns, php_event_dns_entry_t *entry) /* {{{ */
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		dns->lru_head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		dns->lru_tail = entry->prev;
+	}
+	entry->prev = entry->next = NULL;
+	--dns->cached;
+}
+/* }}} */
+
+static void _php_event_dns_evict(php_event_dns_t *dns, long keep) /* {{{ */
+{
+	php_event_dns_entry_t *entry;
+
+	while (dns->cached > keep) {
+		entry = dns->lru_tail;
+		_php_event_dns_unlink(dns, entry);
+		zend_hash_del(&dns->cache, entry->key, entry->key_len + 1);
+		++dns->evictions;
+	}
+}
+/* }}} */
+
+static void _php_event_dns_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_event_dns_t *dns = (php_event_dns_t *)rsrc->ptr;
+	php_event_dns_waiter_t *waiter, *next;
+	php_event_base_t *base = dns->base;
+
+	event_del(&dns->ready_event);
+
+	/* lookups still in flight are dropped without calling back */
+	evdns_base_free(dns->evdns, 0);
+	zend_hash_destroy(&dns->cache);
+
+	for (waiter = dns->ready; waiter; waiter = next) {
+		next = waiter->next;
+		_php_event_dns_waiter_free(waiter);
+	}
+
+	efree(dns);
+
+	_php_event_base_unpin(base TSRMLS_CC);
+}
+/* }}} */
+
+static zval *_php_event_dns_result(char type, int count, void *addresses) /* {{{ */
+{
+	zval *result;
+	char addr[64];
+	int i;
+
+	MAKE_STD_ZVAL(result);
+	array_init_size(result, count);
+
+	for (i = 0; i < count; i++) {
+		switch (type) {
+			case DNS_IPv4_A:
+				if (evutil_inet_ntop(AF_INET, (ev_uint32_t *)addresses + i, addr, sizeof(addr))) {
+					add_next_index_string(result, addr, 1);
+				}
+				break;
+			case DNS_IPv6_AAAA:
+				if (evutil_inet_ntop(AF_INET6, (struct in6_addr *)addresses + i, addr, sizeof(addr))) {
+					add_next_index_string(result, addr, 1);
+				}
+				break;
+			case DNS_PTR:
+				add_next_index_string(result, ((char **)addresses)[i], 1);
+				break;
+		}
+	}
+	return result;
+}
+/* }}} */
+
+static void _php_event_dns_deliver(php_event_dns_t *dns, php_event_dns_waiter_t *waiter, zval *result, int error, int ttl TSRMLS_DC) /* {{{ */
+{
+	zval *args[4];
+
+	if (result) {
+		args[0] = result;
+		Z_ADDREF_P(args[0]);
+	} else {
+		MAKE_STD_ZVAL(args[0]);
+		ZVAL_FALSE(args[0]);
+	}
+
+	MAKE_STD_ZVAL(args[1]);
+	ZVAL_LONG(args[1], error);
+	MAKE_STD_ZVAL(args[2]);
+	ZVAL_LONG(args[2], ttl);
+
+	args[3] = waiter->arg;
+	Z_ADDREF_P(args[3]);
+
+	_php_event_base_fcall(dns->base, PHP_EVENT_CB_DNS, dns->rsrc_id, -1, &waiter->fci, &waiter->fcc, 4, args TSRMLS_CC);
+
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+	zval_ptr_dtor(&(args[2]));
+	zval_ptr_dtor(&(args[3]));
+}
+/* }}} */
+
+static void _php_event_dns_callback(int error, char type, int count, int ttl, void *addresses, void *arg) /* {{{ */
+{
+	php_event_dns_entry_t *entry = (php_event_dns_entry_t *)arg;
+	php_event_dns_t *dns = entry->dns;
+	php_event_dns_waiter_t *waiter, *next, *waiters = NULL;
+	zval *result = NULL;
+	int rsrc_id = dns->rsrc_id;
+	TSRMLS_FETCH_FROM_CTX(dns->thread_ctx);
+
+	--dns->inflight;
+
+	if (error == DNS_ERR_NONE) {
+		result = _php_event_dns_result(type, count, addresses);
+	}
+
+	/* waiters were pushed onto a stack, call them back in submission order */
+	for (waiter = entry->waiters; waiter; waiter = next) {
+		next = waiter->next;
+		waiter->next = waiters;
+		waiters = waiter;
+	}
+	entry->waiters = NULL;
+
+	if (result && ttl > 0 && dns->cache_size > 0) {
+		Z_ADDREF_P(result);
+		entry->result = result;
+		entry->expires = _php_event_clock_nsec() + (int64_t)ttl * 1000000000;
+		_php_event_dns_link(dns, entry);
+		_php_event_dns_evict(dns, dns->cache_size);
+	} else {
+		/* failures are not cached, the next lookup asks the nameservers again */
+		zend_hash_del(&dns->cache, entry->key, entry->key_len + 1);
+	}
+
+	for (waiter = waiters; waiter; waiter = next) {
+		next = waiter->next;
+		_php_event_dns_deliver(dns, waiter, result, error, ttl TSRMLS_CC);
+		_php_event_dns_waiter_free(waiter);
+	}
+	if (result) {
+		zval_ptr_dtor(&result);
+	}
+
+	/* the lookup kept the resolver alive until now */
+	zend_list_delete(rsrc_id);
+}
+/* }}} */
+
+static void _php_event_dns_ready_callback(int fd, short events, void *arg) /* {{{ */
+{
+	php_event_dns_t *dns = (php_event_dns_t *)arg;
+	php_event_dns_waiter_t *waiter, *next, *waiters = NULL;
+	int rsrc_id = dns->rsrc_id;
+	TSRMLS_FETCH_FROM_CTX(dns->thread_ctx);
+
+	for (waiter = dns->ready; waiter; waiter = next) {
+		next = waiter->next;
+		waiter->next = waiters;
+		waiters = waiter;
+	}
+	dns->ready = NULL;
+
+	zend_list_addref(rsrc_id);
+	for (waiter = waiters; waiter; waiter = next) {
+		next = waiter->next;
+		_php_event_dns_deliver(dns, waiter, waiter->result, DNS_ERR_NONE, waiter->ttl TSRMLS_CC);
+		_php_event_dns_waiter_free(waiter);
+	}
+	zend_list_delete(rsrc_id);
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_2_API
+static void _php_event_http_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_event_http_t *http = (php_event_http_t *)rsrc->ptr;
+	php_event_base_t *base = http->base;
+
+	evhttp_free(http->http);
+
+	zval_ptr_dtor(&http->handler);
+	zval_ptr_dtor(&http->arg);
+
+	efree(http);
+
+	_php_event_base_unpin(base TSRMLS_CC);
+}
+/* }}} */
+
+static struct evhttp_request *_php_event_http_req_release(php_event_http_req_t *hreq) /* {{{ */
+{
+	struct evhttp_request *req = hreq->req;
+	struct evhttp_connection *evcon;
+
+	/* the connection must not call back into a request we no longer track */
+	evcon = evhttp_request_get_connection(req);
+	if (evcon) {
+		evhttp_connection_set_closecb(evcon, NULL, NULL);
+	}
+	hreq->req = NULL;
+	return req;
+}
+/* }}} */
+
+static void _php_event_http_req_closecb(struct evhttp_connection *evcon, void *arg) /* {{{ */
+{
+	php_event_http_req_t *hreq = (php_event_http_req_t *)arg;
+	struct evhttp_request *req = hreq->req;
+
+	if (!req) {
+		return;
+	}
+	hreq->req = NULL;
+
+	/* evhttp frees the requests still queued on the connection, but one the
+	 * handler has not answered yet is detached from it and left to us */
+	if (!evhttp_request_get_connection(req)) {
+		evhttp_request_free(req);
+	}
+}
+/* }}} */
+
+static void _php_event_http_req_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_event_http_req_t *hreq = (php_event_http_req_t *)rsrc->ptr;
+	int http_id = hreq->http->rsrc_id;
+	struct evhttp_request *req;
+
+	/* a request dropped without an answer would stall its connection */
+	if (hreq->req) {
+		req = _php_event_http_req_release(hreq);
+		if (hreq->chunked) {
+			evhttp_send_reply_end(req);
+		} else {
+			evhttp_send_error(req, HTTP_INTERNAL, NULL);
+		}
+	}
+	efree(hreq);
+
+	zend_list_delete(http_id);
+}
+/* }}} */
+
+static void _php_event_http_callback(struct evhttp_request *req, void *arg) /* {{{ */
+{
+	php_event_http_t *http = (php_event_http_t *)arg;
+	php_event_http_req_t *hreq;
+	zval *args[2];
+	TSRMLS_FETCH_FROM_CTX(http->thread_ctx);
+
+	hreq = emalloc(sizeof(php_event_http_req_t));
+	hreq->req = req;
+	hreq->chunked = 0;
+
+	/* the client may go away before a deferred answer, forget the request then */
+	evhttp_connection_set_closecb(evhttp_request_get_connection(req), _php_event_http_req_closecb, hreq);
+
+	/* make sure the server is destroyed after the request */
+	hreq->http = http;
+	zend_list_addref(http->rsrc_id);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	hreq->rsrc_id = zend_list_insert(hreq, le_event_http_req TSRMLS_CC);
+#else
+	hreq->rsrc_id = zend_list_insert(hreq, le_event_http_req);
+#endif
+
+	/* the argument holds the only reference, the handler keeps it to answer later */
+	MAKE_STD_ZVAL(args[0]);
+	ZVAL_RESOURCE(args[0], hreq->rsrc_id);
+
+	args[1] = http->arg;
+	Z_ADDREF_P(args[1]);
+
+	_php_event_base_fcall(http->base, PHP_EVENT_CB_HTTP, http->rsrc_id, -1, &http->fci, &http->fcc, 2, args TSRMLS_CC);
+
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+}
+/* }}} */
+
+static int _php_event_http_req_check(php_event_http_req_t *hreq TSRMLS_DC) /* {{{ */
+{
+	if (!hreq->req) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "the request has already been answered or its connection closed");
+		return FAILURE;
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+static const char *_php_event_http_method(enum evhttp_cmd_type cmd) /* {{{ */
+{
+	switch (cmd) {
+		case EVHTTP_REQ_GET:
+			return "GET";
+		case EVHTTP_REQ_POST:
+			return "POST";
+		case EVHTTP_REQ_HEAD:
+			return "HEAD";
+		case EVHTTP_REQ_PUT:
+			return "PUT";
+		case EVHTTP_REQ_DELETE:
+			return "DELETE";
+		case EVHTTP_REQ_OPTIONS:
+			return "OPTIONS";
+		case EVHTTP_REQ_TRACE:
+			return "TRACE";
+		case EVHTTP_REQ_CONNECT:
+			return "CONNECT";
+		case EVHTTP_REQ_PATCH:
+			return "PATCH";
+	}
+	return "UNKNOWN";
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_SPLICE_SUPPORT
+static void _php_event_relay_stats(php_event_relay_t *relay, zval *stats) /* {{{ */
+{
+	array_init(stats);
+	add_assoc_long(stats, "a_to_b", (long)relay->dirs[0].bytes);
+	add_assoc_long(stats, "b_to_a", (long)relay->dirs[1].bytes);
+	add_assoc_long(stats, "pending", (long)(relay->dirs[0].pending + relay->dirs[1].pending));
+	add_assoc_long(stats, "error", relay->error);
+}
+/* }}} */
+
+static void _php_event_relay_close(php_event_relay_t *relay, short what TSRMLS_DC) /* {{{ */
+{
+	zval *args[4];
+	int i;
+
+	relay->closed = 1;
+	for (i = 0; i < 2; i++) {
+		event_del(&relay->dirs[i].read_event);
+		event_del(&relay->dirs[i].write_event);
+	}
+
+	MAKE_STD_ZVAL(args[0]);
+	ZVAL_RESOURCE(args[0], relay->rsrc_id);
+	zend_list_addref(relay->rsrc_id); /* keeps the relay alive if the callback frees it */
+
+	MAKE_STD_ZVAL(args[1]);
+	ZVAL_LONG(args[1], what);
+
+	MAKE_STD_ZVAL(args[2]);
+	_php_event_relay_stats(relay, args[2]);
+
+	args[3] = relay->arg;
+	Z_ADDREF_P(args[3]);
+
+	_php_event_base_fcall(relay->base, PHP_EVENT_CB_RELAY, relay->rsrc_id, -1, &relay->fci, &relay->fcc, 4, args TSRMLS_CC);
+
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+	zval_ptr_dtor(&(args[2]));
+	zval_ptr_dtor(&(args[3]));
+}
+/* }}} */
+
+static short _php_event_relay_pump(php_event_relay_dir_t *dir) /* {{{ */
+{
+	php_event_relay_t *relay = dir->relay;
+	php_socket_t src = relay->fds[dir->idx], dst = relay->fds[1 - dir->idx];
+	ssize_t n;
+	int rounds;
+
+	for (rounds = 0; rounds < LIBEVENT_SPLICE_ROUNDS; rounds++) {
+		/* flush the pipe first, it is only refilled once empty */
+		while (dir->pending > 0) {
+			n = splice(dir->pipe[0], NULL, dst, NULL, dir->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+			if (n > 0) {
+				dir->pending -= n;
+				dir->bytes += n;
+			} else if (n < 0 && errno == EINTR) {
+				continue;
+			} else if (n < 0 && errno == EAGAIN) {
+				event_add(&dir->write_event, NULL);
+				return 0;
+			} else {
+				relay->error = n < 0 ? errno : EPIPE;
+				return EVBUFFER_WRITE | EVBUFFER_ERROR;
+			}
+		}
+
+		n = splice(src, NULL, dir->pipe[1], NULL, relay->chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (n > 0) {
+			dir->pending = n;
+		} else if (n == 0) {
+			/* pass the EOF on, the other direction keeps going */
+			dir->done = 1;
+			shutdown(dst, SHUT_WR);
+			return EVBUFFER_READ | EVBUFFER_EOF;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (errno == EAGAIN) {
+			event_add(&dir->read_event, NULL);
+			return 0;
+		} else {
+			relay->error = errno;
+			return EVBUFFER_READ | EVBUFFER_ERROR;
+		}
+	}
+
+	/* budget used up, resume on the next loop iteration */
+	event_active(&dir->read_event, EV_READ, 1);
+	return 0;
+}
+/* }}} */
+
+static void _php_event_relay_callback(int fd, short events, void *arg) /* {{{ */
+{
+	php_event_relay_dir_t *dir = (php_event_relay_dir_t *)arg;
+	php_event_relay_t *relay = dir->relay;
+	short what;
+	TSRMLS_FETCH_FROM_CTX(relay->thread_ctx);
+
+	if (relay->closed || dir->done) {
+		return;
+	}
+
+	what = _php_event_relay_pump(dir);
+	if (what & EVBUFFER_ERROR) {
+		_php_event_relay_close(relay, what TSRMLS_CC);
+	} else if ((what & EVBUFFER_EOF) && relay->dirs[1 - dir->idx].done) {
+		_php_event_relay_close(relay, EVBUFFER_EOF TSRMLS_CC);
+	}
+}
+/* }}} */
+
+static void _php_event_relay_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_event_relay_t *relay = (php_event_relay_t *)rsrc->ptr;
+	php_event_base_t *base = relay->base;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		php_event_relay_dir_t *dir = &relay->dirs[i];
+
+		event_del(&dir->read_event);
+		event_del(&dir->write_event);
+		close(dir->pipe[0]);
+		close(dir->pipe[1]);
+		if (relay->stream_ids[i] >= 0) {
+			zend_list_delete(relay->stream_ids[i]);
+		}
+	}
+
+	zval_ptr_dtor(&relay->callback);
+	zval_ptr_dtor(&relay->arg);
+
+	efree(relay);
+
+	_php_event_base_unpin(base TSRMLS_CC);
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+static void _php_event_signalfd_release(sigset_t *mask) /* {{{ */
+{
+	sigset_t unblock;
+	int signo;
+
+	sigemptyset(&unblock);
+	for (signo = 1; signo < NSIG; signo++) {
+		if (sigismember(mask, signo) == 1 && --php_event_signalfd_refs[signo] == 0
+				&& sigismember(&php_event_signalfd_blocked, signo) == 1) {
+			sigdelset(&php_event_signalfd_blocked, signo);
+			sigaddset(&unblock, signo);
+		}
+	}
+	pthread_sigmask(SIG_UNBLOCK, &unblock, NULL);
+}
+/* }}} */
+
+static void _php_event_signal_watcher_callback(int fd, short events, void *arg) /* {{{ */
+{
+	php_event_signal_watcher_t *watcher = (php_event_signal_watcher_t *)arg;
+	struct signalfd_siginfo info[LIBEVENT_SIGNALFD_BATCH];
+	zval *args[3], *record;
+	ssize_t n;
+	int i;
+	TSRMLS_FETCH_FROM_CTX(watcher->thread_ctx);
+
+	MAKE_STD_ZVAL(args[1]);
+	array_init(args[1]);
+
+	/* everything pending goes out in one call, signals of the same kind
+	   raised meanwhile have already been merged by the kernel */
+	for (;;) {
+		n = read(watcher->fd, info, sizeof(info));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n < (ssize_t)sizeof(struct signalfd_siginfo)) {
+			break;
+		}
+
+		for (i = 0; i < n / (ssize_t)sizeof(struct signalfd_siginfo); i++) {
+			MAKE_STD_ZVAL(record);
+			array_init_size(record, 5);
+			add_assoc_long(record, "signo", info[i].ssi_signo);
+			add_assoc_long(record, "code", info[i].ssi_code);
+			add_assoc_long(record, "pid", info[i].ssi_pid);
+			add_assoc_long(record, "uid", info[i].ssi_uid);
+			/* exit code or killing signal for SIGCHLD, see code */
+			add_assoc_long(record, "status", info[i].ssi_status);
+			add_next_index_zval(args[1], record);
+		}
+
+		if (n < (ssize_t)sizeof(info)) {
+			break;
+		}
+	}
+
+	if (zend_hash_num_elements(Z_ARRVAL_P(args[1])) == 0) {
+		zval_ptr_dtor(&(args[1]));
+		return;
+	}
+
+	++watcher->wakeups;
+	watcher->received += zend_hash_num_elements(Z_ARRVAL_P(args[1]));
+
+	MAKE_STD_ZVAL(args[0]);
+	ZVAL_RESOURCE(args[0], watcher->rsrc_id);
+	zend_list_addref(watcher->rsrc_id); /* keeps the watcher alive if the callback frees it */
+
+	args[2] = watcher->arg;
+	Z_ADDREF_P(args[2]);
+
+	_php_event_base_fcall(watcher->base, PHP_EVENT_CB_SIGNAL, watcher->rsrc_id, watcher->fd, &watcher->fci, &watcher->fcc, 3, args TSRMLS_CC);
+
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+	zval_ptr_dtor(&(args[2]));
+}
+/* }}} */
+
+static void _php_event_signal_watcher_dtor(zend_rsrc_list_entry *rsrc TSRMLS_DC) /* {{{ */
+{
+	php_event_signal_watcher_t *watcher = (php_event_signal_watcher_t *)rsrc->ptr;
+	php_event_base_t *base = watcher->base;
+
+	event_del(&watcher->event);
+	close(watcher->fd);
+	_php_event_signalfd_release(&watcher->mask);
+
+	zval_ptr_dtor(&watcher->callback);
+	zval_ptr_dtor(&watcher->arg);
+
+	efree(watcher);
+
+	_php_event_base_unpin(base TSRMLS_CC);
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_SUPERVISOR_SUPPORT
+static void _php_event_supervisor_signal(int signo) /* {{{ */
+{
+	switch (signo) {
+		case SIGCHLD:
+			php_event_supervisor_sigchld = 1;
+			break;
+		case SIGHUP:
+			php_event_supervisor_sighup = 1;
+			break;
+		default:
+			php_event_supervisor_sigterm = 1;
+			break;
+	}
+}
+/* }}} */
+
+static php_socket_t _php_event_supervisor_bind(struct sockaddr *sa, socklen_t salen, long backlog TSRMLS_DC) /* {{{ */
+{
+	php_socket_t fd;
+	int on = 1, err;
+
+	fd = socket(sa->sa_family, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+
+	/* every worker gets its own accept queue, the kernel spreads connections among them */
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on)) != 0
+		|| setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (char *)&on, sizeof(on)) != 0
+		|| bind(fd, sa, salen) != 0
+		|| listen(fd, (int)backlog) != 0) {
+		err = errno;
+		closesocket(fd);
+		errno = err;
+		return -1;
+	}
+
+	php_set_sock_blocking(fd, 0 TSRMLS_CC);
+#ifdef FD_CLOEXEC
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+	return fd;
+}
+/* }}} */
+
+static void _php_event_supervisor_drain(int fd, short events, void *arg) /* {{{ */
+{
+	/* the worker ends its request once the loop returns, and is replaced */
+	event_base_loopexit((struct event_base *)arg, NULL);
+}
+/* }}} */
+
+static void _php_event_supervisor_child(php_event_base_t *base, php_event_worker_t *workers, long nworkers, long idx, zend_fcall_info *fci, zend_fcall_info_cache *fcc, zval *zarg, struct sigaction *oldact, sigset_t *oldmask TSRMLS_DC) /* {{{ */
+{
+	zval *args[4];
+	php_stream *stream;
+	struct event drain;
+	long i;
+
+	/* the signals stay blocked until the worker can handle SIGHUP itself */
+	for (i = 0; i < LIBEVENT_SUPERVISOR_SIGNALS; i++) {
+		sigaction(php_event_supervisor_signals[i], &oldact[i], NULL);
+	}
+
+	for (i = 0; i < nworkers; i++) {
+		if (i != idx && workers[i].fd >= 0) {
+			closesocket(workers[i].fd);
+		}
+	}
+
+	if (event_reinit(base->base) != 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to reinitialize the event base in worker %ld", idx);
+		EG(exit_status) = 255;
+		zend_bailout();
+	}
+#ifdef LIBEVENT_ASYNC_SUPPORT
+	if (base->async) {
+		_php_event_async_fork_check(base TSRMLS_CC);
+	}
+#endif
+
+	/* SIGHUP from the supervisor asks the worker to finish the current
+	   iteration and exit, the worker never returns so drain outlives it */
+	event_set(&drain, SIGHUP, EV_SIGNAL | EV_PERSIST, _php_event_supervisor_drain, base->base);
+	event_base_set(base->base, &drain);
+	event_add(&drain, NULL);
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+	/* watchers are left to the supervisor, the worker gets the signals they blocked delivered */
+	for (i = 1; i < NSIG; i++) {
+		if (sigismember(&php_event_signalfd_blocked, (int)i) == 1) {
+			sigdelset(oldmask, (int)i);
+		}
+	}
+#endif
+	sigprocmask(SIG_SETMASK, oldmask, NULL);
+
+	MAKE_STD_ZVAL(args[0]);
+	PHP_EVENT_OWNER_ZVAL(args[0], base, php_event_base_object_handlers);
+
+	MAKE_STD_ZVAL(args[1]);
+	stream = workers[idx].fd >= 0 ? php_stream_sock_open_from_socket(workers[idx].fd, NULL) : NULL;
+	if (stream) {
+		php_stream_to_zval(stream, args[1]);
+	} else {
+		ZVAL_NULL(args[1]);
+	}
+
+	MAKE_STD_ZVAL(args[2]);
+	ZVAL_LONG(args[2], idx);
+
+	args[3] = zarg;
+	Z_ADDREF_P(args[3]);
+
+	_php_event_fcall(fci, fcc, 4, args TSRMLS_CC);
+
+	zval_ptr_dtor(&(args[0]));
+	zval_ptr_dtor(&(args[1]));
+	zval_ptr_dtor(&(args[2]));
+	zval_ptr_dtor(&(args[3]));
+
+	if (EG(exception)) {
+		EG(exit_status) = 255;
+	} else {
+		PHP_EVENT_OWNER_ADDREF(base);
+#ifdef LIBEVENT_2_API
+		_php_event_base_run(base, 0 TSRMLS_CC);
+#else
+		event_base_loop(base->base, 0);
+#endif
+		PHP_EVENT_OWNER_DELREF(base);
+	}
+
+	/* the worker never returns into the supervisor, it ends the request like exit() */
+	zend_bailout();
+}
+/* }}} */
+#endif
+
+/* }}} */
+
+
+/* {{{ proto resource event_base_new() 
+ */
+static PHP_FUNCTION(event_base_new)
+{
+	struct event_base *evbase;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+		return;
+	}
+
+	evbase = event_base_new();
+	if (!evbase) {
+		RETURN_FALSE;
+	}
+
+	RETURN_RESOURCE(_php_event_base_register(evbase TSRMLS_CC)->rsrc_id);
+}
+/* }}} */
+
+#ifdef LIBEVENT_2_API
+/* {{{ proto resource event_config_new()
+ */
+static PHP_FUNCTION(event_config_new)
+{
+	struct event_config *config;
+	int rsrc_id;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+		return;
+	}
+
+	config = event_config_new();
+	if (!config) {
+		RETURN_FALSE;
+	}
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	rsrc_id = zend_list_insert(config, le_event_config TSRMLS_CC);
+#else
+	rsrc_id = zend_list_insert(config, le_event_config);
+#endif
+	RETURN_RESOURCE(rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_config_free(resource config)
+ */
+static PHP_FUNCTION(event_config_free)
+{
+	zval *zconfig;
+	struct event_config *config;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zconfig) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_CONFIG(zconfig, config);
+	zend_list_delete(Z_LVAL_P(zconfig));
+}
+/* }}} */
+
+/* {{{ proto bool event_config_avoid_method(resource config, string method)
+ */
+static PHP_FUNCTION(event_config_avoid_method)
+{
+	zval *zconfig;
+	struct event_config *config;
+	char *method;
+	int method_len;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rs", &zconfig, &method, &method_len) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_CONFIG(zconfig, config);
+
+	if (event_config_avoid_method(config, method) == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_config_require_features(resource config, int features)
+ */
+static PHP_FUNCTION(event_config_require_features)
+{
+	zval *zconfig;
+	struct event_config *config;
+	long features;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zconfig, &features) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_CONFIG(zconfig, config);
+
+	if (event_config_require_features(config, features) == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_config_set_flag(resource config, int flag)
+ */
+static PHP_FUNCTION(event_config_set_flag)
+{
+	zval *zconfig;
+	struct event_config *config;
+	long flag;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zconfig, &flag) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_CONFIG(zconfig, config);
+
+	if (event_config_set_flag(config, flag) == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+/* {{{ proto bool event_config_set_max_dispatch_interval(resource config, int max_interval, int max_callbacks, int min_priority)
+   max_interval is in microseconds, a negative value means no limit */
+static PHP_FUNCTION(event_config_set_max_dispatch_interval)
+{
+	zval *zconfig;
+	struct event_config *config;
+	long max_interval, max_callbacks, min_priority;
+	int ret;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rlll", &zconfig, &max_interval, &max_callbacks, &min_priority) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_CONFIG(zconfig, config);
+
+	if (max_interval < 0) {
+		ret = event_config_set_max_dispatch_interval(config, NULL, max_callbacks, min_priority);
+	} else {
+		struct timeval time;
+
+		time.tv_usec = max_interval % 1000000;
+		time.tv_sec = max_interval / 1000000;
+		ret = event_config_set_max_dispatch_interval(config, &time, max_callbacks, min_priority);
+	}
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto resource event_base_new_with_config(resource config)
+   Returns false when no backend satisfies the configuration */
+static PHP_FUNCTION(event_base_new_with_config)
+{
+	zval *zconfig;
+	struct event_config *config;
+	struct event_base *evbase;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zconfig) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_CONFIG(zconfig, config);
+
+	evbase = event_base_new_with_config(config);
+	if (!evbase) {
+		RETURN_FALSE;
+	}
+
+	RETURN_RESOURCE(_php_event_base_register(evbase TSRMLS_CC)->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto string event_base_get_method(resource base)
+ */
+static PHP_FUNCTION(event_base_get_method)
+{
+	zval *zbase;
+	php_event_base_t *base;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zbase) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+	RETURN_STRING((char *)event_base_get_method(base->base), 1);
+}
+/* }}} */
+
+/* {{{ proto int event_base_get_features(resource base)
+ */
+static PHP_FUNCTION(event_base_get_features)
+{
+	zval *zbase;
+	php_event_base_t *base;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zbase) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+	RETURN_LONG(event_base_get_features(base->base));
+}
+/* }}} */
+#endif
+
+/* {{{ proto bool event_base_reinit()
+ */
+static PHP_FUNCTION(event_base_reinit) {
+    zval *zbase;
+    php_event_base_t *base;
+    int r = 0;
+    if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zbase) != SUCCESS) {
+        return;
+    }
+
+    ZVAL_TO_BASE(zbase, base);
+    r = event_reinit(base->base);
+#ifdef LIBEVENT_ASYNC_SUPPORT
+    /* cancel the inherited jobs now, their channel may never fire in the child */
+    if (r != -1 && base->async && _php_event_async_fork_check(base TSRMLS_CC) != SUCCESS) {
+        r = -1;
+    }
+#endif
+    if (r == -1) {
+        RETURN_FALSE
+    } else {
+        RETURN_TRUE;
+    }
+}
+/* }}} */
+
+#ifdef LIBEVENT_SUPERVISOR_SUPPORT
+/* {{{ proto bool event_supervisor_run(resource base, int workers, mixed callback[, string listen[, mixed arg[, int backlog]]])
+   Forks the workers and supervises them until SIGTERM/SIGINT; each worker calls callback(base, listener, worker, arg) and then runs the base.
+   SIGHUP is passed on to the workers, which leave their loop after the current iteration and are replaced */
+static PHP_FUNCTION(event_supervisor_run)
+{
+	zval *zbase, *zcallback, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_worker_t *workers;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	struct sockaddr_storage sa;
+	socklen_t salen = sizeof(sa);
+	struct sigaction act, oldact[LIBEVENT_SUPERVISOR_SIGNALS];
+	sigset_t mask, oldmask, waitmask;
+	char *listen_addr = NULL, *func_name;
+	int listen_addr_len = 0, status, running = 0, stopping = 0, failed = 0, delayed;
+	long nworkers, backlog = SOMAXCONN, i;
+	pid_t pid;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zlz|s!zl", &zbase, &nworkers, &zcallback, &listen_addr, &listen_addr_len, &zarg, &backlog) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (nworkers <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "workers must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	if (backlog <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "backlog must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	if (listen_addr && php_network_parse_network_address_with_port(listen_addr, listen_addr_len, (struct sockaddr *)&sa, &salen TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to parse address '%s'", listen_addr);
+		RETURN_FALSE;
+	}
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+	} else {
+		ALLOC_INIT_ZVAL(zarg);
+	}
+
+	workers = safe_emalloc(nworkers, sizeof(php_event_worker_t), 0);
+	for (i = 0; i < nworkers; i++) {
+		workers[i].pid = 0;
+		workers[i].fd = -1;
+		workers[i].started = 0;
+	}
+
+	/* the listeners live in the supervisor, so connections queued for a
+	   crashed worker wait for its replacement instead of being reset */
+	if (listen_addr) {
+		for (i = 0; i < nworkers; i++) {
+			workers[i].fd = _php_event_supervisor_bind((struct sockaddr *)&sa, salen, backlog TSRMLS_CC);
+			if (workers[i].fd < 0) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to listen on '%s': %s", listen_addr, strerror(errno));
+				failed = 1;
+				break;
+			}
+		}
+	}
+
+	if (!failed) {
+		sigemptyset(&mask);
+		for (i = 0; i < LIBEVENT_SUPERVISOR_SIGNALS; i++) {
+			sigaddset(&mask, php_event_supervisor_signals[i]);
+		}
+		sigprocmask(SIG_BLOCK, &mask, &oldmask);
+
+		waitmask = oldmask;
+		memset(&act, 0, sizeof(act));
+		act.sa_handler = _php_event_supervisor_signal;
+		sigemptyset(&act.sa_mask);
+		for (i = 0; i < LIBEVENT_SUPERVISOR_SIGNALS; i++) {
+			sigdelset(&waitmask, php_event_supervisor_signals[i]);
+			sigaction(php_event_supervisor_signals[i], &act, &oldact[i]);
+		}
+
+		php_event_supervisor_sigchld = 0;
+		php_event_supervisor_sigterm = 0;
+		php_event_supervisor_sighup = 0;
+
+		for (;;) {
+			delayed = 0;
+			for (i = 0; i < nworkers && !stopping; i++) {
+				if (workers[i].pid > 0) {
+					continue;
+				}
+
+				/* don't let a worker crashing on startup spin the supervisor */
+				if (workers[i].started && time(NULL) - workers[i].started < LIBEVENT_SUPERVISOR_MIN_UPTIME) {
+					delayed = 1;
+					continue;
+				}
+
+				pid = fork();
+				if (pid == 0) {
+					_php_event_supervisor_child(base, workers, nworkers, i, &fci, &fcc, zarg, oldact, &oldmask TSRMLS_CC);
+				} else if (pid < 0) {
+					php_error_docref(NULL TSRMLS_CC, E_WARNING, "fork() failed: %s", strerror(errno));
+					php_event_supervisor_sigterm = 1;
+					failed = 1;
+					break;
+				}
+
+				workers[i].pid = pid;
+				workers[i].started = time(NULL);
+				++running;
+			}
+
+			if (delayed && !stopping) {
+				/* the respawn is retried after the delay, signals are still handled meanwhile */
+				struct timespec delay = {LIBEVENT_SUPERVISOR_MIN_UPTIME, 0};
+
+				if (!php_event_supervisor_sigchld && !php_event_supervisor_sigterm && !php_event_supervisor_sighup) {
+					pselect(0, NULL, NULL, NULL, &delay, &waitmask);
+				}
+			} else {
+				while (!php_event_supervisor_sigchld && !php_event_supervisor_sigterm && !php_event_supervisor_sighup && (running || !stopping)) {
+					sigsuspend(&waitmask);
+				}
+			}
+
+			if (php_event_supervisor_sigterm) {
+				php_event_supervisor_sigterm = 0;
+				if (!stopping) {
+					stopping = 1;
+					for (i = 0; i < nworkers; i++) {
+						if (workers[i].pid > 0) {
+							kill(workers[i].pid, SIGTERM);
+						}
+					}
+				}
+			}
+
+			if (php_event_supervisor_sighup) {
+				php_event_supervisor_sighup = 0;
+				/* workers drain and exit on SIGHUP, then get replaced */
+				for (i = 0; i < nworkers && !stopping; i++) {
+					if (workers[i].pid > 0) {
+						kill(workers[i].pid, SIGHUP);
+					}
+				}
+			}
+
+			php_event_supervisor_sigchld = 0;
+			for (i = 0; i < nworkers; i++) {
+				if (workers[i].pid > 0 && waitpid(workers[i].pid, &status, WNOHANG) == workers[i].pid) {
+					workers[i].pid = 0;
+					--running;
+				}
+			}
+
+			if (stopping && !running) {
+				break;
+			}
+		}
+
+		for (i = 0; i < LIBEVENT_SUPERVISOR_SIGNALS; i++) {
+			sigaction(php_event_supervisor_signals[i], &oldact[i], NULL);
+		}
+		sigprocmask(SIG_SETMASK, &oldmask, NULL);
+	}
+
+	for (i = 0; i < nworkers; i++) {
+		if (workers[i].fd >= 0) {
+			closesocket(workers[i].fd);
+		}
+	}
+	efree(workers);
+	zval_ptr_dtor(&zarg);
+
+	if (failed) {
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_ASYNC_SUPPORT
+/* {{{ proto bool event_async_read_file(resource base, string path, mixed callback[, mixed arg[, int offset[, int length]]])
+   Reads the file on a worker thread, callback(string|false data, int errno, arg) runs on the loop */
+static PHP_FUNCTION(event_async_read_file)
+{
+	zval *zbase, *zcallback, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_job_t *job;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *path, *func_name;
+	int path_len;
+	long offset = 0, length = -1;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zsz|z!ll", &zbase, &path, &path_len, &zcallback, &zarg, &offset, &length) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (strlen(path) != (size_t)path_len) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "path must not contain null bytes");
+		RETURN_FALSE;
+	}
+
+	if (php_check_open_basedir(path TSRMLS_CC)) {
+		RETURN_FALSE;
+	}
+
+	if (offset < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "offset cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	job = _php_event_job_new(PHP_EVENT_JOB_READ_FILE, zcallback, zarg, &fci, &fcc);
+	if (!job) {
+		RETURN_FALSE;
+	}
+	job->path = strdup(path);
+	job->offset = (off_t)offset;
+	job->length = length;
+
+	if (!job->path || _php_event_async_submit(base, job TSRMLS_CC) != SUCCESS) {
+		_php_event_job_free(job TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_async_fsync(resource base, mixed fd, mixed callback[, mixed arg])
+   Flushes the stream and fsync()s it on a worker thread, callback(bool ok, int errno, arg) runs on the loop */
+static PHP_FUNCTION(event_async_fsync)
+{
+	zval *zbase, *zfd, *zcallback, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_job_t *job;
+	php_stream *stream;
+	php_socket_t fd;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzz|z", &zbase, &zfd, &zcallback, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (_php_event_zval_to_fd(zfd, &fd, &stream TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	job = _php_event_job_new(PHP_EVENT_JOB_FSYNC, zcallback, zarg, &fci, &fcc);
+	if (!job) {
+		RETURN_FALSE;
+	}
+	job->fd = fd;
+
+	/* the stream must stay open until the worker is done with its descriptor */
+	if (stream) {
+		php_stream_flush(stream);
+		zend_list_addref(Z_LVAL_P(zfd));
+		job->stream_id = Z_LVAL_P(zfd);
+	}
+
+	if (_php_event_async_submit(base, job TSRMLS_CC) != SUCCESS) {
+		_php_event_job_free(job TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_async_getaddrinfo(resource base, string host, mixed callback[, mixed arg[, int family]])
+   Resolves host on a worker thread, callback(array|false addresses, int error, arg) runs on the loop */
+static PHP_FUNCTION(event_async_getaddrinfo)
+{
+	zval *zbase, *zcallback, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_job_t *job;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *host, *func_name;
+	int host_len;
+	long family = AF_UNSPEC;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zsz|z!l", &zbase, &host, &host_len, &zcallback, &zarg, &family) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (strlen(host) != (size_t)host_len) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "host must not contain null bytes");
+		RETURN_FALSE;
+	}
+
+	if (family != AF_UNSPEC && family != AF_INET && family != AF_INET6) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "family must be AF_INET, AF_INET6 or 0");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	job = _php_event_job_new(PHP_EVENT_JOB_GETADDRINFO, zcallback, zarg, &fci, &fcc);
+	if (!job) {
+		RETURN_FALSE;
+	}
+	job->path = strdup(host);
+	job->family = (int)family;
+
+	if (!job->path || _php_event_async_submit(base, job TSRMLS_CC) != SUCCESS) {
+		_php_event_job_free(job TSRMLS_CC);
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array event_async_stats(resource base[, bool reset])
+   Returns the worker pool depth and the job latencies of the base, times in seconds */
+static PHP_FUNCTION(event_async_stats)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	php_event_async_t *async;
+	zend_bool reset = 0;
+	long queued;
+	int threads;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|b", &zbase, &reset) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+	async = base->async;
+
+	pthread_mutex_lock(&php_event_pool.lock);
+	threads = php_event_pool.nthreads;
+	queued = php_event_pool.queued;
+	pthread_mutex_unlock(&php_event_pool.lock);
+
+	array_init(return_value);
+	add_assoc_long(return_value, "threads", threads);
+	add_assoc_long(return_value, "queued", queued);
+	add_assoc_long(return_value, "pending", async ? async->pending : 0);
+	add_assoc_long(return_value, "submitted", async ? async->submitted : 0);
+	add_assoc_long(return_value, "completed", async ? async->completed : 0);
+	add_assoc_double(return_value, "wait_time", async ? async->wait_time / 1e9 : 0.0);
+	add_assoc_double(return_value, "wait_time_max", async ? async->wait_time_max / 1e9 : 0.0);
+	add_assoc_double(return_value, "run_time", async ? async->run_time / 1e9 : 0.0);
+	add_assoc_double(return_value, "run_time_max", async ? async->run_time_max / 1e9 : 0.0);
+
+	if (reset && async) {
+		async->submitted = 0;
+		async->completed = 0;
+		async->wait_time = 0;
+		async->wait_time_max = 0;
+		async->run_time = 0;
+		async->run_time_max = 0;
+	}
+}
+/* }}} */
+#endif
+
+/* {{{ proto void event_base_free(resource base) 
+ */
+static PHP_FUNCTION(event_base_free)
+{
+	zval *zbase;
+	php_event_base_t *base;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zbase) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (base->events > 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "base has events attached to it and cannot be freed");
+		RETURN_FALSE;
+	}
+
+	zend_list_delete(base->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto int event_base_loop(resource base[, int flags])
+   proto int EventBase::loop([int flags])
+ */
+static PHP_FUNCTION(event_base_loop)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	long flags = 0;
+	int ret;
+
+	if ((zbase = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &flags) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|l", &zbase, &flags) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+	PHP_EVENT_OWNER_ADDREF(base); /* make sure the base cannot be destroyed during the loop */
+#ifdef LIBEVENT_2_API
+	ret = _php_event_base_run(base, flags TSRMLS_CC);
+#else
+	ret = event_base_loop(base->base, flags);
+#endif
+	PHP_EVENT_OWNER_DELREF(base);
+
+	RETURN_LONG(ret);
+}
+/* }}} */
+
+/* {{{ proto bool event_base_loopbreak(resource base)
+   proto bool EventBase::loopbreak()
+ */
+static PHP_FUNCTION(event_base_loopbreak)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	int ret;
+
+	if ((zbase = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zbase) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+	ret = event_base_loopbreak(base->base);
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_base_loopexit(resource base[, int timeout])
+   proto bool EventBase::loopexit([int timeout])
+ */
+static PHP_FUNCTION(event_base_loopexit)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	int ret;
+	long timeout = -1;
+
+	if ((zbase = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &timeout) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|l", &zbase, &timeout) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (timeout < 0) {
+		ret = event_base_loopexit(base->base, NULL);
+	} else {
+		struct timeval time;
+		
+		time.tv_usec = timeout % 1000000;
+		time.tv_sec = timeout / 1000000;
+		ret = event_base_loopexit(base->base, &time);
+	}
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto array event_base_stats(resource base[, bool reset])
+   Returns the dispatch counters of the base, times are in seconds */
+static PHP_FUNCTION(event_base_stats)
+{
+	zval *zbase, *callbacks;
+	php_event_base_t *base;
+	zend_bool reset = 0;
+	int i;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|b", &zbase, &reset) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	array_init(return_value);
+	add_assoc_long(return_value, "iterations", base->stats.iterations);
+
+	MAKE_STD_ZVAL(callbacks);
+	array_init(callbacks);
+	for (i = 0; i < PHP_EVENT_CB_TYPES; i++) {
+		add_assoc_long(callbacks, (char *)php_event_cb_names[i], base->stats.callbacks[i]);
+	}
+	add_assoc_zval(return_value, "callbacks", callbacks);
+
+	add_assoc_double(return_value, "callback_time", base->stats.callback_time / 1e9);
+	add_assoc_double(return_value, "callback_time_max", base->stats.callback_time_max / 1e9);
+	add_assoc_double(return_value, "backend_time", base->stats.backend_time / 1e9);
+	add_assoc_long(return_value, "deferred", base->stats.deferred);
+	add_assoc_long(return_value, "defer_queue", base->defer_len);
+	add_assoc_long(return_value, "defer_queue_max", base->stats.defer_queue_max);
+	add_assoc_long(return_value, "args_allocated", base->stats.args_allocated);
+
+	if (reset) {
+		memset(&base->stats, 0, sizeof(base->stats));
+	}
+}
+/* }}} */
+
+/* {{{ proto bool event_base_profile_enable(resource base[, int threshold[, mixed hook]])
+   Record per callable and per resource latency histograms. When hook is given, it is called as
+   hook(string callable, int fd, float duration, int rsrc_id) for every callback lasting threshold usec or more,
+   rsrc_id being -(h + 1) for the object with handle h and -1 for callbacks not tied to either */
+static PHP_FUNCTION(event_base_profile_enable)
+{
+	zval *zbase, *zhook = NULL;
+	php_event_base_t *base;
+	php_event_profile_t *profile;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	long threshold = 0;
+	char *func_name;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|lz", &zbase, &threshold, &zhook) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (threshold < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "threshold cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	if (zhook && Z_TYPE_P(zhook) == IS_NULL) {
+		zhook = NULL;
+	}
+
+	if (zhook) {
+		if (_php_event_fcall_init(zhook, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+			efree(func_name);
+			RETURN_FALSE;
+		}
+		efree(func_name);
+	}
+
+	if (base->profile) {
+		profile = base->profile;
+		if (profile->hook) {
+			zval_ptr_dtor(&profile->hook);
+		}
+	} else {
+		profile = emalloc(sizeof(php_event_profile_t));
+		zend_hash_init(&profile->callables, 16, NULL, NULL, 0);
+		zend_hash_init(&profile->events, 16, NULL, NULL, 0);
+		base->profile = profile;
+	}
+
+	profile->threshold = (int64_t)threshold * 1000;
+	profile->hook = zhook;
+	if (zhook) {
+		zval_add_ref(&zhook);
+		profile->hookfci = fci;
+		profile->hookfcc = fcc;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_base_profile_disable(resource base)
+   Stop profiling and drop the recorded histograms */
+static PHP_FUNCTION(event_base_profile_disable)
+{
+	zval *zbase;
+	php_event_base_t *base;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zbase) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (!base->profile) {
+		RETURN_FALSE;
+	}
+
+	_php_event_profile_free(base->profile);
+	base->profile = NULL;
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array event_base_get_histograms(resource base[, bool reset])
+   Returns array('callables' => array(name => histogram), 'events' => array(rsrc_id => histogram)), objects being keyed as in the hook */
+static PHP_FUNCTION(event_base_get_histograms)
+{
+	zval *zbase, *callables, *events, *zhist;
+	php_event_base_t *base;
+	php_event_histogram_t *hist;
+	HashPosition pos;
+	zend_bool reset = 0;
+	char *key;
+	uint key_len;
+	ulong index;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|b", &zbase, &reset) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (!base->profile) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "profiling is not enabled on this base");
+		RETURN_FALSE;
+	}
+
+	array_init(return_value);
+
+	MAKE_STD_ZVAL(callables);
+	array_init(callables);
+	for (zend_hash_internal_pointer_reset_ex(&base->profile->callables, &pos);
+			zend_hash_get_current_data_ex(&base->profile->callables, (void **)&hist, &pos) == SUCCESS;
+			zend_hash_move_forward_ex(&base->profile->callables, &pos)) {
+		zend_hash_get_current_key_ex(&base->profile->callables, &key, &key_len, &index, 0, &pos);
+		MAKE_STD_ZVAL(zhist);
+		_php_event_histogram_to_zval(hist, zhist);
+		add_assoc_zval_ex(callables, key, key_len, zhist);
+	}
+	add_assoc_zval(return_value, "callables", callables);
+
+	MAKE_STD_ZVAL(events);
+	array_init(events);
+	for (zend_hash_internal_pointer_reset_ex(&base->profile->events, &pos);
+			zend_hash_get_current_data_ex(&base->profile->events, (void **)&hist, &pos) == SUCCESS;
+			zend_hash_move_forward_ex(&base->profile->events, &pos)) {
+		zend_hash_get_current_key_ex(&base->profile->events, &key, &key_len, &index, 0, &pos);
+		MAKE_STD_ZVAL(zhist);
+		_php_event_histogram_to_zval(hist, zhist);
+		add_index_zval(events, index, zhist);
+	}
+	add_assoc_zval(return_value, "events", events);
+
+	if (reset) {
+		zend_hash_clean(&base->profile->callables);
+		zend_hash_clean(&base->profile->events);
+	}
+}
+/* }}} */
+
+/* {{{ proto bool event_base_set(resource event, resource base)
+   proto bool Event::setBase(EventBase base)
+ */
+static PHP_FUNCTION(event_base_set)
+{
+	zval *zbase, *zevent;
+	php_event_base_t *base, *old_base;
+	php_event_t *event;
+	int ret;
+
+	if ((zevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zbase) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz", &zevent, &zbase) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+	ZVAL_TO_EVENT(zevent, event);
+
+	old_base = event->base;
+	ret = event_base_set(base->base, event->event);
+
+	if (ret == 0) {
+		if (base != old_base) {
+			/* make sure the base is destroyed after the event */
+			_php_event_base_pin(base TSRMLS_CC);
+		}
+
+		if (old_base && base != old_base) {
+			_php_event_base_unpin(old_base TSRMLS_CC);
+		}
+
+		event->base = base;
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_base_priority_init(resource base, int npriorities)
+   proto bool EventBase::priorityInit(int npriorities)
+ */
+static PHP_FUNCTION(event_base_priority_init)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	long npriorities;
+	int ret;
+
+	if ((zbase = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &npriorities) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zl", &zbase, &npriorities) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (npriorities < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "npriorities cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	ret = event_base_priority_init(base->base, npriorities);
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_base_once(resource base, mixed fd, int events, int timeout, mixed callback[, mixed arg])
+   Calls callback(fd, events, arg) once when fd is ready or after timeout microseconds, whichever comes first.
+   Pass -1 as fd for a plain timer and a negative timeout to wait without one. No event resource is involved,
+   and callbacks still pending when the base is destroyed are dropped with it */
+static PHP_FUNCTION(event_base_once)
+{
+	zval *zbase, *zfd, *zcallback, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_once_t *once;
+	php_stream *stream = NULL;
+	php_socket_t fd = -1;
+	long events, timeout;
+	struct timeval time;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzllz|z", &zbase, &zfd, &events, &timeout, &zcallback, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (events & (EV_SIGNAL | EV_PERSIST)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "EV_SIGNAL and EV_PERSIST cannot be used with event_base_once()");
+		RETURN_FALSE;
+	}
+
+	if (Z_TYPE_P(zfd) != IS_LONG || Z_LVAL_P(zfd) != -1) {
+		if (_php_event_zval_to_fd(zfd, &fd, &stream TSRMLS_CC) != SUCCESS) {
+			RETURN_FALSE;
+		}
+	}
+
+	if (fd < 0) {
+		events &= ~(EV_READ | EV_WRITE);
+	}
+
+	if (!(events & (EV_READ | EV_WRITE)) && timeout < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "a timeout is required when not waiting for an fd");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	if (base->once_free) {
+		once = base->once_free;
+		base->once_free = once->next;
+	} else {
+		once = emalloc(sizeof(php_event_once_t));
+	}
+
+	once->base = base;
+	once->fci = fci;
+	once->fcc = fcc;
+	TSRMLS_SET_CTX(once->thread_ctx);
+
+	if (timeout >= 0) {
+		time.tv_usec = timeout % 1000000;
+		time.tv_sec = timeout / 1000000;
+	}
+
+	/* without read or write interest it is a plain timer */
+	if (!(events & (EV_READ | EV_WRITE))) {
+		fd = -1;
+		events = EV_TIMEOUT;
+	}
+
+	event_set(&once->event, (int)fd, (short)events, _php_event_once_callback, once);
+	event_base_set(base->base, &once->event);
+	if (event_add(&once->event, timeout >= 0 ? &time : NULL) != 0) {
+		once->next = base->once_free;
+		base->once_free = once;
+		RETURN_FALSE;
+	}
+
+	zval_add_ref(&zcallback);
+	once->func = zcallback;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		once->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(once->arg);
+	}
+
+	/* keep the stream open until the callback had it */
+	if (stream) {
+		zend_list_addref(Z_LVAL_P(zfd));
+		once->stream_id = Z_LVAL_P(zfd);
+	} else {
+		once->stream_id = -1;
+	}
+
+	once->prev = NULL;
+	once->next = base->once_live;
+	if (once->next) {
+		once->next->prev = once;
+	}
+	base->once_live = once;
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_base_defer(resource base, mixed callback[, mixed arg])
+   Queues callback(arg) to run right after the current callback returns, before the loop polls again.
+   Outside of a callback it runs on the next loop iteration. Tasks run in the order they were deferred */
+static PHP_FUNCTION(event_base_defer)
+{
+	zval *zbase, *zcallback, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_task_t *task;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz|z", &zbase, &zcallback, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	if (base->task_free) {
+		task = base->task_free;
+		base->task_free = task->next;
+	} else {
+		task = emalloc(sizeof(php_event_task_t));
+	}
+
+	zval_add_ref(&zcallback);
+	task->func = zcallback;
+	task->fci = fci;
+	task->fcc = fcc;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		task->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(task->arg);
+	}
+
+	task->next = NULL;
+	if (base->defer_tail) {
+		base->defer_tail->next = task;
+	} else {
+		base->defer_head = task;
+	}
+	base->defer_tail = task;
+
+	if (++base->defer_len > base->stats.defer_queue_max) {
+		base->stats.defer_queue_max = base->defer_len;
+	}
+
+	/* nothing will drain the queue until the loop wakes up */
+	if (base->fcall_depth == 0 && !base->draining) {
+		event_active(&base->defer_event, EV_TIMEOUT, 1);
+	}
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_base_set_defer_budget(resource base, int budget)
+   Sets how many deferred tasks run per loop iteration, the rest wait for the next one */
+static PHP_FUNCTION(event_base_set_defer_budget)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	long budget;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zl", &zbase, &budget) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (budget <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "budget must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	base->defer_budget = budget;
+	RETURN_TRUE;
+}
+/* }}} */
+
+
+#ifdef LIBEVENT_2_API
+/* {{{ proto bool event_base_set_batch_callback(resource base, mixed callback)
+   Deliver all events fired during one loop iteration with a single call to callback(array events),
+   each element being array(event, fd, events, arg). Pass NULL to restore per-event dispatch. */
+static PHP_FUNCTION(event_base_set_batch_callback)
+{
+	zval *zbase, *zcallback;
+	php_event_base_t *base;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz", &zbase, &zcallback) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (Z_TYPE_P(zcallback) == IS_NULL) {
+		if (base->batchcb) {
+			zval_ptr_dtor(&base->batchcb);
+			base->batchcb = NULL;
+		}
+		RETURN_TRUE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	zval_add_ref(&zcallback);
+	if (base->batchcb) {
+		zval_ptr_dtor(&base->batchcb);
+	}
+	base->batchcb = zcallback;
+	base->batchfci = fci;
+	base->batchfcc = fcc;
+
+	RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto array event_pool_stats()
+   Returns the usage counters of the event allocation pool */
+static PHP_FUNCTION(event_pool_stats)
+{
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+		return;
+	}
+
+	array_init(return_value);
+	add_assoc_long(return_value, "hits", LIBEVENT_G(event_pool_hits));
+	add_assoc_long(return_value, "misses", LIBEVENT_G(event_pool_misses));
+	add_assoc_long(return_value, "used", LIBEVENT_G(event_pool_used));
+	add_assoc_long(return_value, "slabs", LIBEVENT_G(event_pool_slabs));
+	add_assoc_long(return_value, "block_size", (long)LIBEVENT_BLOCK_SIZE);
+	add_assoc_long(return_value, "slab_size", (long)(LIBEVENT_SLAB_HEADER + LIBEVENT_CACHE_LINE + LIBEVENT_SLAB_BLOCKS * LIBEVENT_BLOCK_SIZE));
+}
+/* }}} */
+
+/* {{{ proto resource event_new() 
+ */
+static PHP_FUNCTION(event_new)
+{
+	php_event_t *event;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+		return;
+	}
+
+	event = _php_event_alloc(TSRMLS_C);
+	_php_event_init(event TSRMLS_CC);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	event->rsrc_id = zend_list_insert(event, le_event TSRMLS_CC);
+#else
+	event->rsrc_id = zend_list_insert(event, le_event);
+#endif
+	RETURN_RESOURCE(event->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_free(resource event) 
+ */
+static PHP_FUNCTION(event_free)
+{
+	zval *zevent;
+	php_event_t *event;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zevent) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_EVENT(zevent, event);
+	zend_list_delete(event->rsrc_id);
+}
+/* }}} */
+
+static int _php_event_add(php_event_t *event, long timeout TSRMLS_DC) /* {{{ */
+{
+	int ret;
+
+	if (!event->base) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to add event without an event base");
+		return FAILURE;
+	}
+
+	if (timeout < 0) {
+		ret = event_add(event->event, NULL);
+	} else {
+		struct timeval time;
+		
+		time.tv_usec = timeout % 1000000;
+		time.tv_sec = timeout / 1000000;
+		ret = event_add(event->event, &time);
+	}
+
+	return ret == 0 ? SUCCESS : FAILURE;
+}
+/* }}} */
+
+/* {{{ proto bool event_add(resource event[, int timeout])
+   proto bool Event::add([int timeout])
+ */
+static PHP_FUNCTION(event_add)
+{
+	zval *zevent;
+	php_event_t *event;
+	long timeout = -1;
+
+	if ((zevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "|l", &timeout) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|l", &zevent, &timeout) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_EVENT(zevent, event);
+
+	if (_php_event_add(event, timeout TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_set(resource event, mixed fd, int events, mixed callback[, mixed arg])
+   proto bool Event::set(mixed fd, int events, mixed callback[, mixed arg])
+ */
+static PHP_FUNCTION(event_set)
+{
+	zval *zevent, **fd, *zcallback, *zarg = NULL;
+	php_event_t *event;
+	long events;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+	php_stream *stream;
+	php_socket_t file_desc;
+#ifdef LIBEVENT_SOCKETS_SUPPORT
+	php_socket *php_sock;
+#endif
+	int ret;
+
+	if ((zevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "Zlz|z", &fd, &events, &zcallback, &zarg) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zZlz|z", &zevent, &fd, &events, &zcallback, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_EVENT(zevent, event);
+
+	if (events & EV_SIGNAL) {
+		/* signal support */
+		convert_to_long_ex(fd);
+		file_desc = Z_LVAL_PP(fd);
+		if (file_desc < 0 || file_desc >= NSIG) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "invalid signal passed");
+			RETURN_FALSE;
+		}
+	} else {
+		if (Z_TYPE_PP(fd) == IS_RESOURCE) {
+			if (ZEND_FETCH_RESOURCE2_NO_RETURN(stream, php_stream *, fd, -1, NULL, php_file_le_stream(), php_file_le_pstream())) {
+				if (php_stream_cast(stream, PHP_STREAM_AS_FD_FOR_SELECT | PHP_STREAM_CAST_INTERNAL, (void*)&file_desc, 1) != SUCCESS || file_desc < 0) {
+					RETURN_FALSE;
+				}
+			} else {
+#ifdef LIBEVENT_SOCKETS_SUPPORT
+				if (ZEND_FETCH_RESOURCE_NO_RETURN(php_sock, php_socket *, fd, -1, NULL, php_sockets_le_socket())) {
+					file_desc = php_sock->bsd_socket;
+				} else {
+					php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be either valid PHP stream or valid PHP socket resource");
+					RETURN_FALSE;
+				}
+#else
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource");
+				RETURN_FALSE;
+#endif
+			}
+		} else if (Z_TYPE_PP(fd) == IS_LONG) {
+			file_desc = Z_LVAL_PP(fd);
+			if (file_desc < 0) {
+				php_error_docref(NULL TSRMLS_CC, E_WARNING, "invalid file descriptor passed");
+				RETURN_FALSE;
+			}
+		} else {
+#ifdef LIBEVENT_SOCKETS_SUPPORT
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream or socket resource or a file descriptor of type long");
+#else
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "fd argument must be valid PHP stream resource or a file descriptor of type long");
+#endif
+			RETURN_FALSE;
+		}
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	zval_add_ref(&zcallback);
+	if (zarg) {
+		zval_add_ref(&zarg);
+	} else {
+		ALLOC_INIT_ZVAL(zarg);
+	}
+
+	_php_event_callback_set(event, zcallback, zarg, &fci, &fcc);
+	if (event->stream) {
+		zval_ptr_dtor(&event->stream);
+		event->stream = NULL;
+	}
+	if (Z_TYPE_PP(fd) == IS_RESOURCE) {
+		/* our own zval, the one passed in may be a reference that changes later */
+		MAKE_STD_ZVAL(event->stream);
+		ZVAL_RESOURCE(event->stream, Z_RESVAL_PP(fd));
+		zend_list_addref(Z_RESVAL_PP(fd));
+	}
+
+	event_set(event->event, (int)file_desc, (short)events, _php_event_callback, event);
+
+	if (event->base) {
+		ret = event_base_set(event->base->base, event->event);
+		if (ret != 0) {
+			RETURN_FALSE;
+		}
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+static int _php_event_stream_is_raw(php_stream *stream) /* {{{ */
+{
+	/* only plain files and sockets carry the bytes of the fd as is, filters and
+	 * crypto layers like ssl:// must see them first */
+	static const char *labels[] = {"STDIO", "tcp_socket", "udp_socket", "unix_socket", "udg_socket", "generic_socket", NULL};
+	int i;
+
+	if (stream->readfilters.head) {
+		return 0;
+	}
+	for (i = 0; labels[i]; i++) {
+		if (strcmp(stream->ops->label, labels[i]) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+/* }}} */
+
+/* {{{ proto string event_read_drain(mixed fd[, int max_length[, bool &eof]])
+   Read from a non-blocking fd until it would block, hits EOF or max_length bytes have been read.
+   eof is set as well when reading failed, the fd will not deliver anything more then */
+static PHP_FUNCTION(event_read_drain)
+{
+	zval *zfd, *zeof = NULL;
+	long max_length = LIBEVENT_DRAIN_MAX_LENGTH;
+	php_stream *stream;
+	php_socket_t fd;
+	char *data;
+	size_t len = 0, size;
+	int eof = 0, failed = 0, raw;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|lz", &zfd, &max_length, &zeof) != SUCCESS) {
+		return;
+	}
+
+	if (max_length <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "max_length must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_zval_to_fd(zfd, &fd, &stream TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	size = max_length < LIBEVENT_DRAIN_CHUNK ? (size_t)max_length : LIBEVENT_DRAIN_CHUNK;
+	data = emalloc(size + 1);
+
+	/* hand out what the stream layer already buffered before touching the fd */
+	if (stream && stream->writepos > stream->readpos) {
+		size_t buffered = (size_t)(stream->writepos - stream->readpos);
+
+		if (buffered > (size_t)max_length) {
+			buffered = (size_t)max_length;
+		}
+		if (buffered > size) {
+			size = buffered;
+			data = erealloc(data, size + 1);
+		}
+		len = php_stream_read(stream, data, buffered);
+	}
+
+	/* other streams go through the stream layer, a short read means it would block */
+	raw = !stream || _php_event_stream_is_raw(stream);
+	while (!raw && len < (size_t)max_length) {
+		if (len == size) {
+			size = size * 2 > (size_t)max_length ? (size_t)max_length : size * 2;
+			data = erealloc(data, size + 1);
+		}
+
+		len += php_stream_read(stream, data + len, size - len);
+		if (len < size) {
+			eof = php_stream_eof(stream) ? 1 : 0;
+			break;
+		}
+	}
+
+	while (raw && len < (size_t)max_length) {
+		ssize_t n;
+
+		if (len == size) {
+			size = size * 2 > (size_t)max_length ? (size_t)max_length : size * 2;
+			data = erealloc(data, size + 1);
+		}
+
+#ifdef PHP_WIN32
+		n = recv(fd, data + len, (int)(size - len), 0);
+#else
+		n = read(fd, data + len, size - len);
+#endif
+		if (n > 0) {
+			len += n;
+		} else if (n == 0) {
+			eof = 1;
+			break;
+		} else if (php_socket_errno() == EINTR) {
+			continue;
+		} else if (php_socket_errno() == EAGAIN || php_socket_errno() == EWOULDBLOCK) {
+			break;
+		} else {
+			char errbuf[256];
+
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "read failed: %s", php_socket_strerror(php_socket_errno(), errbuf, sizeof(errbuf)));
+			eof = 1;
+			failed = (len == 0);
+			break;
+		}
+	}
+
+	if (zeof) {
+		zval_dtor(zeof);
+		ZVAL_BOOL(zeof, eof);
+	}
+
+	if (failed) {
+		efree(data);
+		RETURN_FALSE;
+	}
+
+	if (size - len > LIBEVENT_DRAIN_CHUNK) {
+		data = erealloc(data, len + 1);
+	}
+	data[len] = '\0';
+	RETURN_STRINGL(data, len, 0);
+}
+/* }}} */
+
+static int _php_event_del(php_event_t *event TSRMLS_DC) /* {{{ */
+{
+	if (!event->base) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to delete event without an event base");
+		return FAILURE;
+	}
+
+	return event_del(event->event) == 0 ? SUCCESS : FAILURE;
+}
+/* }}} */
+
+/* {{{ proto bool event_del(resource event)
+   proto bool Event::del()
+ */
+static PHP_FUNCTION(event_del)
+{
+	zval *zevent;
+	php_event_t *event;
+
+	if ((zevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zevent) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_EVENT(zevent, event);
+
+	if (_php_event_del(event TSRMLS_CC) == SUCCESS) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_priority_set(resource event, int priority)
+   proto bool Event::setPriority(int priority)
+ */
+static PHP_FUNCTION(event_priority_set)
+{
+	zval *zevent;
+	php_event_t *event;
+	long priority;
+	int ret;
+
+	if ((zevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &priority) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zl", &zevent, &priority) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_EVENT(zevent, event);
+
+	if (!event->base) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to set event priority without an event base");
+		RETURN_FALSE;
+	}
+
+	ret = event_priority_set(event->event, priority);
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+enum {
+	PHP_EVENT_MANY_ADD,
+	PHP_EVENT_MANY_DEL,
+	PHP_EVENT_MANY_PRIORITY
+};
+
+static void _php_event_many(zval *zevents, int op, struct timeval *tv, long priority, zval *return_value TSRMLS_DC) /* {{{ */
+{
+	HashTable *ht = Z_ARRVAL_P(zevents);
+	HashPosition pos;
+	zval **entry;
+	char *key;
+	uint key_len;
+	ulong idx;
+
+	array_init_size(return_value, zend_hash_num_elements(ht));
+
+	for (zend_hash_internal_pointer_reset_ex(ht, &pos);
+		 zend_hash_get_current_data_ex(ht, (void **)&entry, &pos) == SUCCESS;
+		 zend_hash_move_forward_ex(ht, &pos)) {
+		php_event_t *event = NULL;
+		int type, ok = 0;
+
+		/* a plain list lookup, a bad element fails on its own without a warning */
+		if (Z_TYPE_PP(entry) == IS_RESOURCE) {
+			event = (php_event_t *)zend_list_find(Z_RESVAL_PP(entry), &type);
+			if (type != le_event) {
+				event = NULL;
+			}
+#if PHP_MAJOR_VERSION >= 5
+		} else if (Z_TYPE_PP(entry) == IS_OBJECT && Z_OBJ_HT_PP(entry) == &php_event_object_handlers) {
+			event = &((php_event_object_t *)zend_object_store_get_object(*entry TSRMLS_CC))->block.event;
+#endif
+		}
+
+		if (event && event->base) {
+			switch (op) {
+				case PHP_EVENT_MANY_ADD:
+					ok = event_add(event->event, tv) == 0;
+					break;
+				case PHP_EVENT_MANY_DEL:
+					ok = event_del(event->event) == 0;
+					break;
+				case PHP_EVENT_MANY_PRIORITY:
+					ok = event_priority_set(event->event, priority) == 0;
+					break;
+			}
+		}
+
+		if (zend_hash_get_current_key_ex(ht, &key, &key_len, &idx, 0, &pos) == HASH_KEY_IS_STRING) {
+			add_assoc_bool_ex(return_value, key, key_len, ok);
+		} else {
+			add_index_bool(return_value, idx, ok);
+		}
+	}
+}
+/* }}} */
+
+/* {{{ proto array event_add_many(array events[, int timeout])
+   Adds every event, resource or Event object, with the same timeout, returns the event_add() result for each key */
+static PHP_FUNCTION(event_add_many)
+{
+	zval *zevents;
+	long timeout = -1;
+	struct timeval time;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a|l", &zevents, &timeout) != SUCCESS) {
+		return;
+	}
+
+	if (timeout < 0) {
+		_php_event_many(zevents, PHP_EVENT_MANY_ADD, NULL, 0, return_value TSRMLS_CC);
+	} else {
+		time.tv_usec = timeout % 1000000;
+		time.tv_sec = timeout / 1000000;
+		_php_event_many(zevents, PHP_EVENT_MANY_ADD, &time, 0, return_value TSRMLS_CC);
+	}
+}
+/* }}} */
+
+/* {{{ proto array event_del_many(array events)
+   Deletes every event, returns the event_del() result for each key */
+static PHP_FUNCTION(event_del_many)
+{
+	zval *zevents;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "a", &zevents) != SUCCESS) {
+		return;
+	}
+
+	_php_event_many(zevents, PHP_EVENT_MANY_DEL, NULL, 0, return_value TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ proto array event_priority_set_many(array events, int priority)
+   Sets the priority of every event, returns the event_priority_set() result for each key */
+static PHP_FUNCTION(event_priority_set_many)
+{
+	zval *zevents;
+	long priority;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "al", &zevents, &priority) != SUCCESS) {
+		return;
+	}
+
+	_php_event_many(zevents, PHP_EVENT_MANY_PRIORITY, NULL, priority, return_value TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ proto bool event_timer_set(resource event, mixed callback[, mixed arg])
+   proto bool Event::setTimer(mixed callback[, mixed arg])
+ */
+static PHP_FUNCTION(event_timer_set)
+{
+	zval *zevent, *zcallback, *zarg = NULL;
+	php_event_t *event;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+
+	if ((zevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|z", &zcallback, &zarg) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz|z", &zevent, &zcallback, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_EVENT(zevent, event);
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	zval_add_ref(&zcallback);
+	if (zarg) {
+		zval_add_ref(&zarg);
+	} else {
+		ALLOC_INIT_ZVAL(zarg);
+	}
+
+	_php_event_callback_set(event, zcallback, zarg, &fci, &fcc);
+	if (event->stream) {
+		zval_ptr_dtor(&event->stream);
+		event->stream = NULL;
+	}
+
+	event_set(event->event, -1, 0, _php_event_callback, event);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_timer_pending(resource event[, int timeout])
+ */
+static PHP_FUNCTION(event_timer_pending)
+{
+	zval *zevent;
+	php_event_t *event;
+	int ret;
+	long timeout = -1;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|l", &zevent, &timeout) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_EVENT(zevent, event);
+
+	if (timeout < 0) {
+		ret = event_pending(event->event, EV_TIMEOUT, NULL);
+	} else {
+		struct timeval time;
+		
+		time.tv_usec = timeout % 1000000;
+		time.tv_sec = timeout / 1000000;
+		ret = event_pending(event->event, EV_TIMEOUT, &time);
+	}
+
+	if (ret != 0) {
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+
+
+/* {{{ proto resource event_timer_wheel_new(resource base, int tick, int slots, mixed callback)
+   Create a timer wheel driven by a single timer on base. Expired timers are delivered
+   once per tick with callback(array expired, resource wheel), expired being handle => arg. */
+static PHP_FUNCTION(event_timer_wheel_new)
+{
+	zval *zbase, *zcallback;
+	php_event_base_t *base;
+	php_timer_wheel_t *wheel;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	long tick, nslots;
+	char *func_name;
+	int i;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zllz", &zbase, &tick, &nslots, &zcallback) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (tick <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "tick must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	if (nslots <= 0 || nslots > INT_MAX / (long)sizeof(int)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "slots out of range");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	wheel = emalloc(sizeof(php_timer_wheel_t));
+	wheel->tick = tick;
+	wheel->nslots = (int)nslots;
+	wheel->slots = safe_emalloc(nslots, sizeof(int), 0);
+	for (i = 0; i < wheel->nslots; i++) {
+		wheel->slots[i] = TIMER_WHEEL_NONE;
+	}
+	wheel->current = 0;
+	wheel->nodes = NULL;
+	wheel->nodes_len = 0;
+	wheel->nodes_size = 0;
+	wheel->free_head = TIMER_WHEEL_NONE;
+	wheel->count = 0;
+	wheel->armed = 0;
+	wheel->start = 0;
+	wheel->ticks = 0;
+
+	zval_add_ref(&zcallback);
+	wheel->callback = zcallback;
+	wheel->fci = fci;
+	wheel->fcc = fcc;
+
+	event_set(&wheel->timer, -1, 0, _php_timer_wheel_callback, wheel);
+	event_base_set(base->base, &wheel->timer);
+
+	/* make sure the base is destroyed after the wheel */
+	wheel->base = base;
+	_php_event_base_pin(base TSRMLS_CC);
+
+	TSRMLS_SET_CTX(wheel->thread_ctx);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	wheel->rsrc_id = zend_list_insert(wheel, le_timer_wheel TSRMLS_CC);
+#else
+	wheel->rsrc_id = zend_list_insert(wheel, le_timer_wheel);
+#endif
+	RETURN_RESOURCE(wheel->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_timer_wheel_free(resource wheel)
+ */
+static PHP_FUNCTION(event_timer_wheel_free)
+{
+	zval *zwheel;
+	php_timer_wheel_t *wheel;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zwheel) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_TIMER_WHEEL(zwheel, wheel);
+	zend_list_delete(wheel->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto int event_timer_wheel_add(resource wheel, int timeout[, mixed arg])
+   Returns a handle usable with event_timer_wheel_reset() and event_timer_wheel_cancel() */
+static PHP_FUNCTION(event_timer_wheel_add)
+{
+	zval *zwheel, *zarg = NULL;
+	php_timer_wheel_t *wheel;
+	php_timer_wheel_node_t *node;
+	long timeout;
+	int idx;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl|z", &zwheel, &timeout, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_TIMER_WHEEL(zwheel, wheel);
+
+	if (timeout < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "timeout cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	if (wheel->free_head != TIMER_WHEEL_NONE) {
+		idx = wheel->free_head;
+		wheel->free_head = wheel->nodes[idx].next;
+	} else {
+		if (wheel->nodes_len == TIMER_WHEEL_MAX_NODES) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "Too many timers, at most %d can be pending", TIMER_WHEEL_MAX_NODES);
+			RETURN_FALSE;
+		}
+		if (wheel->nodes_len == wheel->nodes_size) {
+			wheel->nodes_size = wheel->nodes_size ? wheel->nodes_size * 2 : 64;
+			if (wheel->nodes_size > TIMER_WHEEL_MAX_NODES) {
+				wheel->nodes_size = TIMER_WHEEL_MAX_NODES;
+			}
+			wheel->nodes = safe_erealloc(wheel->nodes, wheel->nodes_size, sizeof(php_timer_wheel_node_t), 0);
+		}
+		idx = wheel->nodes_len++;
+		wheel->nodes[idx].gen = 1;
+	}
+
+	node = &wheel->nodes[idx];
+	if (zarg) {
+		zval_add_ref(&zarg);
+	} else {
+		ALLOC_INIT_ZVAL(zarg);
+	}
+	node->arg = zarg;
+
+	if (!wheel->armed) {
+		_php_timer_wheel_arm(wheel);
+	}
+	_php_timer_wheel_link(wheel, idx, timeout);
+	++wheel->count;
+
+	RETURN_LONG(TIMER_WHEEL_HANDLE(idx, node->gen));
+}
+/* }}} */
+
+/* {{{ proto bool event_timer_wheel_reset(resource wheel, int handle, int timeout)
+ */
+static PHP_FUNCTION(event_timer_wheel_reset)
+{
+	zval *zwheel;
+	php_timer_wheel_t *wheel;
+	long handle, timeout;
+	int idx;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rll", &zwheel, &handle, &timeout) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_TIMER_WHEEL(zwheel, wheel);
+
+	if (timeout < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "timeout cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	if (!_php_timer_wheel_find(wheel, handle, &idx)) {
+		RETURN_FALSE;
+	}
+
+	_php_timer_wheel_unlink(wheel, idx);
+	if (!wheel->armed) {
+		_php_timer_wheel_arm(wheel);
+	}
+	_php_timer_wheel_link(wheel, idx, timeout);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_timer_wheel_cancel(resource wheel, int handle)
+ */
+static PHP_FUNCTION(event_timer_wheel_cancel)
+{
+	zval *zwheel;
+	php_timer_wheel_t *wheel;
+	php_timer_wheel_node_t *node;
+	long handle;
+	int idx;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zwheel, &handle) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_TIMER_WHEEL(zwheel, wheel);
+
+	node = _php_timer_wheel_find(wheel, handle, &idx);
+	if (!node) {
+		RETURN_FALSE;
+	}
+
+	_php_timer_wheel_unlink(wheel, idx);
+	zval_ptr_dtor(&node->arg);
+	_php_timer_wheel_release(wheel, idx);
+	RETURN_TRUE;
+}
+/* }}} */
+
+
+static int _php_bufferevent_setup(php_bufferevent_t *bevent, zval *zfd, zval *zreadcb, zval *zwritecb, zval *zerrorcb, zval *zarg TSRMLS_DC) /* {{{ */
+{
+	zend_fcall_info readfci = empty_fcall_info, writefci = empty_fcall_info, errorfci;
+	zend_fcall_info_cache readfcc = empty_fcall_info_cache, writefcc = empty_fcall_info_cache, errorfcc;
+	php_socket_t fd;
+	char *func_name;
+
+	if (_php_event_zval_to_fd(zfd, &fd, NULL TSRMLS_CC) != SUCCESS) {
+		return FAILURE;
+	}
+
+	if (Z_TYPE_P(zreadcb) != IS_NULL) {
+		if (_php_event_fcall_init(zreadcb, &readfci, &readfcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid read callback", func_name);
+			efree(func_name);
+			return FAILURE;
+		}
+		efree(func_name);
+	} else {
+		zreadcb = NULL;
+	}
+
+	if (Z_TYPE_P(zwritecb) != IS_NULL) {
+		if (_php_event_fcall_init(zwritecb, &writefci, &writefcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid write callback", func_name);
+			efree(func_name);
+			return FAILURE;
+		}
+		efree(func_name);
+	} else {
+		zwritecb = NULL;
+	}
+
+	if (_php_event_fcall_init(zerrorcb, &errorfci, &errorfcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid error callback", func_name);
+		efree(func_name);
+		return FAILURE;
+	}
+	efree(func_name);
+
+	_php_bufferevent_init(bevent, fd TSRMLS_CC);
+
+	if (zreadcb) {
+		zval_add_ref(&zreadcb);
+	}
+	bevent->readcb = zreadcb;
+	
+	if (zwritecb) {
+		zval_add_ref(&zwritecb);
+	}
+	bevent->writecb = zwritecb;
+		
+	zval_add_ref(&zerrorcb);
+	bevent->errorcb = zerrorcb;
+
+	bevent->readfci = readfci;
+	bevent->readfcc = readfcc;
+	bevent->writefci = writefci;
+	bevent->writefcc = writefcc;
+	bevent->errorfci = errorfci;
+	bevent->errorfcc = errorfcc;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		bevent->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(bevent->arg);
+	}
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ proto resource event_buffer_new(mixed fd, mixed readcb, mixed writecb, mixed errorcb[, mixed arg]) 
+ */
+static PHP_FUNCTION(event_buffer_new)
+{
+	php_bufferevent_t *bevent;
+	zval *zfd, *zreadcb, *zwritecb, *zerrorcb, *zarg = NULL;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzzz|z", &zfd, &zreadcb, &zwritecb, &zerrorcb, &zarg) != SUCCESS) {
+		return;
+	}
+
+	bevent = emalloc(sizeof(php_bufferevent_t));
+	if (_php_bufferevent_setup(bevent, zfd, zreadcb, zwritecb, zerrorcb, zarg TSRMLS_CC) != SUCCESS) {
+		efree(bevent);
+		RETURN_FALSE;
+	}
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	bevent->rsrc_id = zend_list_insert(bevent, le_bufferevent TSRMLS_CC);
+#else
+	bevent->rsrc_id = zend_list_insert(bevent, le_bufferevent);
+#endif
+	RETURN_RESOURCE(bevent->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_buffer_free(resource bevent) 
+ */
+static PHP_FUNCTION(event_buffer_free)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zbevent) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+	zend_list_delete(bevent->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto bool event_buffer_base_set(resource bevent, resource base)
+   proto bool BufferEvent::setBase(EventBase base)
+ */
+static PHP_FUNCTION(event_buffer_base_set)
+{
+	zval *zbase, *zbevent;
+	php_event_base_t *base, *old_base;
+	php_bufferevent_t *bevent;
+	int ret;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z", &zbase) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz", &zbevent, &zbase) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	old_base = bevent->base;
+	ret = bufferevent_base_set(base->base, bevent->bevent);
+
+	if (ret == 0) {
+		if (base != old_base) {
+			/* make sure the base is destroyed after the event */
+			_php_event_base_pin(base TSRMLS_CC);
+		}
+
+		if (old_base) {
+			_php_event_base_unpin(old_base TSRMLS_CC);
+		}
+
+		bevent->base = base;
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_buffer_priority_set(resource bevent, int priority)
+   proto bool BufferEvent::setPriority(int priority)
+ */
+static PHP_FUNCTION(event_buffer_priority_set)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	long priority;
+	int ret;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &priority) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zl", &zbevent, &priority) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	if (!bevent->base) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "Unable to set event priority without an event base");
+		RETURN_FALSE;
+	}
+
+	ret = bufferevent_priority_set(bevent->bevent, priority);
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+static int _php_bufferevent_write(php_bufferevent_t *bevent, char *data, int data_len, long data_size TSRMLS_DC) /* {{{ */
+{
+	if (data_size < 0) {
+		data_size = data_len;
+	} else if (data_size > data_len) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "data_size out of range");
+		return FAILURE;
+	}
+
+	return bufferevent_write(bevent->bevent, (const void *)data, data_size) == 0 ? SUCCESS : FAILURE;
+}
+/* }}} */
+
+/* {{{ proto bool event_buffer_write(resource bevent, string data[, int data_size])
+   proto bool BufferEvent::write(string data[, int data_size])
+ */
+static PHP_FUNCTION(event_buffer_write)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	char *data;
+	int data_len;
+	long data_size = -1;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "s|l", &data, &data_len, &data_size) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zs|l", &zbevent, &data, &data_len, &data_size) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	if (_php_bufferevent_write(bevent, data, data_len, data_size TSRMLS_CC) == SUCCESS) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+#ifdef LIBEVENT_2_API
+/* {{{ proto bool event_buffer_write_array(resource bevent, array data)
+   Large strings are queued by reference and released once written, smaller ones are copied */
+static PHP_FUNCTION(event_buffer_write_array)
+{
+	zval *zbevent, *zdata, **entry;
+	php_bufferevent_t *bevent;
+	struct evbuffer *vec;
+	HashPosition pos;
+	zval tmp;
+	int ret = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "za", &zbevent, &zdata) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	/* gather into a private buffer so the output only sees one append */
+	vec = evbuffer_new();
+	if (!vec) {
+		RETURN_FALSE;
+	}
+
+	for (zend_hash_internal_pointer_reset_ex(Z_ARRVAL_P(zdata), &pos);
+		 ret == 0 && zend_hash_get_current_data_ex(Z_ARRVAL_P(zdata), (void **)&entry, &pos) == SUCCESS;
+		 zend_hash_move_forward_ex(Z_ARRVAL_P(zdata), &pos)) {
+
+		if (Z_TYPE_PP(entry) != IS_STRING) {
+			tmp = **entry;
+			zval_copy_ctor(&tmp);
+			convert_to_string(&tmp);
+			ret = evbuffer_add(vec, Z_STRVAL(tmp), Z_STRLEN(tmp));
+			zval_dtor(&tmp);
+		} else if (Z_ISREF_PP(entry) || Z_STRLEN_PP(entry) < LIBEVENT_WRITE_REF_MIN) {
+			/* references may be changed in place, so they cannot be pinned */
+			ret = evbuffer_add(vec, Z_STRVAL_PP(entry), Z_STRLEN_PP(entry));
+		} else {
+			/* the extra refcount makes any later write to the string separate it */
+			Z_ADDREF_PP(entry);
+			ret = evbuffer_add_reference(vec, Z_STRVAL_PP(entry), Z_STRLEN_PP(entry), _php_bufferevent_ref_cleanup, *entry);
+			if (ret != 0) {
+				zval_ptr_dtor(entry);
+			}
+		}
+	}
+
+	if (ret == 0) {
+		ret = evbuffer_add_buffer(bufferevent_get_output(bevent->bevent), vec);
+	}
+	evbuffer_free(vec);
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_2_API
+/* {{{ proto bool event_buffer_add_file(resource bevent, mixed fd, int offset[, int length])
+   Queues a file segment on the output buffer without copying it through PHP; libevent uses sendfile() or mmap() where available */
+static PHP_FUNCTION(event_buffer_add_file)
+{
+	zval *zbevent, *zfd;
+	php_bufferevent_t *bevent;
+	php_socket_t fd;
+	long offset, length = -1;
+	struct stat st;
+	int dup_fd;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzl|l", &zbevent, &zfd, &offset, &length) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	if (offset < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "offset cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_zval_to_fd(zfd, &fd, NULL TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (fstat(fd, &st) != 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "fstat() failed: %s", strerror(errno));
+		RETURN_FALSE;
+	}
+
+	if (length < 0) {
+		length = (long)(st.st_size - offset);
+	}
+
+	if (offset > st.st_size || length > st.st_size - offset) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "segment exceeds the end of the file");
+		RETURN_FALSE;
+	}
+
+	if (length == 0) {
+		RETURN_TRUE;
+	}
+
+	/* the evbuffer closes the descriptor it is given once the segment is drained */
+	dup_fd = dup(fd);
+	if (dup_fd < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "dup() failed: %s", strerror(errno));
+		RETURN_FALSE;
+	}
+
+	if (evbuffer_add_file(bufferevent_get_output(bevent->bevent), dup_fd, (ev_off_t)offset, (ev_off_t)length) != 0) {
+		close(dup_fd);
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+static void _php_bufferevent_read(php_bufferevent_t *bevent, long data_size, zval *return_value TSRMLS_DC) /* {{{ */
+{
+	char *data;
+	int ret;
+
+	if (data_size == 0) {
+		RETURN_EMPTY_STRING();
+	} else if (data_size < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "data_size cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	data = safe_emalloc((int)data_size, sizeof(char), 1);
+
+	ret = bufferevent_read(bevent->bevent, data, data_size);
+	if (ret > 0) {
+		if (ret > data_size) { /* paranoia */
+			ret = data_size;
+		}
+		data[ret] = '\0';
+		RETURN_STRINGL(data, ret, 0);
+	}
+	efree(data);
+	RETURN_EMPTY_STRING();
+}
+/* }}} */
+
+/* {{{ proto string event_buffer_read(resource bevent, int data_size)
+   proto string BufferEvent::read(int data_size)
+ */
+static PHP_FUNCTION(event_buffer_read)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	long data_size;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &data_size) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zl", &zbevent, &data_size) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+	_php_bufferevent_read(bevent, data_size, return_value TSRMLS_CC);
+}
+/* }}} */
+
+/* {{{ proto bool event_buffer_enable(resource bevent, int events)
+   proto bool BufferEvent::enable(int events)
+ */
+static PHP_FUNCTION(event_buffer_enable)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	long events;
+	int ret;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &events) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zl", &zbevent, &events) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	ret = bufferevent_enable(bevent->bevent, events);
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_buffer_disable(resource bevent, int events)
+   proto bool BufferEvent::disable(int events)
+ */
+static PHP_FUNCTION(event_buffer_disable)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	long events;
+	int ret;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "l", &events) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zl", &zbevent, &events) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	ret = bufferevent_disable(bevent->bevent, events);
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto void event_buffer_timeout_set(resource bevent, int read_timeout, int write_timeout)
+   proto void BufferEvent::setTimeout(int read_timeout, int write_timeout)
+ */
+static PHP_FUNCTION(event_buffer_timeout_set)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	long read_timeout, write_timeout;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "ll", &read_timeout, &write_timeout) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zll", &zbevent, &read_timeout, &write_timeout) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+	bufferevent_settimeout(bevent->bevent, read_timeout, write_timeout);
+}
+/* }}} */
+
+/* {{{ proto void event_buffer_watermark_set(resource bevent, int events, int lowmark, int highmark)
+   proto void BufferEvent::setWatermark(int events, int lowmark, int highmark)
+ */
+static PHP_FUNCTION(event_buffer_watermark_set)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	long events, lowmark, highmark;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "lll", &events, &lowmark, &highmark) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zlll", &zbevent, &events, &lowmark, &highmark) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+#ifdef LIBEVENT_2_API
+	if (events & EV_WRITE) {
+		bevent->write_low = (size_t)lowmark;
+		bevent->write_high = (size_t)highmark;
+		/* a pipe relies on its own write watermark, these apply once it is freed */
+		if (bevent->pipe_end) {
+			events &= ~EV_WRITE;
+		}
+	}
+#endif
+	bufferevent_setwatermark(bevent->bevent, events, lowmark, highmark);
+}
+/* }}} */
+
+/* {{{ proto void event_buffer_fd_set(resource bevent, resource fd) 
+ */
+static PHP_FUNCTION(event_buffer_fd_set)
+{
+	zval *zbevent, *zfd;
+	php_bufferevent_t *bevent;
+	php_socket_t fd;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz", &zbevent, &zfd) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	if (_php_event_zval_to_fd(zfd, &fd, NULL TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	bufferevent_setfd(bevent->bevent, fd);
+
+	/* the accepted socket is ours to close once nothing refers to it */
+	if (bevent->owned_fd >= 0 && bevent->owned_fd != fd) {
+		closesocket(bevent->owned_fd);
+		bevent->owned_fd = -1;
+	}
+}
+/* }}} */
+
+/* {{{ proto resource event_buffer_set_callback(resource bevent, mixed readcb, mixed writecb, mixed errorcb[, mixed arg])
+   proto resource BufferEvent::setCallback(mixed readcb, mixed writecb, mixed errorcb[, mixed arg])
+ */
+static PHP_FUNCTION(event_buffer_set_callback)
+{
+	php_bufferevent_t *bevent;
+	zval *zbevent, *zreadcb, *zwritecb, *zerrorcb, *zarg = NULL;
+	zend_fcall_info readfci = empty_fcall_info, writefci = empty_fcall_info, errorfci;
+	zend_fcall_info_cache readfcc = empty_fcall_info_cache, writefcc = empty_fcall_info_cache, errorfcc;
+	char *func_name;
+
+	if ((zbevent = getThis()) != NULL) {
+		if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzz|z", &zreadcb, &zwritecb, &zerrorcb, &zarg) != SUCCESS) {
+			return;
+		}
+	} else if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzzz|z", &zbevent, &zreadcb, &zwritecb, &zerrorcb, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	if (Z_TYPE_P(zreadcb) != IS_NULL) {
+		if (_php_event_fcall_init(zreadcb, &readfci, &readfcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid read callback", func_name);
+			efree(func_name);
+			RETURN_FALSE;
+		}
+		efree(func_name);
+	} else {
+		zreadcb = NULL;
+	}
+
+	if (Z_TYPE_P(zwritecb) != IS_NULL) {
+		if (_php_event_fcall_init(zwritecb, &writefci, &writefcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid write callback", func_name);
+			efree(func_name);
+			RETURN_FALSE;
+		}
+		efree(func_name);
+	} else {
+		zwritecb = NULL;
+	}
+
+	if (Z_TYPE_P(zerrorcb) != IS_NULL) {
+		if (_php_event_fcall_init(zerrorcb, &errorfci, &errorfcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid error callback", func_name);
+			efree(func_name);
+			RETURN_FALSE;
+		}
+		efree(func_name);
+	} else {
+		zerrorcb = NULL;
+	}
+
+	if (zreadcb) {
+		zval_add_ref(&zreadcb);
+		
+		if (bevent->readcb) {
+			zval_ptr_dtor(&bevent->readcb);
+		}
+		bevent->readcb = zreadcb;
+	} else {
+		if (bevent->readcb) {
+			zval_ptr_dtor(&bevent->readcb);
+		}
+		bevent->readcb = NULL;
+	}
+
+	if (zwritecb) {
+		zval_add_ref(&zwritecb);
+		
+		if (bevent->writecb) {
+			zval_ptr_dtor(&bevent->writecb);
+		}
+		bevent->writecb = zwritecb;
+	} else {
+		if (bevent->writecb) {
+			zval_ptr_dtor(&bevent->writecb);
+		}
+		bevent->writecb = NULL;
+	}
+	
+	bevent->readfci = readfci;
+	bevent->readfcc = readfcc;
+	bevent->writefci = writefci;
+	bevent->writefcc = writefcc;
+
+	if (zerrorcb) {
+		zval_add_ref(&zerrorcb);
+		
+		if (bevent->errorcb) {
+			zval_ptr_dtor(&bevent->errorcb);
+		}
+		bevent->errorcb = zerrorcb;
+		bevent->errorfci = errorfci;
+		bevent->errorfcc = errorfcc;
+	}
+	
+	if (zarg) {
+		zval_add_ref(&zarg);
+		if (bevent->arg) {
+			zval_ptr_dtor(&bevent->arg);
+		}
+		bevent->arg = zarg;
+	}
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+#ifdef LIBEVENT_2_API
+/* {{{ proto bool event_buffer_set_rate_limit(resource bevent, int read_rate, int read_burst, int write_rate, int write_burst[, int tick])
+   Limits the bevent to rates in bytes per second, refilled every tick milliseconds. A zero rate is unlimited, all zero rates remove the limit */
+static PHP_FUNCTION(event_buffer_set_rate_limit)
+{
+	zval *zbevent;
+	php_bufferevent_t *bevent;
+	struct ev_token_bucket_cfg *cfg = NULL;
+	long read_rate, read_burst, write_rate, write_burst, tick = LIBEVENT_RATE_LIMIT_TICK;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zllll|l", &zbevent, &read_rate, &read_burst, &write_rate, &write_burst, &tick) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+
+	if (!bevent->base) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "buffer event must be attached to a base with event_buffer_base_set() first");
+		RETURN_FALSE;
+	}
+
+	if (read_rate != 0 || write_rate != 0) {
+		cfg = _php_event_rate_cfg_new(read_rate, read_burst, write_rate, write_burst, tick TSRMLS_CC);
+		if (!cfg) {
+			RETURN_FALSE;
+		}
+	}
+
+	if (bufferevent_set_rate_limit(bevent->bevent, cfg) != 0) {
+		if (cfg) {
+			ev_token_bucket_cfg_free(cfg);
+		}
+		RETURN_FALSE;
+	}
+
+	/* libevent does not copy the configuration, the old one is only unused now */
+	if (bevent->rate_cfg) {
+		ev_token_bucket_cfg_free(bevent->rate_cfg);
+	}
+	bevent->rate_cfg = cfg;
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_buffer_set_rate_limit_group(resource bevent, resource group)
+   Makes the bevent share the limits of group, NULL takes it out of its group */
+static PHP_FUNCTION(event_buffer_set_rate_limit_group)
+{
+	zval *zbevent, *zgroup;
+	php_bufferevent_t *bevent;
+	php_event_rate_group_t *group = NULL;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zr!", &zbevent, &zgroup) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent, bevent);
+	if (zgroup) {
+		ZVAL_TO_RATE_GROUP(zgroup, group);
+	}
+
+	if (bevent->rate_group == group) {
+		RETURN_TRUE;
+	}
+
+	_php_bufferevent_group_leave(bevent TSRMLS_CC);
+
+	if (!group) {
+		RETURN_TRUE;
+	}
+
+	if (!bevent->base) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "buffer event must be attached to a base with event_buffer_base_set() first");
+		RETURN_FALSE;
+	}
+
+	if (bufferevent_add_to_rate_limit_group(bevent->bevent, group->group) != 0) {
+		RETURN_FALSE;
+	}
+
+	/* make sure the group is destroyed after its members */
+	bevent->rate_group = group;
+	bevent->group_next = group->members;
+	if (group->members) {
+		group->members->group_prev = bevent;
+	}
+	group->members = bevent;
+	++group->nmembers;
+	zend_list_addref(group->rsrc_id);
+
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto resource event_rate_limit_group_new(resource base, int read_rate, int read_burst, int write_rate, int write_burst[, int tick])
+   Creates a group of bevents sharing rates in bytes per second, see event_buffer_set_rate_limit() */
+static PHP_FUNCTION(event_rate_limit_group_new)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	php_event_rate_group_t *group;
+	struct bufferevent_rate_limit_group *evgroup;
+	struct ev_token_bucket_cfg *cfg;
+	long read_rate, read_burst, write_rate, write_burst, tick = LIBEVENT_RATE_LIMIT_TICK;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zllll|l", &zbase, &read_rate, &read_burst, &write_rate, &write_burst, &tick) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	cfg = _php_event_rate_cfg_new(read_rate, read_burst, write_rate, write_burst, tick TSRMLS_CC);
+	if (!cfg) {
+		RETURN_FALSE;
+	}
+
+	/* the group keeps a copy of the configuration */
+	evgroup = bufferevent_rate_limit_group_new(base->base, cfg);
+	ev_token_bucket_cfg_free(cfg);
+	if (!evgroup) {
+		RETURN_FALSE;
+	}
+
+	group = emalloc(sizeof(php_event_rate_group_t));
+	group->group = evgroup;
+	group->members = NULL;
+	group->nmembers = 0;
+
+	/* make sure the base is destroyed after the group */
+	group->base = base;
+	_php_event_base_pin(base TSRMLS_CC);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	group->rsrc_id = zend_list_insert(group, le_event_rate_group TSRMLS_CC);
+#else
+	group->rsrc_id = zend_list_insert(group, le_event_rate_group);
+#endif
+	RETURN_RESOURCE(group->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto bool event_rate_limit_group_set(resource group, int read_rate, int read_burst, int write_rate, int write_burst[, int tick])
+ */
+static PHP_FUNCTION(event_rate_limit_group_set)
+{
+	zval *zgroup;
+	php_event_rate_group_t *group;
+	struct ev_token_bucket_cfg *cfg;
+	long read_rate, read_burst, write_rate, write_burst, tick = LIBEVENT_RATE_LIMIT_TICK;
+	int ret;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rllll|l", &zgroup, &read_rate, &read_burst, &write_rate, &write_burst, &tick) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_RATE_GROUP(zgroup, group);
+
+	cfg = _php_event_rate_cfg_new(read_rate, read_burst, write_rate, write_burst, tick TSRMLS_CC);
+	if (!cfg) {
+		RETURN_FALSE;
+	}
+
+	ret = bufferevent_rate_limit_group_set_cfg(group->group, cfg);
+	ev_token_bucket_cfg_free(cfg);
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_rate_limit_group_set_min_share(resource group, int share)
+   Sets the fewest bytes a member may read or write at a time when the group is nearly exhausted */
+static PHP_FUNCTION(event_rate_limit_group_set_min_share)
+{
+	zval *zgroup;
+	php_event_rate_group_t *group;
+	long share;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zgroup, &share) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_RATE_GROUP(zgroup, group);
+
+	if (share < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "share cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	if (bufferevent_rate_limit_group_set_min_share(group->group, (size_t)share) == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto void event_rate_limit_group_free(resource group)
+   Members keep the group alive until they leave it or are freed */
+static PHP_FUNCTION(event_rate_limit_group_free)
+{
+	zval *zgroup;
+	php_event_rate_group_t *group;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zgroup) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_RATE_GROUP(zgroup, group);
+	zend_list_delete(group->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto array event_rate_limit_group_stats(resource group[, bool reset])
+   Returns the number of members and the bytes read and written by the group */
+static PHP_FUNCTION(event_rate_limit_group_stats)
+{
+	zval *zgroup;
+	php_event_rate_group_t *group;
+	ev_uint64_t total_read, total_written;
+	zend_bool reset = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|b", &zgroup, &reset) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_RATE_GROUP(zgroup, group);
+
+	bufferevent_rate_limit_group_get_totals(group->group, &total_read, &total_written);
+
+	array_init(return_value);
+	add_assoc_long(return_value, "members", group->nmembers);
+	add_assoc_long(return_value, "read", (long)total_read);
+	add_assoc_long(return_value, "written", (long)total_written);
+	add_assoc_long(return_value, "read_limit", (long)bufferevent_rate_limit_group_get_read_limit(group->group));
+	add_assoc_long(return_value, "write_limit", (long)bufferevent_rate_limit_group_get_write_limit(group->group));
+
+	if (reset) {
+		bufferevent_rate_limit_group_reset_totals(group->group);
+	}
+}
+/* }}} */
+
+/* {{{ proto resource event_buffer_pipe(resource bevent_a, resource bevent_b, mixed callback[, mixed arg[, int high[, int low]]])
+   Relays data both ways between two bevents without calling PHP. Reading from one side pauses while the other side has
+   high or more bytes queued for writing and resumes when it drains to low. callback(pipe, bevent, what, arg) is called on EOF or error.
+   The write watermarks of the bevents are taken over by the pipe and given back when it is freed */
+static PHP_FUNCTION(event_buffer_pipe)
+{
+	zval *zbevent_a, *zbevent_b, *zcallback, *zarg = NULL;
+	php_bufferevent_t *bevents[2];
+	php_event_pipe_t *pipe;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	long high = LIBEVENT_PIPE_HIGH, low = LIBEVENT_PIPE_LOW;
+	char *func_name;
+	int i;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzz|zll", &zbevent_a, &zbevent_b, &zcallback, &zarg, &high, &low) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BEVENT(zbevent_a, bevents[0]);
+	ZVAL_TO_BEVENT(zbevent_b, bevents[1]);
+
+	if (bevents[0] == bevents[1]) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "cannot pipe a buffer event to itself");
+		RETURN_FALSE;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (!bevents[i]->base) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "buffer event must be attached to a base first");
+			RETURN_FALSE;
+		}
+		if (bevents[i]->pipe_end) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "buffer event is already piped");
+			RETURN_FALSE;
+		}
+	}
+
+	if (high <= 0 || low < 0 || low >= high) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "watermarks must satisfy 0 <= low < high");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	pipe = emalloc(sizeof(php_event_pipe_t));
+	pipe->high = (size_t)high;
+	pipe->low = (size_t)low;
+	pipe->pauses = 0;
+
+	zval_add_ref(&zcallback);
+	pipe->callback = zcallback;
+	pipe->fci = fci;
+	pipe->fcc = fcc;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		pipe->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(pipe->arg);
+	}
+
+	TSRMLS_SET_CTX(pipe->thread_ctx);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	pipe->rsrc_id = zend_list_insert(pipe, le_event_pipe TSRMLS_CC);
+#else
+	pipe->rsrc_id = zend_list_insert(pipe, le_event_pipe);
+#endif
+
+	for (i = 0; i < 2; i++) {
+		php_event_pipe_end_t *end = &pipe->ends[i];
+
+		end->pipe = pipe;
+		end->peer = &pipe->ends[1 - i];
+		end->bevent = bevents[i];
+		end->paused = 0;
+		end->moved = 0;
+
+		/* make sure the bevents are destroyed after the pipe */
+		PHP_EVENT_OWNER_ADDREF(bevents[i]);
+		bevents[i]->pipe_end = end;
+
+		/* the write callback reports the output drained down to low */
+		bufferevent_setwatermark(bevents[i]->bevent, EV_WRITE, pipe->low, 0);
+		bufferevent_setcb(bevents[i]->bevent, _php_event_pipe_readcb, _php_event_pipe_writecb, _php_event_pipe_errorcb, end);
+	}
+
+	for (i = 0; i < 2; i++) {
+		/* move what was read before the pipe was set up */
+		_php_event_pipe_readcb(bevents[i]->bevent, &pipe->ends[i]);
+		if (!pipe->ends[i].paused) {
+			bufferevent_enable(bevents[i]->bevent, EV_READ | EV_WRITE);
+		} else {
+			bufferevent_enable(bevents[i]->bevent, EV_WRITE);
+		}
+	}
+
+	RETURN_RESOURCE(pipe->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_buffer_pipe_free(resource pipe)
+   Gives both bevents back their own callbacks, data already moved stays queued for writing */
+static PHP_FUNCTION(event_buffer_pipe_free)
+{
+	zval *zpipe;
+	php_event_pipe_t *pipe;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zpipe) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_PIPE(zpipe, pipe);
+	zend_list_delete(pipe->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto array event_buffer_pipe_stats(resource pipe)
+   Returns the bytes moved each way and how many times reading was paused */
+static PHP_FUNCTION(event_buffer_pipe_stats)
+{
+	zval *zpipe;
+	php_event_pipe_t *pipe;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zpipe) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_PIPE(zpipe, pipe);
+
+	array_init(return_value);
+	add_assoc_long(return_value, "a_to_b", (long)pipe->ends[0].moved);
+	add_assoc_long(return_value, "b_to_a", (long)pipe->ends[1].moved);
+	add_assoc_long(return_value, "pauses", pipe->pauses);
+	add_assoc_bool(return_value, "a_paused", pipe->ends[0].paused);
+	add_assoc_bool(return_value, "b_paused", pipe->ends[1].paused);
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_SPLICE_SUPPORT
+/* {{{ proto resource event_relay_new(resource base, mixed fd_a, mixed fd_b, mixed callback[, mixed arg[, int chunk]])
+   Relays bytes both ways between two fds with splice(), so the data never reaches user memory. Each EOF is passed on as a
+   half close, callback(relay, what, stats, arg) is called once both sides are done or on the first error */
+static PHP_FUNCTION(event_relay_new)
+{
+	zval *zbase, *zfds[2], *zcallback, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_relay_t *relay;
+	php_stream *streams[2];
+	php_socket_t fds[2];
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	long chunk = LIBEVENT_SPLICE_CHUNK;
+	char *func_name;
+	int i;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzzz|zl", &zbase, &zfds[0], &zfds[1], &zcallback, &zarg, &chunk) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	for (i = 0; i < 2; i++) {
+		if (_php_event_zval_to_fd(zfds[i], &fds[i], &streams[i] TSRMLS_CC) != SUCCESS) {
+			RETURN_FALSE;
+		}
+	}
+
+	if (fds[0] == fds[1]) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "cannot relay a file descriptor to itself");
+		RETURN_FALSE;
+	}
+
+	if (chunk <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "chunk must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	relay = emalloc(sizeof(php_event_relay_t));
+	relay->chunk = (size_t)chunk;
+	relay->closed = 0;
+	relay->error = 0;
+
+	for (i = 0; i < 2; i++) {
+		php_event_relay_dir_t *dir = &relay->dirs[i];
+
+		if (pipe(dir->pipe) != 0) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to create a pipe: %s", strerror(errno));
+			if (i == 1) {
+				close(relay->dirs[0].pipe[0]);
+				close(relay->dirs[0].pipe[1]);
+			}
+			efree(relay);
+			RETURN_FALSE;
+		}
+		fcntl(dir->pipe[0], F_SETFD, FD_CLOEXEC);
+		fcntl(dir->pipe[1], F_SETFD, FD_CLOEXEC);
+#ifdef F_SETPIPE_SZ
+		/* a chunk has to fit into the pipe, which holds 64k unless told otherwise */
+		if (relay->chunk > LIBEVENT_SPLICE_CHUNK) {
+			fcntl(dir->pipe[1], F_SETPIPE_SZ, (int)relay->chunk);
+		}
+#endif
+		dir->relay = relay;
+		dir->idx = i;
+		dir->pending = 0;
+		dir->bytes = 0;
+		dir->done = 0;
+	}
+
+	for (i = 0; i < 2; i++) {
+		php_event_relay_dir_t *dir = &relay->dirs[i];
+
+		if (streams[i]) {
+			php_stream_set_option(streams[i], PHP_STREAM_OPTION_BLOCKING, 0, NULL);
+
+			/* what the stream layer already buffered goes out first */
+			if (streams[i]->writepos > streams[i]->readpos) {
+				size_t buffered = (size_t)(streams[i]->writepos - streams[i]->readpos);
+				char *data = emalloc(buffered);
+				ssize_t n;
+
+				buffered = php_stream_read(streams[i], data, buffered);
+				n = write(dir->pipe[1], data, buffered);
+				efree(data);
+				if (n > 0) {
+					dir->pending = (size_t)n;
+				}
+			}
+
+			/* keep the streams open for as long as we relay */
+			zend_list_addref(Z_LVAL_P(zfds[i]));
+			relay->stream_ids[i] = Z_LVAL_P(zfds[i]);
+		} else {
+			fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+			relay->stream_ids[i] = -1;
+		}
+
+		relay->fds[i] = fds[i];
+	}
+
+	for (i = 0; i < 2; i++) {
+		php_event_relay_dir_t *dir = &relay->dirs[i];
+
+		event_set(&dir->read_event, (int)relay->fds[i], EV_READ, _php_event_relay_callback, dir);
+		event_base_set(base->base, &dir->read_event);
+		event_set(&dir->write_event, (int)relay->fds[1 - i], EV_WRITE, _php_event_relay_callback, dir);
+		event_base_set(base->base, &dir->write_event);
+	}
+
+	zval_add_ref(&zcallback);
+	relay->callback = zcallback;
+	relay->fci = fci;
+	relay->fcc = fcc;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		relay->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(relay->arg);
+	}
+
+	/* make sure the base is destroyed after the relay */
+	relay->base = base;
+	_php_event_base_pin(base TSRMLS_CC);
+
+	TSRMLS_SET_CTX(relay->thread_ctx);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	relay->rsrc_id = zend_list_insert(relay, le_event_relay TSRMLS_CC);
+#else
+	relay->rsrc_id = zend_list_insert(relay, le_event_relay);
+#endif
+
+	/* start from the loop, so the callback never runs before we return */
+	for (i = 0; i < 2; i++) {
+		event_active(&relay->dirs[i].read_event, EV_READ, 1);
+	}
+
+	RETURN_RESOURCE(relay->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_relay_free(resource relay)
+   Stops relaying, the fds are left open */
+static PHP_FUNCTION(event_relay_free)
+{
+	zval *zrelay;
+	php_event_relay_t *relay;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zrelay) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_RELAY(zrelay, relay);
+	zend_list_delete(relay->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto array event_relay_stats(resource relay)
+   Returns the bytes relayed each way, the bytes still in flight and the errno that closed the relay */
+static PHP_FUNCTION(event_relay_stats)
+{
+	zval *zrelay;
+	php_event_relay_t *relay;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zrelay) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_RELAY(zrelay, relay);
+	_php_event_relay_stats(relay, return_value);
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+/* {{{ proto resource event_signal_watch(resource base, array signals, mixed callback[, mixed arg])
+   Blocks the signals and reads them from a signalfd. callback(watcher, array(array(signo, code, pid, uid, status), ...), arg)
+   is called once per wakeup with everything received. EV_SIGNAL events for these signals no longer fire while watched.
+   The kernel merges pending signals of one kind, a single SIGCHLD record may stand for several children, so reap
+   them with pcntl_waitpid(-1, $status, WNOHANG) until it returns 0 or less. Programs started by exec(), proc_open()
+   and the like inherit the signals blocked while they are watched. Workers of event_supervisor_run() start with
+   them unblocked, watchers must be created in the worker */
+static PHP_FUNCTION(event_signal_watch)
+{
+	zval *zbase, *zsignals, *zcallback, *zarg = NULL, **entry;
+	php_event_base_t *base;
+	php_event_signal_watcher_t *watcher;
+	HashPosition pos;
+	sigset_t mask, oldmask;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+	int fd, signo;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zaz|z", &zbase, &zsignals, &zcallback, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	sigemptyset(&mask);
+	for (zend_hash_internal_pointer_reset_ex(Z_ARRVAL_P(zsignals), &pos);
+		 zend_hash_get_current_data_ex(Z_ARRVAL_P(zsignals), (void **)&entry, &pos) == SUCCESS;
+		 zend_hash_move_forward_ex(Z_ARRVAL_P(zsignals), &pos)) {
+		zval tmp = **entry;
+
+		zval_copy_ctor(&tmp);
+		convert_to_long(&tmp);
+		signo = (int)Z_LVAL(tmp);
+
+		if (signo <= 0 || signo >= NSIG || signo == SIGKILL || signo == SIGSTOP) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "invalid signal passed");
+			RETURN_FALSE;
+		}
+		sigaddset(&mask, signo);
+	}
+
+	if (zend_hash_num_elements(Z_ARRVAL_P(zsignals)) == 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "no signals passed");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to create a signalfd: %s", strerror(errno));
+		RETURN_FALSE;
+	}
+
+	/* a blocked signal stays pending until read from the signalfd, the mask is per thread */
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	for (signo = 1; signo < NSIG; signo++) {
+		if (sigismember(&mask, signo) == 1 && php_event_signalfd_refs[signo]++ == 0
+				&& sigismember(&oldmask, signo) != 1) {
+			sigaddset(&php_event_signalfd_blocked, signo);
+		}
+	}
+
+	watcher = emalloc(sizeof(php_event_signal_watcher_t));
+	watcher->fd = fd;
+	watcher->mask = mask;
+	watcher->wakeups = 0;
+	watcher->received = 0;
+
+	zval_add_ref(&zcallback);
+	watcher->callback = zcallback;
+	watcher->fci = fci;
+	watcher->fcc = fcc;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		watcher->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(watcher->arg);
+	}
+
+	event_set(&watcher->event, fd, EV_READ | EV_PERSIST, _php_event_signal_watcher_callback, watcher);
+	event_base_set(base->base, &watcher->event);
+	event_add(&watcher->event, NULL);
+
+	/* make sure the base is destroyed after the watcher */
+	watcher->base = base;
+	_php_event_base_pin(base TSRMLS_CC);
+
+	TSRMLS_SET_CTX(watcher->thread_ctx);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	watcher->rsrc_id = zend_list_insert(watcher, le_event_signal_watcher TSRMLS_CC);
+#else
+	watcher->rsrc_id = zend_list_insert(watcher, le_event_signal_watcher);
+#endif
+	RETURN_RESOURCE(watcher->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_signal_watcher_free(resource watcher)
+   Unblocks the signals unless they were blocked before or another watcher still has them */
+static PHP_FUNCTION(event_signal_watcher_free)
+{
+	zval *zwatcher;
+	php_event_signal_watcher_t *watcher;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zwatcher) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_SIGNAL_WATCHER(zwatcher, watcher);
+	zend_list_delete(watcher->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto array event_signal_watcher_stats(resource watcher)
+   Returns the number of wakeups and of signals delivered, the difference is what was batched */
+static PHP_FUNCTION(event_signal_watcher_stats)
+{
+	zval *zwatcher;
+	php_event_signal_watcher_t *watcher;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zwatcher) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_SIGNAL_WATCHER(zwatcher, watcher);
+
+	array_init(return_value);
+	add_assoc_long(return_value, "wakeups", watcher->wakeups);
+	add_assoc_long(return_value, "received", watcher->received);
+}
+/* }}} */
+#endif
+
+/* {{{ proto resource event_listener_new(resource base, mixed fd, mixed acceptcb, mixed readcb, mixed writecb, mixed errorcb[, mixed arg[, int budget[, int events]]])
+   acceptcb receives (listener, array(array(bevent, peer), ...), arg, errno) once per wakeup,
+   errno is non-zero when accept() failed and the listener has been disabled */
+static PHP_FUNCTION(event_listener_new)
+{
+	php_event_listener_t *listener;
+	php_event_base_t *base;
+	zval *zbase, *zfd, *zacceptcb, *zreadcb, *zwritecb, *zerrorcb, *zarg = NULL;
+	zend_fcall_info acceptfci, readfci = empty_fcall_info, writefci = empty_fcall_info, errorfci = empty_fcall_info;
+	zend_fcall_info_cache acceptfcc, readfcc = empty_fcall_info_cache, writefcc = empty_fcall_info_cache, errorfcc = empty_fcall_info_cache;
+	long budget = LIBEVENT_LISTENER_BUDGET, events = EV_READ;
+	php_stream *stream;
+	php_socket_t fd;
+	char *func_name;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzzzzz|zll", &zbase, &zfd, &zacceptcb, &zreadcb, &zwritecb, &zerrorcb, &zarg, &budget, &events) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (budget <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "budget must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	if (events & ~(EV_READ | EV_WRITE)) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "events must be a combination of EV_READ and EV_WRITE");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_zval_to_fd(zfd, &fd, &stream TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zacceptcb, &acceptfci, &acceptfcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid accept callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	if (Z_TYPE_P(zreadcb) != IS_NULL) {
+		if (_php_event_fcall_init(zreadcb, &readfci, &readfcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid read callback", func_name);
+			efree(func_name);
+			RETURN_FALSE;
+		}
+		efree(func_name);
+	} else {
+		zreadcb = NULL;
+	}
+
+	if (Z_TYPE_P(zwritecb) != IS_NULL) {
+		if (_php_event_fcall_init(zwritecb, &writefci, &writefcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid write callback", func_name);
+			efree(func_name);
+			RETURN_FALSE;
+		}
+		efree(func_name);
+	} else {
+		zwritecb = NULL;
+	}
+
+	if (Z_TYPE_P(zerrorcb) != IS_NULL) {
+		if (_php_event_fcall_init(zerrorcb, &errorfci, &errorfcc, &func_name TSRMLS_CC) != SUCCESS) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid error callback", func_name);
+			efree(func_name);
+			RETURN_FALSE;
+		}
+		efree(func_name);
+	} else {
+		zerrorcb = NULL;
+	}
+
+	/* accept() must never block the loop */
+	if (php_set_sock_blocking(fd, 0 TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to switch the listening socket to non-blocking mode");
+		RETURN_FALSE;
+	}
+
+	listener = emalloc(sizeof(php_event_listener_t));
+	listener->budget = budget;
+	listener->events = (short)events;
+
+	zval_add_ref(&zacceptcb);
+	listener->acceptcb = zacceptcb;
+	listener->acceptfci = acceptfci;
+	listener->acceptfcc = acceptfcc;
+
+	if (zreadcb) {
+		zval_add_ref(&zreadcb);
+	}
+	listener->readcb = zreadcb;
+	listener->readfci = readfci;
+	listener->readfcc = readfcc;
+
+	if (zwritecb) {
+		zval_add_ref(&zwritecb);
+	}
+	listener->writecb = zwritecb;
+	listener->writefci = writefci;
+	listener->writefcc = writefcc;
+
+	if (zerrorcb) {
+		zval_add_ref(&zerrorcb);
+	}
+	listener->errorcb = zerrorcb;
+	listener->errorfci = errorfci;
+	listener->errorfcc = errorfcc;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		listener->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(listener->arg);
+	}
+
+	/* keep the listening stream open for as long as we watch it */
+	if (stream) {
+		zend_list_addref(Z_LVAL_P(zfd));
+		listener->stream_id = Z_LVAL_P(zfd);
+	} else {
+		listener->stream_id = -1;
+	}
+
+	event_set(&listener->event, (int)fd, EV_READ | EV_PERSIST, _php_event_listener_callback, listener);
+	event_base_set(base->base, &listener->event);
+
+	/* make sure the base is destroyed after the listener */
+	listener->base = base;
+	_php_event_base_pin(base TSRMLS_CC);
+
+	TSRMLS_SET_CTX(listener->thread_ctx);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	listener->rsrc_id = zend_list_insert(listener, le_event_listener TSRMLS_CC);
+#else
+	listener->rsrc_id = zend_list_insert(listener, le_event_listener);
+#endif
+
+	listener->enabled = event_add(&listener->event, NULL) == 0;
+	RETURN_RESOURCE(listener->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_listener_free(resource listener)
+ */
+static PHP_FUNCTION(event_listener_free)
+{
+	zval *zlistener;
+	php_event_listener_t *listener;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zlistener) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_LISTENER(zlistener, listener);
+	zend_list_delete(listener->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto bool event_listener_enable(resource listener)
+ */
+static PHP_FUNCTION(event_listener_enable)
+{
+	zval *zlistener;
+	php_event_listener_t *listener;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zlistener) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_LISTENER(zlistener, listener);
+
+	if (!listener->enabled) {
+		if (event_add(&listener->event, NULL) != 0) {
+			RETURN_FALSE;
+		}
+		listener->enabled = 1;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_listener_disable(resource listener)
+   Stops accepting, e.g. while out of file descriptors; pending connections stay in the kernel backlog */
+static PHP_FUNCTION(event_listener_disable)
+{
+	zval *zlistener;
+	php_event_listener_t *listener;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zlistener) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_LISTENER(zlistener, listener);
+
+	if (listener->enabled) {
+		if (event_del(&listener->event) != 0) {
+			RETURN_FALSE;
+		}
+		listener->enabled = 0;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+
+
+#ifdef LIBEVENT_2_API
+/* {{{ proto resource event_dns_base_new(resource base[, string resolv_conf[, int cache_size]])
+   Creates an asynchronous resolver using the nameservers of resolv_conf, or of the system when omitted.
+   Up to cache_size answers are kept for their TTL, 0 disables the cache */
+static PHP_FUNCTION(event_dns_base_new)
+{
+	zval *zbase;
+	php_event_base_t *base;
+	php_event_dns_t *dns;
+	struct evdns_base *evdns;
+	char *path = NULL;
+	int path_len = 0, ret;
+	long cache_size = LIBEVENT_DNS_CACHE_SIZE;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "z|s!l", &zbase, &path, &path_len, &cache_size) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (cache_size < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "cache_size cannot be less than zero");
+		RETURN_FALSE;
+	}
+
+	if (path) {
+		if (strlen(path) != (size_t)path_len) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "resolv_conf must not contain null bytes");
+			RETURN_FALSE;
+		}
+
+		if (php_check_open_basedir(path TSRMLS_CC)) {
+			RETURN_FALSE;
+		}
+
+		evdns = evdns_base_new(base->base, LIBEVENT_DNS_BASE_FLAGS);
+		if (evdns && (ret = evdns_base_resolv_conf_parse(evdns, DNS_OPTIONS_ALL, path)) != 0) {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "failed to load the resolver configuration from '%s' (error %d)", path, ret);
+			evdns_base_free(evdns, 0);
+			RETURN_FALSE;
+		}
+	} else {
+		evdns = evdns_base_new(base->base, LIBEVENT_DNS_BASE_FLAGS | EVDNS_BASE_INITIALIZE_NAMESERVERS);
+	}
+
+	if (!evdns) {
+		RETURN_FALSE;
+	}
+
+	dns = ecalloc(1, sizeof(php_event_dns_t));
+	dns->evdns = evdns;
+	dns->cache_size = cache_size;
+	zend_hash_init(&dns->cache, 16, NULL, _php_event_dns_entry_dtor, 0);
+
+	event_set(&dns->ready_event, -1, 0, _php_event_dns_ready_callback, dns);
+	event_base_set(base->base, &dns->ready_event);
+
+	/* make sure the base is destroyed after the resolver */
+	dns->base = base;
+	_php_event_base_pin(base TSRMLS_CC);
+
+	TSRMLS_SET_CTX(dns->thread_ctx);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	dns->rsrc_id = zend_list_insert(dns, le_event_dns TSRMLS_CC);
+#else
+	dns->rsrc_id = zend_list_insert(dns, le_event_dns);
+#endif
+	RETURN_RESOURCE(dns->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_dns_base_free(resource dns)
+   Lookups in flight keep the resolver alive until they complete */
+static PHP_FUNCTION(event_dns_base_free)
+{
+	zval *zdns;
+	php_event_dns_t *dns;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zdns) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_DNS(zdns, dns);
+	zend_list_delete(dns->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto bool event_dns_nameserver_add(resource dns, string address)
+   address is an IPv4 or IPv6 address with an optional port, as in "127.0.0.1:5353" or "[::1]:53" */
+static PHP_FUNCTION(event_dns_nameserver_add)
+{
+	zval *zdns;
+	php_event_dns_t *dns;
+	char *address;
+	int address_len;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rs", &zdns, &address, &address_len) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_DNS(zdns, dns);
+
+	if (evdns_base_nameserver_ip_add(dns->evdns, address) == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_dns_resolve(resource dns, string name, int type, mixed callback[, mixed arg[, int flags]])
+   Looks name up without blocking, callback(array|false answers, int error, int ttl, arg) runs on the loop.
+   type is EVENT_DNS_IPv4_A, EVENT_DNS_IPv6_AAAA or EVENT_DNS_PTR, the latter taking an IPv4 or IPv6 address as name */
+static PHP_FUNCTION(event_dns_resolve)
+{
+	zval *zdns, *zcallback, *zarg = NULL;
+	php_event_dns_t *dns;
+	php_event_dns_entry_t *entry, **pentry;
+	php_event_dns_waiter_t *waiter;
+	struct evdns_request *req;
+	struct in_addr in4;
+	struct in6_addr in6;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *name, *key, *func_name;
+	int name_len, key_len, family = AF_UNSPEC;
+	long type, flags = 0;
+	int64_t now;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rslz|z!l", &zdns, &name, &name_len, &type, &zcallback, &zarg, &flags) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_DNS(zdns, dns);
+
+	if (strlen(name) != (size_t)name_len) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "name must not contain null bytes");
+		RETURN_FALSE;
+	}
+
+	if (type == DNS_PTR) {
+		if (evutil_inet_pton(AF_INET, name, &in4) == 1) {
+			family = AF_INET;
+		} else if (evutil_inet_pton(AF_INET6, name, &in6) == 1) {
+			family = AF_INET6;
+		} else {
+			php_error_docref(NULL TSRMLS_CC, E_WARNING, "EVENT_DNS_PTR lookups take an IPv4 or IPv6 address");
+			RETURN_FALSE;
+		}
+	} else if (type != DNS_IPv4_A && type != DNS_IPv6_AAAA) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "type must be EVENT_DNS_IPv4_A, EVENT_DNS_IPv6_AAAA or EVENT_DNS_PTR");
+		RETURN_FALSE;
+	}
+
+	if (_php_event_fcall_init(zcallback, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	waiter = ecalloc(1, sizeof(php_event_dns_waiter_t));
+	zval_add_ref(&zcallback);
+	waiter->callback = zcallback;
+	waiter->fci = fci;
+	waiter->fcc = fcc;
+	if (zarg) {
+		zval_add_ref(&zarg);
+		waiter->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(waiter->arg);
+	}
+
+	key_len = spprintf(&key, 0, "%ld:%ld:%s", type, flags, name);
+	zend_str_tolower(key, key_len);
+
+	if (zend_hash_find(&dns->cache, key, key_len + 1, (void **)&pentry) == SUCCESS) {
+		entry = *pentry;
+		efree(key);
+
+		if (!entry->result) {
+			/* the same query is in flight already, share its answer */
+			++dns->coalesced;
+			waiter->next = entry->waiters;
+			entry->waiters = waiter;
+			RETURN_TRUE;
+		}
+
+		now = _php_event_clock_nsec();
+		if (entry->expires > now) {
+			++dns->hits;
+			_php_event_dns_unlink(dns, entry);
+			_php_event_dns_link(dns, entry);
+
+			Z_ADDREF_P(entry->result);
+			waiter->result = entry->result;
+			waiter->ttl = (int)((entry->expires - now + 999999999) / 1000000000);
+
+			/* answer from the loop like a real lookup would */
+			if (!dns->ready) {
+				struct timeval tv = {0, 0};
+
+				event_add(&dns->ready_event, &tv);
+			}
+			waiter->next = dns->ready;
+			dns->ready = waiter;
+			RETURN_TRUE;
+		}
+
+		/* expired, the entry is looked up again in place */
+		++dns->expired;
+		_php_event_dns_unlink(dns, entry);
+		zval_ptr_dtor(&entry->result);
+		entry->result = NULL;
+	} else {
+		entry = ecalloc(1, sizeof(php_event_dns_entry_t));
+		entry->dns = dns;
+		entry->key = key;
+		entry->key_len = key_len;
+		zend_hash_add(&dns->cache, key, key_len + 1, &entry, sizeof(php_event_dns_entry_t *), NULL);
+	}
+	++dns->misses;
+
+	if (type == DNS_IPv4_A) {
+		req = evdns_base_resolve_ipv4(dns->evdns, name, (int)flags, _php_event_dns_callback, entry);
+	} else if (type == DNS_IPv6_AAAA) {
+		req = evdns_base_resolve_ipv6(dns->evdns, name, (int)flags, _php_event_dns_callback, entry);
+	} else if (family == AF_INET) {
+		req = evdns_base_resolve_reverse(dns->evdns, &in4, (int)flags, _php_event_dns_callback, entry);
+	} else {
+		req = evdns_base_resolve_reverse_ipv6(dns->evdns, &in6, (int)flags, _php_event_dns_callback, entry);
+	}
+
+	if (!req) {
+		_php_event_dns_waiter_free(waiter);
+		zend_hash_del(&dns->cache, entry->key, entry->key_len + 1);
+		RETURN_FALSE;
+	}
+
+	entry->waiters = waiter;
+	++dns->inflight;
+
+	/* make sure the resolver is destroyed after the lookup */
+	zend_list_addref(dns->rsrc_id);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto array event_dns_cache_stats(resource dns[, bool reset])
+   Returns the cache counters of the resolver */
+static PHP_FUNCTION(event_dns_cache_stats)
+{
+	zval *zdns;
+	php_event_dns_t *dns;
+	zend_bool reset = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r|b", &zdns, &reset) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_DNS(zdns, dns);
+
+	array_init(return_value);
+	add_assoc_long(return_value, "size", dns->cache_size);
+	add_assoc_long(return_value, "entries", dns->cached);
+	add_assoc_long(return_value, "inflight", dns->inflight);
+	add_assoc_long(return_value, "hits", dns->hits);
+	add_assoc_long(return_value, "misses", dns->misses);
+	add_assoc_long(return_value, "coalesced", dns->coalesced);
+	add_assoc_long(return_value, "expired", dns->expired);
+	add_assoc_long(return_value, "evictions", dns->evictions);
+
+	if (reset) {
+		dns->hits = 0;
+		dns->misses = 0;
+		dns->coalesced = 0;
+		dns->expired = 0;
+		dns->evictions = 0;
+	}
+}
+/* }}} */
+
+/* {{{ proto void event_dns_cache_clear(resource dns)
+   Forgets all cached answers, lookups in flight are not affected */
+static PHP_FUNCTION(event_dns_cache_clear)
+{
+	zval *zdns;
+	php_event_dns_t *dns;
+	long evictions;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zdns) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_DNS(zdns, dns);
+
+	evictions = dns->evictions;
+	_php_event_dns_evict(dns, 0);
+	dns->evictions = evictions;
+}
+/* }}} */
+#endif
+
+#ifdef LIBEVENT_2_API
+/* {{{ proto resource event_http_new(resource base, mixed handler[, mixed arg])
+   Creates an HTTP server, handler(resource request, arg) is called once a request has been fully read */
+static PHP_FUNCTION(event_http_new)
+{
+	zval *zbase, *zhandler, *zarg = NULL;
+	php_event_base_t *base;
+	php_event_http_t *http;
+	struct evhttp *evh;
+	zend_fcall_info fci;
+	zend_fcall_info_cache fcc;
+	char *func_name;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zz|z", &zbase, &zhandler, &zarg) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_BASE(zbase, base);
+
+	if (_php_event_fcall_init(zhandler, &fci, &fcc, &func_name TSRMLS_CC) != SUCCESS) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "'%s' is not a valid callback", func_name);
+		efree(func_name);
+		RETURN_FALSE;
+	}
+	efree(func_name);
+
+	evh = evhttp_new(base->base);
+	if (!evh) {
+		RETURN_FALSE;
+	}
+
+	http = emalloc(sizeof(php_event_http_t));
+	http->http = evh;
+
+	zval_add_ref(&zhandler);
+	http->handler = zhandler;
+	http->fci = fci;
+	http->fcc = fcc;
+
+	if (zarg) {
+		zval_add_ref(&zarg);
+		http->arg = zarg;
+	} else {
+		ALLOC_INIT_ZVAL(http->arg);
+	}
+
+	/* make sure the base is destroyed after the server */
+	http->base = base;
+	_php_event_base_pin(base TSRMLS_CC);
+
+	TSRMLS_SET_CTX(http->thread_ctx);
+
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	http->rsrc_id = zend_list_insert(http, le_event_http TSRMLS_CC);
+#else
+	http->rsrc_id = zend_list_insert(http, le_event_http);
+#endif
+
+	evhttp_set_gencb(evh, _php_event_http_callback, http);
+	RETURN_RESOURCE(http->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto void event_http_free(resource http)
+   Requests not answered yet keep the server alive */
+static PHP_FUNCTION(event_http_free)
+{
+	zval *zhttp;
+	php_event_http_t *http;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zhttp) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP(zhttp, http);
+	zend_list_delete(http->rsrc_id);
+}
+/* }}} */
+
+/* {{{ proto bool event_http_bind(resource http, string address, int port)
+ */
+static PHP_FUNCTION(event_http_bind)
+{
+	zval *zhttp;
+	php_event_http_t *http;
+	char *address;
+	int address_len;
+	long port;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rsl", &zhttp, &address, &address_len, &port) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP(zhttp, http);
+
+	if (port < 0 || port > 65535) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "port must be between 0 and 65535");
+		RETURN_FALSE;
+	}
+
+	if (evhttp_bind_socket(http->http, address, (ev_uint16_t)port) == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+#ifndef PHP_WIN32
+/* {{{ proto bool event_http_accept(resource http, mixed fd)
+   Serves connections accepted on an already listening socket, such as the one given by event_supervisor_run() */
+static PHP_FUNCTION(event_http_accept)
+{
+	zval *zhttp, *zfd;
+	php_event_http_t *http;
+	php_socket_t fd, dupfd;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz", &zhttp, &zfd) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP(zhttp, http);
+
+	if (_php_event_zval_to_fd(zfd, &fd, NULL TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	/* evhttp closes the socket it accepts on, hand it a descriptor of its own */
+	dupfd = dup(fd);
+	if (dupfd < 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "dup() failed: %s", strerror(errno));
+		RETURN_FALSE;
+	}
+#ifdef FD_CLOEXEC
+	fcntl(dupfd, F_SETFD, FD_CLOEXEC);
+#endif
+
+	if (evhttp_accept_socket(http->http, dupfd) != 0) {
+		closesocket(dupfd);
+		RETURN_FALSE;
+	}
+	RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+/* {{{ proto bool event_http_set_max_headers_size(resource http, int size)
+   Requests with a larger request line and headers are rejected */
+static PHP_FUNCTION(event_http_set_max_headers_size)
+{
+	zval *zhttp;
+	php_event_http_t *http;
+	long size;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zhttp, &size) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP(zhttp, http);
+
+	if (size <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "size must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	evhttp_set_max_headers_size(http->http, (ev_ssize_t)size);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_http_set_max_body_size(resource http, int size)
+   Requests with a larger body are rejected with 413 before the handler is called */
+static PHP_FUNCTION(event_http_set_max_body_size)
+{
+	zval *zhttp;
+	php_event_http_t *http;
+	long size;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zhttp, &size) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP(zhttp, http);
+
+	if (size <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "size must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	evhttp_set_max_body_size(http->http, (ev_ssize_t)size);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_http_set_timeout(resource http, int timeout)
+   Sets the read and write timeout of connections, in seconds */
+static PHP_FUNCTION(event_http_set_timeout)
+{
+	zval *zhttp;
+	php_event_http_t *http;
+	long timeout;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl", &zhttp, &timeout) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP(zhttp, http);
+
+	if (timeout <= 0) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "timeout must be greater than zero");
+		RETURN_FALSE;
+	}
+
+	evhttp_set_timeout(http->http, (int)timeout);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto string event_http_request_get_method(resource request)
+ */
+static PHP_FUNCTION(event_http_request_get_method)
+{
+	zval *zreq;
+	php_event_http_req_t *hreq;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zreq) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+	RETURN_STRING((char *)_php_event_http_method(evhttp_request_get_command(hreq->req)), 1);
+}
+/* }}} */
+
+/* {{{ proto string event_http_request_get_uri(resource request)
+ */
+static PHP_FUNCTION(event_http_request_get_uri)
+{
+	zval *zreq;
+	php_event_http_req_t *hreq;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zreq) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+	RETURN_STRING((char *)evhttp_request_get_uri(hreq->req), 1);
+}
+/* }}} */
+
+/* {{{ proto array event_http_request_get_headers(resource request)
+   Returns array(name => value), repeated headers are joined with ", " */
+static PHP_FUNCTION(event_http_request_get_headers)
+{
+	zval *zreq, **zvalue;
+	php_event_http_req_t *hreq;
+	struct evkeyval *header;
+	char *value;
+	int value_len;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zreq) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	array_init(return_value);
+	for (header = evhttp_request_get_input_headers(hreq->req)->tqh_first; header; header = header->next.tqe_next) {
+		if (zend_hash_find(Z_ARRVAL_P(return_value), header->key, strlen(header->key) + 1, (void **)&zvalue) == SUCCESS) {
+			value_len = spprintf(&value, 0, "%s, %s", Z_STRVAL_PP(zvalue), header->value);
+			add_assoc_stringl(return_value, header->key, value, value_len, 0);
+		} else {
+			add_assoc_string(return_value, header->key, header->value, 1);
+		}
+	}
+}
+/* }}} */
+
+/* {{{ proto string event_http_request_get_body(resource request)
+ */
+static PHP_FUNCTION(event_http_request_get_body)
+{
+	zval *zreq;
+	php_event_http_req_t *hreq;
+	struct evbuffer *buf;
+	size_t len;
+	char *data;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zreq) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	buf = evhttp_request_get_input_buffer(hreq->req);
+	len = evbuffer_get_length(buf);
+
+	data = safe_emalloc(len, 1, 1);
+	evbuffer_copyout(buf, data, len);
+	data[len] = '\0';
+	RETURN_STRINGL(data, len, 0);
+}
+/* }}} */
+
+/* {{{ proto string event_http_request_get_peer(resource request)
+   Returns the address of the client as "address:port", false once it has disconnected */
+static PHP_FUNCTION(event_http_request_get_peer)
+{
+	zval *zreq;
+	php_event_http_req_t *hreq;
+	struct evhttp_connection *evcon;
+	char *address = NULL;
+	ev_uint16_t port = 0;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zreq) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	evcon = evhttp_request_get_connection(hreq->req);
+	if (!evcon) {
+		RETURN_FALSE;
+	}
+
+	evhttp_connection_get_peer(evcon, &address, &port);
+	if (!address) {
+		RETURN_FALSE;
+	}
+
+	Z_STRLEN_P(return_value) = spprintf(&Z_STRVAL_P(return_value), 0, "%s:%d", address, (int)port);
+	Z_TYPE_P(return_value) = IS_STRING;
+}
+/* }}} */
+
+/* {{{ proto bool event_http_request_add_header(resource request, string name, string value)
+   Adds a header to the reply, fails on names or values containing line breaks */
+static PHP_FUNCTION(event_http_request_add_header)
+{
+	zval *zreq;
+	php_event_http_req_t *hreq;
+	char *name, *value;
+	int name_len, value_len;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rss", &zreq, &name, &name_len, &value, &value_len) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (strlen(name) != (size_t)name_len || strlen(value) != (size_t)value_len) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "header must not contain null bytes");
+		RETURN_FALSE;
+	}
+
+	if (evhttp_add_header(evhttp_request_get_output_headers(hreq->req), name, value) == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_http_send_reply(resource request, int code[, mixed body[, string reason]])
+   Sends the whole reply, reason defaults to the standard phrase of code */
+static PHP_FUNCTION(event_http_send_reply)
+{
+	zval *zreq, *zbody = NULL;
+	php_event_http_req_t *hreq;
+	char *reason = NULL;
+	int reason_len;
+	long code;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl|z!s", &zreq, &code, &zbody, &reason, &reason_len) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (hreq->chunked) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "a chunked reply has been started, finish it with event_http_send_reply_end()");
+		RETURN_FALSE;
+	}
+
+	if (zbody && _php_event_evbuffer_add_zval(evhttp_request_get_output_buffer(hreq->req), zbody) != 0) {
+		RETURN_FALSE;
+	}
+
+	evhttp_send_reply(_php_event_http_req_release(hreq), (int)code, reason, NULL);
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_http_send_reply_start(resource request, int code[, string reason])
+   Starts a chunked reply, or a streamed one for HTTP/1.0 clients */
+static PHP_FUNCTION(event_http_send_reply_start)
+{
+	zval *zreq;
+	php_event_http_req_t *hreq;
+	char *reason = NULL;
+	int reason_len;
+	long code;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rl|s", &zreq, &code, &reason, &reason_len) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (hreq->chunked) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "the reply has already been started");
+		RETURN_FALSE;
+	}
+
+	evhttp_send_reply_start(hreq->req, (int)code, reason);
+	hreq->chunked = 1;
+	RETURN_TRUE;
+}
+/* }}} */
+
+/* {{{ proto bool event_http_send_reply_chunk(resource request, mixed data)
+ */
+static PHP_FUNCTION(event_http_send_reply_chunk)
+{
+	zval *zreq, *zdata;
+	php_event_http_req_t *hreq;
+	struct evbuffer *buf;
+	int ret;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "rz", &zreq, &zdata) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (!hreq->chunked) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "start the reply with event_http_send_reply_start() first");
+		RETURN_FALSE;
+	}
+
+	buf = evbuffer_new();
+	if (!buf) {
+		RETURN_FALSE;
+	}
+
+	ret = _php_event_evbuffer_add_zval(buf, zdata);
+	if (ret == 0) {
+		evhttp_send_reply_chunk(hreq->req, buf);
+	}
+	evbuffer_free(buf);
+
+	if (ret == 0) {
+		RETURN_TRUE;
+	}
+	RETURN_FALSE;
+}
+/* }}} */
+
+/* {{{ proto bool event_http_send_reply_end(resource request)
+ */
+static PHP_FUNCTION(event_http_send_reply_end)
+{
+	zval *zreq;
+	php_event_http_req_t *hreq;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "r", &zreq) != SUCCESS) {
+		return;
+	}
+
+	ZVAL_TO_HTTP_REQ(zreq, hreq);
+
+	if (_php_event_http_req_check(hreq TSRMLS_CC) != SUCCESS) {
+		RETURN_FALSE;
+	}
+
+	if (!hreq->chunked) {
+		php_error_docref(NULL TSRMLS_CC, E_WARNING, "start the reply with event_http_send_reply_start() first");
+		RETURN_FALSE;
+	}
+
+	evhttp_send_reply_end(_php_event_http_req_release(hreq));
+	RETURN_TRUE;
+}
+/* }}} */
+#endif
+
+#if PHP_MAJOR_VERSION >= 5
+static void _php_event_object_std_init(zend_object *zo, zend_class_entry *ce TSRMLS_DC) /* {{{ */
+{
+	zend_object_std_init(zo, ce TSRMLS_CC);
+#if PHP_MAJOR_VERSION >= 5 && PHP_MINOR_VERSION >= 4
+	object_properties_init(zo, ce);
+#else
+	zend_hash_copy(zo->properties, &ce->default_properties, (copy_ctor_func_t)zval_add_ref, NULL, sizeof(zval *));
+#endif
+}
+/* }}} */
+
+static void _php_event_base_object_free(void *object TSRMLS_DC) /* {{{ */
+{
+	php_event_base_object_t *obj = (php_event_base_object_t *)object;
+
+	zend_object_std_dtor(&obj->zo TSRMLS_CC);
+
+	if (!obj->base.base) {
+		efree(obj);
+		return;
+	}
+	/* releases the base and obj with it, unless a shutdown left events pinning it */
+	_php_event_base_disown(&obj->base TSRMLS_CC);
+}
+/* }}} */
+
+static zend_object_value _php_event_base_object_new(zend_class_entry *ce TSRMLS_DC) /* {{{ */
+{
+	zend_object_value retval;
+	php_event_base_object_t *obj = ecalloc(1, sizeof(php_event_base_object_t));
+
+	_php_event_object_std_init(&obj->zo, ce TSRMLS_CC);
+
+	retval.handle = zend_objects_store_put(obj, (zend_objects_store_dtor_t)zend_objects_destroy_object, _php_event_base_object_free, NULL TSRMLS_CC);
+	retval.handlers = &php_event_base_object_handlers;
+	return retval;
+}
+/* }}} */
+
+static void _php_event_object_free(void *object TSRMLS_DC) /* {{{ */
+{
+	php_event_object_t *obj = (php_event_object_t *)object;
+	php_event_base_t *base = obj->block.event.base;
+
+	zend_object_std_dtor(&obj->zo TSRMLS_CC);
+
+	if (!obj->block.event.in_free) {
+		_php_event_clear(&obj->block.event TSRMLS_CC);
+	}
+	efree(obj);
+
+	/* the base goes last, it may go with the event */
+	if (base) {
+		_php_event_base_unpin(base TSRMLS_CC);
+	}
+}
+/* }}} */
+
+static zend_object_value _php_event_object_new(zend_class_entry *ce TSRMLS_DC) /* {{{ */
+{
+	zend_object_value retval;
+	php_event_object_t *obj = ecalloc(1, sizeof(php_event_object_t));
+
+	_php_event_object_std_init(&obj->zo, ce TSRMLS_CC);
+
+	/* an Event is usable right away, like the resource from event_new() */
+	obj->block.event.event = &obj->block.ev;
+	_php_event_init(&obj->block.event TSRMLS_CC);
+
+	retval.handle = zend_objects_store_put(obj, (zend_objects_store_dtor_t)zend_objects_destroy_object, _php_event_object_free, NULL TSRMLS_CC);
+	retval.handlers = &php_event_object_handlers;
+	obj->block.event.handle = retval.handle;
+	return retval;
+}
+/* }}} */
+
+static void _php_bufferevent_object_free(void *object TSRMLS_DC) /* {{{ */
+{
+	php_bufferevent_object_t *obj = (php_bufferevent_object_t *)object;
+	php_event_base_t *base = obj->bevent.base;
+
+	zend_object_std_dtor(&obj->zo TSRMLS_CC);
+
+	if (obj->bevent.bevent) {
+		_php_bufferevent_clear(&obj->bevent TSRMLS_CC);
+	}
+	efree(obj);
+
+	if (base) {
+		_php_event_base_unpin(base TSRMLS_CC);
+	}
+}
+/* }}} */
+
+static zend_object_value _php_bufferevent_object_new(zend_class_entry *ce TSRMLS_DC) /* {{{ */
+{
+	zend_object_value retval;
+	php_bufferevent_object_t *obj = ecalloc(1, sizeof(php_bufferevent_object_t));
+
+	_php_event_object_std_init(&obj->zo, ce TSRMLS_CC);
+
+	retval.handle = zend_objects_store_put(obj, (zend_objects_store_dtor_t)zend_objects_destroy_object, _php_bufferevent_object_free, NULL TSRMLS_CC);
+	retval.handlers = &php_bufferevent_object_handlers;
+	return retval;
+}
+/* }}} */
+
+/* {{{ proto EventBase::__construct()
+   Creates the base event_base_new() would, held by the object for as long as it lives */
+static PHP_METHOD(EventBase, __construct)
+{
+	php_event_base_object_t *obj = (php_event_base_object_t *)zend_object_store_get_object(getThis() TSRMLS_CC);
+	struct event_base *evbase;
+
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+		return;
+	}
+
+	if (obj->base.base) {
+		zend_throw_exception_ex(NULL, 0 TSRMLS_CC, "%s has already been constructed", Z_OBJCE_P(getThis())->name);
+		return;
+	}
+
+	evbase = event_base_new();
+	if (!evbase) {
+		zend_throw_exception_ex(NULL, 0 TSRMLS_CC, "%s could not be constructed", Z_OBJCE_P(getThis())->name);
+		return;
+	}
+
+	_php_event_base_init(&obj->base, evbase TSRMLS_CC);
+	obj->base.handle = Z_OBJ_HANDLE_P(getThis());
+}
+/* }}} */
+
+/* {{{ proto Event::__construct()
+ */
+static PHP_METHOD(Event, __construct)
+{
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "") != SUCCESS) {
+		return;
+	}
+}
+/* }}} */
+
+/* {{{ proto BufferEvent::__construct(mixed fd, mixed readcb, mixed writecb, mixed errorcb[, mixed arg])
+ */
+static PHP_METHOD(BufferEvent, __construct)
+{
+	php_bufferevent_object_t *obj = (php_bufferevent_object_t *)zend_object_store_get_object(getThis() TSRMLS_CC);
+	zval *zfd, *zreadcb, *zwritecb, *zerrorcb, *zarg = NULL;
+	zend_error_handling error_handling;
+	int ret = FAILURE;
+
+	if (obj->bevent.bevent) {
+		zend_throw_exception_ex(NULL, 0 TSRMLS_CC, "%s has already been constructed", Z_OBJCE_P(getThis())->name);
+		return;
+	}
+
+	zend_replace_error_handling(EH_THROW, NULL, &error_handling TSRMLS_CC);
+	if (zend_parse_parameters(ZEND_NUM_ARGS() TSRMLS_CC, "zzzz|z", &zfd, &zreadcb, &zwritecb, &zerrorcb, &zarg) == SUCCESS) {
+		ret = _php_bufferevent_setup(&obj->bevent, zfd, zreadcb, zwritecb, zerrorcb, zarg TSRMLS_CC);
+	}
+	zend_restore_error_handling(&error_handling TSRMLS_CC);
+
+	if (ret != SUCCESS) {
+		/* warnings have been turned into an exception already */
+		if (!EG(exception)) {
+			zend_throw_exception_ex(NULL, 0 TSRMLS_CC, "%s could not be constructed", Z_OBJCE_P(getThis())->name);
+		}
+		return;
+	}
+	obj->bevent.handle = Z_OBJ_HANDLE_P(getThis());
+}
+/* }}} */
+#endif
+
+/* {{{ PHP_GINIT_FUNCTION
+ */
+static PHP_GINIT_FUNCTION(libevent)
+{
+	memset(libevent_globals, 0, sizeof(zend_libevent_globals));
+}
+/* }}} */
+
+/* {{{ PHP_GSHUTDOWN_FUNCTION
+ */
+static PHP_GSHUTDOWN_FUNCTION(libevent)
+{
+	void *slab = libevent_globals->event_slabs;
+
+	while (slab) {
+		void *next = *(void **)slab;
+
+		pefree(slab, 1);
+		slab = next;
+	}
+	libevent_globals->event_slabs = NULL;
+	libevent_globals->event_free = NULL;
+}
+/* }}} */
+
+/* {{{ PHP_MINIT_FUNCTION
+ */
+static PHP_MINIT_FUNCTION(libevent)
+{
+	le_event_base = zend_register_list_destructors_ex(_php_event_base_dtor, NULL, "event base", module_number);
+	le_event = zend_register_list_destructors_ex(_php_event_dtor, NULL, "event", module_number);
+	le_bufferevent = zend_register_list_destructors_ex(_php_bufferevent_dtor, NULL, "buffer event", module_number);
+	le_timer_wheel = zend_register_list_destructors_ex(_php_timer_wheel_dtor, NULL, "event timer wheel", module_number);
+	le_event_listener = zend_register_list_destructors_ex(_php_event_listener_dtor, NULL, "event listener", module_number);
+#ifdef LIBEVENT_2_API
+	le_event_config = zend_register_list_destructors_ex(_php_event_config_dtor, NULL, "event config", module_number);
+	le_event_dns = zend_register_list_destructors_ex(_php_event_dns_dtor, NULL, "event dns base", module_number);
+	le_event_http = zend_register_list_destructors_ex(_php_event_http_dtor, NULL, "event http", module_number);
+	le_event_http_req = zend_register_list_destructors_ex(_php_event_http_req_dtor, NULL, "event http request", module_number);
+	le_event_rate_group = zend_register_list_destructors_ex(_php_event_rate_group_dtor, NULL, "event rate limit group", module_number);
+	le_event_pipe = zend_register_list_destructors_ex(_php_event_pipe_dtor, NULL, "event buffer pipe", module_number);
+#endif
+#ifdef LIBEVENT_SPLICE_SUPPORT
+	le_event_relay = zend_register_list_destructors_ex(_php_event_relay_dtor, NULL, "event relay", module_number);
+#endif
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+	le_event_signal_watcher = zend_register_list_destructors_ex(_php_event_signal_watcher_dtor, NULL, "event signal watcher", module_number);
+	sigemptyset(&php_event_signalfd_blocked);
+#endif
+#if PHP_MAJOR_VERSION >= 5
+	_php_event_register_classes(TSRMLS_C);
+#endif
+
+	REGISTER_LONG_CONSTANT("EV_TIMEOUT", EV_TIMEOUT, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EV_READ", EV_READ, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EV_WRITE", EV_WRITE, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EV_SIGNAL", EV_SIGNAL, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EV_PERSIST", EV_PERSIST, CONST_CS | CONST_PERSISTENT);
+#ifdef LIBEVENT_2_API
+	REGISTER_LONG_CONSTANT("EV_ET", EV_ET, CONST_CS | CONST_PERSISTENT);
+#endif
+	REGISTER_LONG_CONSTANT("EVLOOP_NONBLOCK", EVLOOP_NONBLOCK, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVLOOP_ONCE", EVLOOP_ONCE, CONST_CS | CONST_PERSISTENT);
+	
+	REGISTER_LONG_CONSTANT("EVBUFFER_READ", EVBUFFER_READ, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVBUFFER_WRITE", EVBUFFER_WRITE, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVBUFFER_EOF", EVBUFFER_EOF, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVBUFFER_ERROR", EVBUFFER_ERROR, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVBUFFER_TIMEOUT", EVBUFFER_TIMEOUT, CONST_CS | CONST_PERSISTENT);
+
+#ifdef LIBEVENT_2_API
+	REGISTER_LONG_CONSTANT("EV_FEATURE_ET", EV_FEATURE_ET, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EV_FEATURE_O1", EV_FEATURE_O1, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EV_FEATURE_FDS", EV_FEATURE_FDS, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_BASE_FLAG_NOLOCK", EVENT_BASE_FLAG_NOLOCK, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_BASE_FLAG_IGNORE_ENV", EVENT_BASE_FLAG_IGNORE_ENV, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_BASE_FLAG_STARTUP_IOCP", EVENT_BASE_FLAG_STARTUP_IOCP, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_BASE_FLAG_NO_CACHE_TIME", EVENT_BASE_FLAG_NO_CACHE_TIME, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_BASE_FLAG_EPOLL_USE_CHANGELIST", EVENT_BASE_FLAG_EPOLL_USE_CHANGELIST, CONST_CS | CONST_PERSISTENT);
+# if LIBEVENT_VERSION_NUMBER >= 0x02010100
+	REGISTER_LONG_CONSTANT("EV_FEATURE_EARLY_CLOSE", EV_FEATURE_EARLY_CLOSE, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_BASE_FLAG_PRECISE_TIMER", EVENT_BASE_FLAG_PRECISE_TIMER, CONST_CS | CONST_PERSISTENT);
+# endif
+
+	REGISTER_LONG_CONSTANT("EVENT_DNS_IPv4_A", DNS_IPv4_A, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_IPv6_AAAA", DNS_IPv6_AAAA, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_PTR", DNS_PTR, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_QUERY_NO_SEARCH", DNS_QUERY_NO_SEARCH, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_NONE", DNS_ERR_NONE, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_FORMAT", DNS_ERR_FORMAT, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_SERVERFAILED", DNS_ERR_SERVERFAILED, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_NOTEXIST", DNS_ERR_NOTEXIST, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_NOTIMPL", DNS_ERR_NOTIMPL, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_REFUSED", DNS_ERR_REFUSED, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_TRUNCATED", DNS_ERR_TRUNCATED, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_UNKNOWN", DNS_ERR_UNKNOWN, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_TIMEOUT", DNS_ERR_TIMEOUT, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_SHUTDOWN", DNS_ERR_SHUTDOWN, CONST_CS | CONST_PERSISTENT);
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_CANCEL", DNS_ERR_CANCEL, CONST_CS | CONST_PERSISTENT);
+# ifdef DNS_ERR_NODATA
+	REGISTER_LONG_CONSTANT("EVENT_DNS_ERR_NODATA", DNS_ERR_NODATA, CONST_CS | CONST_PERSISTENT);
+# endif
+#endif
+
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ PHP_MSHUTDOWN_FUNCTION
+ */
+static PHP_MSHUTDOWN_FUNCTION(libevent)
+{
+#ifdef LIBEVENT_ASYNC_SUPPORT
+	_php_event_pool_stop();
+#endif
+	return SUCCESS;
+}
+/* }}} */
+
+/* {{{ PHP_MINFO_FUNCTION
+ */
+static PHP_MINFO_FUNCTION(libevent)
+{
+	char buf[64];
+
+
+	php_info_print_table_start();
+	php_info_print_table_header(2, "libevent support", "enabled");
+	php_info_print_table_row(2, "extension version", PHP_LIBEVENT_VERSION);
+	php_info_print_table_row(2, "Revision", "$Revision$");
+	
+	snprintf(buf, sizeof(buf) - 1, "%s", event_get_version());
+	php_info_print_table_row(2, "libevent version", buf);
+
+#ifdef LIBEVENT_2_API
+	{
+		const char **methods = event_get_supported_methods();
+		struct event_base *evbase;
+		char *list = NULL;
+		int i;
+
+		for (i = 0; methods && methods[i]; i++) {
+			char *tmp = list;
+
+			spprintf(&list, 0, "%s%s%s", tmp ? tmp : "", tmp ? ", " : "", methods[i]);
+			if (tmp) {
+				efree(tmp);
+			}
+		}
+		php_info_print_table_row(2, "supported backends", list ? list : "none");
+		if (list) {
+			efree(list);
+		}
+
+		evbase = event_base_new();
+		if (evbase) {
+			php_info_print_table_row(2, "default backend", event_base_get_method(evbase));
+			event_base_free(evbase);
+		}
+	}
+#elif defined(HAVE_EVENT_BASE_GET_METHOD)
+	{
+		/* event_get_method() would read the base of event_init(), which is never called */
+		struct event_base *evbase = event_base_new();
+
+		if (evbase) {
+			php_info_print_table_row(2, "default backend", event_base_get_method(evbase));
+			event_base_free(evbase);
+		}
+	}
+#else
+	php_info_print_table_row(2, "default backend", "n/a");
+#endif
+
+	php_info_print_table_end();
+}
+/* }}} */
+
+#if PHP_MAJOR_VERSION >= 5
+/* {{{ arginfo */
+#if (PHP_MAJOR_VERSION == 5 && PHP_MINOR_VERSION >= 3) || PHP_MAJOR_VERSION > 5
+# define EVENT_ARGINFO
+#else
+# define EVENT_ARGINFO static
+#endif
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_loop, 0, 0, 1)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_loopbreak, 0, 0, 1)
+	ZEND_ARG_INFO(0, base)
+ZEND_END_ARG_INFO()
+
+#ifdef LIBEVENT_SUPERVISOR_SUPPORT
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_supervisor_run, 0, 0, 3)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, workers)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, listen)
+	ZEND_ARG_INFO(0, arg)
+	ZEND_ARG_INFO(0, backlog)
+ZEND_END_ARG_INFO()
+#endif
+
+#ifdef LIBEVENT_ASYNC_SUPPORT
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_async_read_file, 0, 0, 3)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, path)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+	ZEND_ARG_INFO(0, offset)
+	ZEND_ARG_INFO(0, length)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_async_fsync, 0, 0, 3)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, fd)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_async_getaddrinfo, 0, 0, 3)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, host)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+	ZEND_ARG_INFO(0, family)
+ZEND_END_ARG_INFO()
 #endif
 
 EVENT_ARGINFO
-ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_loop, 0, 0, 1)
-	ZEND_ARG_INFO(0, base)
-	ZEND_ARG_INFO(0, flags)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_loopexit, 0, 0, 1)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_stats, 0, 0, 1)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, reset)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_profile_enable, 0, 0, 1)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, threshold)
+	ZEND_ARG_INFO(0, hook)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_set, 0, 0, 2)
+	ZEND_ARG_INFO(0, event)
+	ZEND_ARG_INFO(0, base)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_priority_init, 0, 0, 2)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, npriorities)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_once, 0, 0, 5)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, fd)
+	ZEND_ARG_INFO(0, events)
+	ZEND_ARG_INFO(0, timeout)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_defer, 0, 0, 2)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_set_defer_budget, 0, 0, 2)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, budget)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_set_batch_callback, 0, 0, 2)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, callback)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_config_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, config)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_config_avoid_method, 0, 0, 2)
+	ZEND_ARG_INFO(0, config)
+	ZEND_ARG_INFO(0, method)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_config_require_features, 0, 0, 2)
+	ZEND_ARG_INFO(0, config)
+	ZEND_ARG_INFO(0, features)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_config_set_flag, 0, 0, 2)
+	ZEND_ARG_INFO(0, config)
+	ZEND_ARG_INFO(0, flag)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_config_set_max_dispatch_interval, 0, 0, 4)
+	ZEND_ARG_INFO(0, config)
+	ZEND_ARG_INFO(0, max_interval)
+	ZEND_ARG_INFO(0, max_callbacks)
+	ZEND_ARG_INFO(0, min_priority)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_dns_base_new, 0, 0, 1)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, resolv_conf)
+	ZEND_ARG_INFO(0, cache_size)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_dns_base_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, dns)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_dns_nameserver_add, 0, 0, 2)
+	ZEND_ARG_INFO(0, dns)
+	ZEND_ARG_INFO(0, address)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_dns_resolve, 0, 0, 4)
+	ZEND_ARG_INFO(0, dns)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, type)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_dns_cache_stats, 0, 0, 1)
+	ZEND_ARG_INFO(0, dns)
+	ZEND_ARG_INFO(0, reset)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_new, 0, 0, 2)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, handler)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, http)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_bind, 0, 0, 3)
+	ZEND_ARG_INFO(0, http)
+	ZEND_ARG_INFO(0, address)
+	ZEND_ARG_INFO(0, port)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_accept, 0, 0, 2)
+	ZEND_ARG_INFO(0, http)
+	ZEND_ARG_INFO(0, fd)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_set_max_size, 0, 0, 2)
+	ZEND_ARG_INFO(0, http)
+	ZEND_ARG_INFO(0, size)
 ZEND_END_ARG_INFO()
 
 EVENT_ARGINFO
-ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_loopbreak, 0, 0, 1)
-	ZEND_ARG_INFO(0, base)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_set_timeout, 0, 0, 2)
+	ZEND_ARG_INFO(0, http)
+	ZEND_ARG_INFO(0, timeout)
 ZEND_END_ARG_INFO()
 
 EVENT_ARGINFO
-ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_loopexit, 0, 0, 1)
-	ZEND_ARG_INFO(0, base)
-	ZEND_ARG_INFO(0, timeout)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_request_get_uri, 0, 0, 1)
+	ZEND_ARG_INFO(0, request)
 ZEND_END_ARG_INFO()
 
 EVENT_ARGINFO
-ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_set, 0, 0, 2)
-	ZEND_ARG_INFO(0, event)
-	ZEND_ARG_INFO(0, base)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_request_add_header, 0, 0, 3)
+	ZEND_ARG_INFO(0, request)
+	ZEND_ARG_INFO(0, name)
+	ZEND_ARG_INFO(0, value)
 ZEND_END_ARG_INFO()
 
 EVENT_ARGINFO
-ZEND_BEGIN_ARG_INFO_EX(arginfo_event_base_priority_init, 0, 0, 2)
-	ZEND_ARG_INFO(0, base)
-	ZEND_ARG_INFO(0, npriorities)
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_send_reply, 0, 0, 2)
+	ZEND_ARG_INFO(0, request)
+	ZEND_ARG_INFO(0, code)
+	ZEND_ARG_INFO(0, body)
+	ZEND_ARG_INFO(0, reason)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_send_reply_start, 0, 0, 2)
+	ZEND_ARG_INFO(0, request)
+	ZEND_ARG_INFO(0, code)
+	ZEND_ARG_INFO(0, reason)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_http_send_reply_chunk, 0, 0, 2)
+	ZEND_ARG_INFO(0, request)
+	ZEND_ARG_INFO(0, data)
 ZEND_END_ARG_INFO()
 
 EVENT_ARGINFO
 ZEND_BEGIN_ARG_INFO(arginfo_event_new, 0)
 ZEND_END_ARG_INFO()
 
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO(arginfo_event_pool_stats, 0)
+ZEND_END_ARG_INFO()
+
 EVENT_ARGINFO
 ZEND_BEGIN_ARG_INFO_EX(arginfo_event_add, 0, 0, 1)
 	ZEND_ARG_INFO(0, event)
@@ -1485,6 +8998,13 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_event_set, 0, 0, 4)
 	ZEND_ARG_INFO(0, arg)
 ZEND_END_ARG_INFO()
 
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_read_drain, 0, 0, 1)
+	ZEND_ARG_INFO(0, fd)
+	ZEND_ARG_INFO(0, max_length)
+	ZEND_ARG_INFO(1, eof)
+ZEND_END_ARG_INFO()
+
 EVENT_ARGINFO
 ZEND_BEGIN_ARG_INFO_EX(arginfo_event_del, 0, 0, 1)
 	ZEND_ARG_INFO(0, event)
@@ -1496,6 +9016,23 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_event_priority_set, 0, 0, 2)
 	ZEND_ARG_INFO(0, priority)
 ZEND_END_ARG_INFO()
 
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_add_many, 0, 0, 1)
+	ZEND_ARG_INFO(0, events)
+	ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_del_many, 0, 0, 1)
+	ZEND_ARG_INFO(0, events)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_priority_set_many, 0, 0, 2)
+	ZEND_ARG_INFO(0, events)
+	ZEND_ARG_INFO(0, priority)
+ZEND_END_ARG_INFO()
+
 EVENT_ARGINFO
 ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_new, 0, 0, 4)
 	ZEND_ARG_INFO(0, stream)
@@ -1529,6 +9066,22 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_write, 0, 0, 2)
 	ZEND_ARG_INFO(0, data_size)
 ZEND_END_ARG_INFO()
 
+#ifdef LIBEVENT_2_API
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_write_array, 0, 0, 2)
+	ZEND_ARG_INFO(0, bevent)
+	ZEND_ARG_INFO(0, data)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_add_file, 0, 0, 3)
+	ZEND_ARG_INFO(0, bevent)
+	ZEND_ARG_INFO(0, fd)
+	ZEND_ARG_INFO(0, offset)
+	ZEND_ARG_INFO(0, length)
+ZEND_END_ARG_INFO()
+#endif
+
 EVENT_ARGINFO
 ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_read, 0, 0, 2)
 	ZEND_ARG_INFO(0, bevent)
@@ -1571,6 +9124,124 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_set_callback, 0, 0, 4)
 	ZEND_ARG_INFO(0, arg)
 ZEND_END_ARG_INFO()
 
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_set_rate_limit, 0, 0, 5)
+	ZEND_ARG_INFO(0, bevent)
+	ZEND_ARG_INFO(0, read_rate)
+	ZEND_ARG_INFO(0, read_burst)
+	ZEND_ARG_INFO(0, write_rate)
+	ZEND_ARG_INFO(0, write_burst)
+	ZEND_ARG_INFO(0, tick)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_set_rate_limit_group, 0, 0, 2)
+	ZEND_ARG_INFO(0, bevent)
+	ZEND_ARG_INFO(0, group)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_rate_limit_group_new, 0, 0, 5)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, read_rate)
+	ZEND_ARG_INFO(0, read_burst)
+	ZEND_ARG_INFO(0, write_rate)
+	ZEND_ARG_INFO(0, write_burst)
+	ZEND_ARG_INFO(0, tick)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_rate_limit_group_set, 0, 0, 5)
+	ZEND_ARG_INFO(0, group)
+	ZEND_ARG_INFO(0, read_rate)
+	ZEND_ARG_INFO(0, read_burst)
+	ZEND_ARG_INFO(0, write_rate)
+	ZEND_ARG_INFO(0, write_burst)
+	ZEND_ARG_INFO(0, tick)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_rate_limit_group_set_min_share, 0, 0, 2)
+	ZEND_ARG_INFO(0, group)
+	ZEND_ARG_INFO(0, share)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_rate_limit_group_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, group)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_rate_limit_group_stats, 0, 0, 1)
+	ZEND_ARG_INFO(0, group)
+	ZEND_ARG_INFO(0, reset)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_pipe, 0, 0, 3)
+	ZEND_ARG_INFO(0, bevent_a)
+	ZEND_ARG_INFO(0, bevent_b)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+	ZEND_ARG_INFO(0, high)
+	ZEND_ARG_INFO(0, low)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_buffer_pipe_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, pipe)
+ZEND_END_ARG_INFO()
+
+#ifdef LIBEVENT_SPLICE_SUPPORT
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_relay_new, 0, 0, 4)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, fd_a)
+	ZEND_ARG_INFO(0, fd_b)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+	ZEND_ARG_INFO(0, chunk)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_relay_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, relay)
+ZEND_END_ARG_INFO()
+#endif
+
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_signal_watch, 0, 0, 3)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, signals)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_signal_watcher_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, watcher)
+ZEND_END_ARG_INFO()
+#endif
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_listener_new, 0, 0, 6)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, fd)
+	ZEND_ARG_INFO(0, acceptcb)
+	ZEND_ARG_INFO(0, readcb)
+	ZEND_ARG_INFO(0, writecb)
+	ZEND_ARG_INFO(0, errorcb)
+	ZEND_ARG_INFO(0, arg)
+	ZEND_ARG_INFO(0, budget)
+	ZEND_ARG_INFO(0, events)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_listener_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, listener)
+ZEND_END_ARG_INFO()
+
 EVENT_ARGINFO
 ZEND_BEGIN_ARG_INFO_EX(arginfo_event_timer_set, 0, 0, 2)
 	ZEND_ARG_INFO(0, event)
@@ -1583,6 +9254,39 @@ ZEND_BEGIN_ARG_INFO_EX(arginfo_event_timer_pending, 0, 0, 1)
 	ZEND_ARG_INFO(0, event)
 	ZEND_ARG_INFO(0, timeout)
 ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_timer_wheel_new, 0, 0, 4)
+	ZEND_ARG_INFO(0, base)
+	ZEND_ARG_INFO(0, tick)
+	ZEND_ARG_INFO(0, slots)
+	ZEND_ARG_INFO(0, callback)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_timer_wheel_free, 0, 0, 1)
+	ZEND_ARG_INFO(0, wheel)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_timer_wheel_add, 0, 0, 2)
+	ZEND_ARG_INFO(0, wheel)
+	ZEND_ARG_INFO(0, timeout)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_timer_wheel_reset, 0, 0, 3)
+	ZEND_ARG_INFO(0, wheel)
+	ZEND_ARG_INFO(0, handle)
+	ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_timer_wheel_cancel, 0, 0, 2)
+	ZEND_ARG_INFO(0, wheel)
+	ZEND_ARG_INFO(0, handle)
+ZEND_END_ARG_INFO()
 /* }}} */
 
 /* {{{ libevent_functions[]
@@ -1592,24 +9296,65 @@ const
 #endif
 zend_function_entry libevent_functions[] = {
 	PHP_FE(event_base_new, 				arginfo_event_new)
+#ifdef LIBEVENT_2_API
+	PHP_FE(event_base_new_with_config,	arginfo_event_config_free)
+	PHP_FE(event_base_get_method,		arginfo_event_base_loopbreak)
+	PHP_FE(event_base_get_features,		arginfo_event_base_loopbreak)
+	PHP_FE(event_config_new,			arginfo_event_new)
+	PHP_FE(event_config_free,			arginfo_event_config_free)
+	PHP_FE(event_config_avoid_method,	arginfo_event_config_avoid_method)
+	PHP_FE(event_config_require_features,	arginfo_event_config_require_features)
+	PHP_FE(event_config_set_flag,		arginfo_event_config_set_flag)
+# if LIBEVENT_VERSION_NUMBER >= 0x02010100
+	PHP_FE(event_config_set_max_dispatch_interval,	arginfo_event_config_set_max_dispatch_interval)
+# endif
+#endif
 	PHP_FE(event_base_reinit, 			arginfo_event_base_loopbreak)
+#ifdef LIBEVENT_SUPERVISOR_SUPPORT
+	PHP_FE(event_supervisor_run, 		arginfo_event_supervisor_run)
+#endif
+#ifdef LIBEVENT_ASYNC_SUPPORT
+	PHP_FE(event_async_read_file, 		arginfo_event_async_read_file)
+	PHP_FE(event_async_fsync, 			arginfo_event_async_fsync)
+	PHP_FE(event_async_getaddrinfo, 	arginfo_event_async_getaddrinfo)
+	PHP_FE(event_async_stats, 			arginfo_event_base_stats)
+#endif
 	PHP_FE(event_base_free, 			arginfo_event_base_loopbreak)
 	PHP_FE(event_base_loop, 			arginfo_event_base_loop)
 	PHP_FE(event_base_loopbreak, 		arginfo_event_base_loopbreak)
 	PHP_FE(event_base_loopexit, 		arginfo_event_base_loopexit)
+	PHP_FE(event_base_stats, 			arginfo_event_base_stats)
+	PHP_FE(event_base_profile_enable, 	arginfo_event_base_profile_enable)
+	PHP_FE(event_base_profile_disable, 	arginfo_event_base_loopbreak)
+	PHP_FE(event_base_get_histograms, 	arginfo_event_base_stats)
 	PHP_FE(event_base_set, 				arginfo_event_base_set)
 	PHP_FE(event_base_priority_init, 	arginfo_event_base_priority_init)
+	PHP_FE(event_base_once, 			arginfo_event_base_once)
+	PHP_FE(event_base_defer, 			arginfo_event_base_defer)
+	PHP_FE(event_base_set_defer_budget,	arginfo_event_base_set_defer_budget)
+#ifdef LIBEVENT_2_API
+	PHP_FE(event_base_set_batch_callback,	arginfo_event_base_set_batch_callback)
+#endif
 	PHP_FE(event_new, 					arginfo_event_new)
+	PHP_FE(event_pool_stats, 			arginfo_event_pool_stats)
 	PHP_FE(event_free, 					arginfo_event_del)
 	PHP_FE(event_add, 					arginfo_event_add)
 	PHP_FE(event_set, 					arginfo_event_set)
 	PHP_FE(event_del, 					arginfo_event_del)
+	PHP_FE(event_read_drain, 			arginfo_event_read_drain)
 	PHP_FE(event_priority_set, 			arginfo_event_priority_set)
+	PHP_FE(event_add_many, 				arginfo_event_add_many)
+	PHP_FE(event_del_many, 				arginfo_event_del_many)
+	PHP_FE(event_priority_set_many, 	arginfo_event_priority_set_many)
 	PHP_FE(event_buffer_new, 			arginfo_event_buffer_new)
 	PHP_FE(event_buffer_free, 			arginfo_event_buffer_free)
 	PHP_FE(event_buffer_base_set, 		arginfo_event_buffer_base_set)
 	PHP_FE(event_buffer_priority_set, 	arginfo_event_buffer_priority_set)
 	PHP_FE(event_buffer_write, 			arginfo_event_buffer_write)
+#ifdef LIBEVENT_2_API
+	PHP_FE(event_buffer_write_array, 	arginfo_event_buffer_write_array)
+	PHP_FE(event_buffer_add_file, 		arginfo_event_buffer_add_file)
+#endif
 	PHP_FE(event_buffer_read, 			arginfo_event_buffer_read)
 	PHP_FE(event_buffer_enable, 		arginfo_event_buffer_disable)
 	PHP_FE(event_buffer_disable, 		arginfo_event_buffer_disable)
@@ -1617,13 +9362,237 @@ zend_function_entry libevent_functions[] = {
 	PHP_FE(event_buffer_watermark_set, 	arginfo_event_buffer_watermark_set)
 	PHP_FE(event_buffer_fd_set, 		arginfo_event_buffer_fd_set)
 	PHP_FE(event_buffer_set_callback, 	arginfo_event_buffer_set_callback)
+#ifdef LIBEVENT_2_API
+	PHP_FE(event_buffer_set_rate_limit, 	arginfo_event_buffer_set_rate_limit)
+	PHP_FE(event_buffer_set_rate_limit_group,	arginfo_event_buffer_set_rate_limit_group)
+	PHP_FE(event_rate_limit_group_new, 	arginfo_event_rate_limit_group_new)
+	PHP_FE(event_rate_limit_group_set, 	arginfo_event_rate_limit_group_set)
+	PHP_FE(event_rate_limit_group_set_min_share,	arginfo_event_rate_limit_group_set_min_share)
+	PHP_FE(event_rate_limit_group_free, 	arginfo_event_rate_limit_group_free)
+	PHP_FE(event_rate_limit_group_stats, 	arginfo_event_rate_limit_group_stats)
+	PHP_FE(event_buffer_pipe, 			arginfo_event_buffer_pipe)
+	PHP_FE(event_buffer_pipe_free, 		arginfo_event_buffer_pipe_free)
+	PHP_FE(event_buffer_pipe_stats, 	arginfo_event_buffer_pipe_free)
+#endif
+#ifdef LIBEVENT_SPLICE_SUPPORT
+	PHP_FE(event_relay_new, 			arginfo_event_relay_new)
+	PHP_FE(event_relay_free, 			arginfo_event_relay_free)
+	PHP_FE(event_relay_stats, 			arginfo_event_relay_free)
+#endif
+#ifdef LIBEVENT_SIGNALFD_SUPPORT
+	PHP_FE(event_signal_watch, 			arginfo_event_signal_watch)
+	PHP_FE(event_signal_watcher_free, 	arginfo_event_signal_watcher_free)
+	PHP_FE(event_signal_watcher_stats, 	arginfo_event_signal_watcher_free)
+#endif
+	PHP_FE(event_listener_new, 			arginfo_event_listener_new)
+	PHP_FE(event_listener_free, 		arginfo_event_listener_free)
+	PHP_FE(event_listener_enable, 		arginfo_event_listener_free)
+	PHP_FE(event_listener_disable, 		arginfo_event_listener_free)
+#ifdef LIBEVENT_2_API
+	PHP_FE(event_dns_base_new, 			arginfo_event_dns_base_new)
+	PHP_FE(event_dns_base_free, 		arginfo_event_dns_base_free)
+	PHP_FE(event_dns_nameserver_add, 	arginfo_event_dns_nameserver_add)
+	PHP_FE(event_dns_resolve, 			arginfo_event_dns_resolve)
+	PHP_FE(event_dns_cache_stats, 		arginfo_event_dns_cache_stats)
+	PHP_FE(event_dns_cache_clear, 		arginfo_event_dns_base_free)
+	PHP_FE(event_http_new, 				arginfo_event_http_new)
+	PHP_FE(event_http_free, 			arginfo_event_http_free)
+	PHP_FE(event_http_bind, 			arginfo_event_http_bind)
+# ifndef PHP_WIN32
+	PHP_FE(event_http_accept, 			arginfo_event_http_accept)
+# endif
+	PHP_FE(event_http_set_max_headers_size,	arginfo_event_http_set_max_size)
+	PHP_FE(event_http_set_max_body_size,	arginfo_event_http_set_max_size)
+	PHP_FE(event_http_set_timeout, 		arginfo_event_http_set_timeout)
+	PHP_FE(event_http_request_get_method,	arginfo_event_http_request_get_uri)
+	PHP_FE(event_http_request_get_uri,	arginfo_event_http_request_get_uri)
+	PHP_FE(event_http_request_get_headers,	arginfo_event_http_request_get_uri)
+	PHP_FE(event_http_request_get_body,	arginfo_event_http_request_get_uri)
+	PHP_FE(event_http_request_get_peer,	arginfo_event_http_request_get_uri)
+	PHP_FE(event_http_request_add_header,	arginfo_event_http_request_add_header)
+	PHP_FE(event_http_send_reply, 		arginfo_event_http_send_reply)
+	PHP_FE(event_http_send_reply_start,	arginfo_event_http_send_reply_start)
+	PHP_FE(event_http_send_reply_chunk,	arginfo_event_http_send_reply_chunk)
+	PHP_FE(event_http_send_reply_end,	arginfo_event_http_request_get_uri)
+#endif
 	PHP_FALIAS(event_timer_new,			event_new,		arginfo_event_new)
 	PHP_FE(event_timer_set,				arginfo_event_timer_set)
 	PHP_FE(event_timer_pending,			arginfo_event_timer_pending)
 	PHP_FALIAS(event_timer_add,			event_add,		arginfo_event_add)
 	PHP_FALIAS(event_timer_del,			event_del,		arginfo_event_del)
+	PHP_FE(event_timer_wheel_new,		arginfo_event_timer_wheel_new)
+	PHP_FE(event_timer_wheel_free,		arginfo_event_timer_wheel_free)
+	PHP_FE(event_timer_wheel_add,		arginfo_event_timer_wheel_add)
+	PHP_FE(event_timer_wheel_reset,		arginfo_event_timer_wheel_reset)
+	PHP_FE(event_timer_wheel_cancel,	arginfo_event_timer_wheel_cancel)
+	{NULL, NULL, NULL}
+};
+/* }}} */
+
+/* {{{ class method tables */
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_void, 0, 0, 0)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_loop, 0, 0, 0)
+	ZEND_ARG_INFO(0, flags)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_loopexit, 0, 0, 0)
+	ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_priority_init, 0, 0, 1)
+	ZEND_ARG_INFO(0, npriorities)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_set, 0, 0, 3)
+	ZEND_ARG_INFO(0, fd)
+	ZEND_ARG_INFO(0, events)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_set_timer, 0, 0, 1)
+	ZEND_ARG_INFO(0, callback)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_set_base, 0, 0, 1)
+	ZEND_ARG_OBJ_INFO(0, base, EventBase, 0)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_set_priority, 0, 0, 1)
+	ZEND_ARG_INFO(0, priority)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_event_object_add, 0, 0, 0)
+	ZEND_ARG_INFO(0, timeout)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_bufferevent_object_construct, 0, 0, 4)
+	ZEND_ARG_INFO(0, fd)
+	ZEND_ARG_INFO(0, readcb)
+	ZEND_ARG_INFO(0, writecb)
+	ZEND_ARG_INFO(0, errorcb)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_bufferevent_object_set_callback, 0, 0, 3)
+	ZEND_ARG_INFO(0, readcb)
+	ZEND_ARG_INFO(0, writecb)
+	ZEND_ARG_INFO(0, errorcb)
+	ZEND_ARG_INFO(0, arg)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_bufferevent_object_set_timeout, 0, 0, 2)
+	ZEND_ARG_INFO(0, read_timeout)
+	ZEND_ARG_INFO(0, write_timeout)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_bufferevent_object_set_watermark, 0, 0, 3)
+	ZEND_ARG_INFO(0, events)
+	ZEND_ARG_INFO(0, lowmark)
+	ZEND_ARG_INFO(0, highmark)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_bufferevent_object_events, 0, 0, 1)
+	ZEND_ARG_INFO(0, events)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_bufferevent_object_write, 0, 0, 1)
+	ZEND_ARG_INFO(0, data)
+	ZEND_ARG_INFO(0, data_size)
+ZEND_END_ARG_INFO()
+
+EVENT_ARGINFO
+ZEND_BEGIN_ARG_INFO_EX(arginfo_bufferevent_object_read, 0, 0, 1)
+	ZEND_ARG_INFO(0, data_size)
+ZEND_END_ARG_INFO()
+
+static
+#if ZEND_MODULE_API_NO >= 20071006
+const 
+#endif
+zend_function_entry php_event_base_methods[] = {
+	PHP_ME(EventBase, __construct, 		arginfo_event_object_void, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+	PHP_ME_MAPPING(loop, event_base_loop, arginfo_event_object_loop, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(loopbreak, event_base_loopbreak, arginfo_event_object_void, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(loopexit, event_base_loopexit, arginfo_event_object_loopexit, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(priorityInit, event_base_priority_init, arginfo_event_object_priority_init, ZEND_ACC_PUBLIC)
+	{NULL, NULL, NULL}
+};
+
+static
+#if ZEND_MODULE_API_NO >= 20071006
+const 
+#endif
+zend_function_entry php_event_methods[] = {
+	PHP_ME(Event, __construct, 			arginfo_event_object_void, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+	PHP_ME_MAPPING(set, event_set, arginfo_event_object_set, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(setTimer, event_timer_set, arginfo_event_object_set_timer, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(setBase, event_base_set, arginfo_event_object_set_base, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(setPriority, event_priority_set, arginfo_event_object_set_priority, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(add, event_add, arginfo_event_object_add, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(del, event_del, arginfo_event_object_void, ZEND_ACC_PUBLIC)
 	{NULL, NULL, NULL}
 };
+
+static
+#if ZEND_MODULE_API_NO >= 20071006
+const 
+#endif
+zend_function_entry php_bufferevent_methods[] = {
+	PHP_ME(BufferEvent, __construct, 	arginfo_bufferevent_object_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+	PHP_ME_MAPPING(setBase, event_buffer_base_set, arginfo_event_object_set_base, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(setCallback, event_buffer_set_callback, arginfo_bufferevent_object_set_callback, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(setTimeout, event_buffer_timeout_set, arginfo_bufferevent_object_set_timeout, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(setWatermark, event_buffer_watermark_set, arginfo_bufferevent_object_set_watermark, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(setPriority, event_buffer_priority_set, arginfo_event_object_set_priority, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(enable, event_buffer_enable, arginfo_bufferevent_object_events, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(disable, event_buffer_disable, arginfo_bufferevent_object_events, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(write, event_buffer_write, arginfo_bufferevent_object_write, ZEND_ACC_PUBLIC)
+	PHP_ME_MAPPING(read, event_buffer_read, arginfo_bufferevent_object_read, ZEND_ACC_PUBLIC)
+	{NULL, NULL, NULL}
+};
+/* }}} */
+
+static void _php_event_register_classes(TSRMLS_D) /* {{{ */
+{
+	zend_class_entry ce;
+
+	/* libevent structs cannot be copied, so none of the objects can be cloned */
+	memcpy(&php_event_base_object_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+	php_event_base_object_handlers.clone_obj = NULL;
+	memcpy(&php_event_object_handlers, &php_event_base_object_handlers, sizeof(zend_object_handlers));
+	memcpy(&php_bufferevent_object_handlers, &php_event_base_object_handlers, sizeof(zend_object_handlers));
+
+	INIT_CLASS_ENTRY(ce, "EventBase", php_event_base_methods);
+	ce.create_object = _php_event_base_object_new;
+	php_event_base_ce = zend_register_internal_class(&ce TSRMLS_CC);
+
+	INIT_CLASS_ENTRY(ce, "Event", php_event_methods);
+	ce.create_object = _php_event_object_new;
+	php_event_ce = zend_register_internal_class(&ce TSRMLS_CC);
+
+	INIT_CLASS_ENTRY(ce, "BufferEvent", php_bufferevent_methods);
+	ce.create_object = _php_bufferevent_object_new;
+	php_bufferevent_ce = zend_register_internal_class(&ce TSRMLS_CC);
+}
 /* }}} */
 #else
 /* {{{ libevent_functions[]
@@ -1679,12 +9648,16 @@ zend_module_entry libevent_module_entry = {
 	"libevent",
 	libevent_functions,
 	PHP_MINIT(libevent),
-	NULL,
+	PHP_MSHUTDOWN(libevent),
 	NULL,
 	NULL,
 	PHP_MINFO(libevent),
 	PHP_LIBEVENT_VERSION,
-	STANDARD_MODULE_PROPERTIES
+	PHP_MODULE_GLOBALS(libevent),
+	PHP_GINIT(libevent),
+	PHP_GSHUTDOWN(libevent),
+	NULL,
+	STANDARD_MODULE_PROPERTIES_EX
 };
 /* }}} */
 
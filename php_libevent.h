@@ -31,6 +31,23 @@ extern zend_module_entry libevent_module_entry;
 #include "TSRM.h"
 #endif
 
+ZEND_BEGIN_MODULE_GLOBALS(libevent)
+	void *event_slabs;
+	void *event_free;
+	char *event_cursor;
+	int event_cursor_left;
+	long event_pool_hits;
+	long event_pool_misses;
+	long event_pool_used;
+	long event_pool_slabs;
+ZEND_END_MODULE_GLOBALS(libevent)
+
+#ifdef ZTS
+# define LIBEVENT_G(v) TSRMG(libevent_globals_id, zend_libevent_globals *, v)
+#else
+# define LIBEVENT_G(v) (libevent_globals.v)
+#endif
+
 #ifndef zend_always_inline
 # if defined(__GNUC__)
 #  define zend_always_inline inline __attribute__((always_inline))
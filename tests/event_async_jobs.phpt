@@ -0,0 +1,82 @@
+--TEST--
+event_async_*() deliver results on the loop and jobs inherited by fork() are cancelled
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_async_read_file")) print "skip not supported on this platform";
+else if (!function_exists("pcntl_fork") || !function_exists("posix_mkfifo")) print "skip pcntl and posix extensions required";
+?>
+--FILE--
+<?php
+$base = event_base_new();
+$path = tempnam(sys_get_temp_dir(), "async");
+file_put_contents($path, "0123456789");
+
+/* jobs finish in any order on the workers */
+$results = array();
+$report = function ($result, $errno, $arg) use (&$results) {
+	$results[$arg] = json_encode($result) . " " . ($errno ? posix_strerror($errno) : 0);
+};
+
+var_dump(event_async_read_file($base, $path, $report, "read", 2, 5));
+var_dump(event_async_read_file($base, "$path.missing", $report, "missing"));
+$fp = fopen($path, "a");
+fwrite($fp, "abc");
+var_dump(event_async_fsync($base, $fp, $report, "fsync"));
+var_dump(event_async_getaddrinfo($base, "127.0.0.1", $report, "getaddrinfo", AF_INET));
+event_base_loop($base);
+ksort($results);
+print_r($results);
+
+$stats = event_async_stats($base, true);
+var_dump($stats["submitted"], $stats["completed"], $stats["pending"], $stats["threads"] > 0);
+fclose($fp);
+unlink($path);
+
+/* a worker blocks opening the fifo until we write to it */
+$fifo = $path . ".fifo";
+posix_mkfifo($fifo, 0600);
+var_dump(event_async_read_file($base, $fifo, function ($result, $errno, $arg) {
+	echo "$arg: ", json_encode($result), " ", ($errno ? posix_strerror($errno) : 0), "\n";
+}, "fifo"));
+usleep(50000);
+
+$pid = pcntl_fork();
+if ($pid == 0) {
+	/* nothing would ever finish the job in the child */
+	event_base_reinit($base);
+	event_base_loop($base);
+	$stats = event_async_stats($base);
+	echo "child: completed ", $stats["completed"], " pending ", $stats["pending"], "\n";
+	exit(0);
+}
+pcntl_waitpid($pid, $status);
+
+$fp = fopen($fifo, "w");
+fclose($fp);
+event_base_loop($base);
+$stats = event_async_stats($base);
+echo "parent: completed ", $stats["completed"], " pending ", $stats["pending"], "\n";
+unlink($fifo);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+Array
+(
+    [fsync] => true 0
+    [getaddrinfo] => ["127.0.0.1"] 0
+    [missing] => false No such file or directory
+    [read] => "23456" 0
+)
+int(4)
+int(4)
+int(0)
+bool(true)
+bool(true)
+fifo: false Operation canceled
+child: completed 1 pending 0
+fifo: "" 0
+parent: completed 1 pending 0
@@ -0,0 +1,61 @@
+--TEST--
+event_base_set_batch_callback() delivers the events of a loop iteration in one call
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_base_set_batch_callback")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+function per_event($fd, $events, $arg)
+{
+	fread($fd, 1);
+	echo "per event $arg\n";
+}
+
+$base = event_base_new();
+$pairs = $events = array();
+for ($i = 0; $i < 3; $i++) {
+	$pairs[$i] = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	fwrite($pairs[$i][0], "x");
+
+	$events[$i] = event_new();
+	event_set($events[$i], $pairs[$i][1], EV_READ | EV_PERSIST, "per_event", "arg$i");
+	event_base_set($events[$i], $base);
+	event_add($events[$i]);
+}
+
+var_dump(event_base_set_batch_callback($base, function ($batch) use ($events, $pairs) {
+	echo "batch of ", count($batch), "\n";
+	$seen = array();
+	foreach ($batch as $entry) {
+		list($event, $fd, $what, $arg) = $entry;
+		$i = (int)substr($arg, 3);
+		fread($fd, 1);
+		$seen[] = sprintf("%s %s %s", $arg, $event === $events[$i] ? "event" : "other event",
+			$fd === $pairs[$i][1] ? ($what == EV_READ ? "read" : $what) : "other fd");
+	}
+	sort($seen);
+	echo implode("\n", $seen), "\n";
+}));
+
+event_base_loop($base, EVLOOP_ONCE);
+
+/* back to one call per event */
+var_dump(event_base_set_batch_callback($base, NULL));
+fwrite($pairs[1][0], "x");
+event_base_loop($base, EVLOOP_ONCE);
+
+var_dump(event_base_set_batch_callback($base, "no_such_function"));
+?>
+--EXPECTF--
+bool(true)
+batch of 3
+arg0 event read
+arg1 event read
+arg2 event read
+bool(true)
+per event arg1
+
+Warning: event_base_set_batch_callback(): 'no_such_function' is not a valid callback in %s on line %d
+bool(false)
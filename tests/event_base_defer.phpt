@@ -0,0 +1,61 @@
+--TEST--
+event_base_defer() runs tasks after the current callback within a per-iteration budget
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+/* outside of a callback, tasks run in order on the next loop iteration */
+$base = event_base_new();
+var_dump(event_base_defer($base, function ($arg) { echo "deferred $arg\n"; }, 1));
+var_dump(event_base_defer($base, function ($arg) { echo "deferred $arg\n"; }, 2));
+echo "before loop\n";
+event_base_loop($base);
+
+/* both streams are readable in the first iteration, whose budget is shared
+   by the drains after either callback: two tasks now, two after the next poll */
+$base = event_base_new();
+var_dump(event_base_set_defer_budget($base, 2));
+var_dump(@event_base_set_defer_budget($base, 0));
+
+$log = array();
+$task = function ($arg) use ($base, &$log) {
+	$stats = event_base_stats($base);
+	$log[] = "task@" . $stats["iterations"];
+};
+$callback = function ($fd, $events, $arg) use ($base, $task, &$log) {
+	$stats = event_base_stats($base);
+	$log[] = "callback@" . $stats["iterations"];
+	event_base_defer($base, $task);
+	event_base_defer($base, $task);
+};
+
+foreach (array(0, 1) as $i) {
+	list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	fwrite($a, "x");
+	$pairs[] = array($a, $b);
+	event_base_once($base, $b, EV_READ, -1, $callback);
+}
+
+event_base_loop($base);
+echo implode("\n", $log), "\n";
+
+$stats = event_base_stats($base);
+var_dump($stats["deferred"], $stats["defer_queue"], $stats["defer_queue_max"]);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+before loop
+deferred 1
+deferred 2
+bool(true)
+bool(false)
+callback@0
+task@0
+task@0
+callback@0
+task@1
+task@1
+int(4)
+int(0)
+int(2)
@@ -0,0 +1,58 @@
+--TEST--
+event_base_once() calls back once on readiness or timeout
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+class Released
+{
+	public function __destruct()
+	{
+		echo "released\n";
+	}
+}
+
+$base = event_base_new();
+list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+list($c, $d) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+
+$report = function ($fd, $events, $arg) use ($b, $d) {
+	if ($fd === $b || $fd === $d) {
+		$what = "stream";
+	} else {
+		$what = var_export($fd, true);
+	}
+	printf("%s: %s %s\n", $arg, $what, $events == EV_TIMEOUT ? "timeout" : ($events == EV_READ ? "read" : $events));
+};
+
+fwrite($a, "x");
+
+/* readable at once, no timeout */
+var_dump(event_base_once($base, $b, EV_READ, -1, $report, "ready"));
+/* a plain timer */
+var_dump(event_base_once($base, -1, EV_TIMEOUT, 20000, $report, "timer"));
+/* nothing is written to $c, so the wait times out */
+var_dump(event_base_once($base, $d, EV_READ, 40000, $report, "idle"));
+
+event_base_loop($base);
+
+/* the records are reused, and nothing is left to keep the loop running */
+var_dump(event_base_once($base, $b, EV_READ, 10000, $report, "again"));
+event_base_loop($base);
+
+/* pending callbacks don't keep the base alive, they go with it */
+var_dump(event_base_once($base, -1, EV_TIMEOUT, 60000000, $report, new Released));
+event_base_free($base);
+echo "done\n";
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+ready: stream read
+timer: NULL timeout
+idle: stream timeout
+again: stream read
+bool(true)
+released
+done
@@ -0,0 +1,46 @@
+--TEST--
+event_base_stats() counts callbacks and the time spent in them
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+$base = event_base_new();
+
+$event = event_new();
+event_timer_set($event, function ($fd, $events, $event) {
+	static $runs = 0;
+
+	if (++$runs == 2) {
+		usleep(20000);
+	}
+	if ($runs < 3) {
+		event_add($event, 1000);
+	}
+}, $event);
+event_base_set($event, $base);
+event_add($event, 1000);
+event_base_loop($base);
+
+$stats = event_base_stats($base, true);
+var_dump($stats["callbacks"]["event"], $stats["callbacks"]["read"]);
+var_dump($stats["callback_time"] >= 0.02, $stats["callback_time_max"] >= 0.02, $stats["callback_time_max"] <= $stats["callback_time"]);
+var_dump($stats["backend_time"] >= 0, $stats["iterations"] >= 0);
+/* the fd and events zvals of the first callback are reused by the others */
+var_dump($stats["args_allocated"]);
+
+/* the counters start over after a reset */
+$stats = event_base_stats($base);
+var_dump($stats["callbacks"]["event"], $stats["callback_time"], $stats["args_allocated"]);
+?>
+--EXPECT--
+int(3)
+int(0)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+int(2)
+int(0)
+float(0)
+int(0)
@@ -0,0 +1,73 @@
+--TEST--
+event_buffer_add_file() queues file segments that drain before the write callback
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_buffer_add_file")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+$base = event_base_new();
+list($local, $remote) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+stream_set_blocking($remote, 0);
+
+/* far more than the socket buffers hold at once */
+$path = tempnam(sys_get_temp_dir(), "evf");
+$contents = str_repeat("0123456789abcdef", 1 << 16);
+file_put_contents($path, $contents);
+$file = fopen($path, "r");
+
+$received = "";
+$bevent = event_buffer_new($local, NULL, function ($bevent, $arg) {
+	echo "drained\n";
+}, function ($bevent, $what, $arg) {
+	echo "error $what\n";
+});
+event_buffer_base_set($bevent, $base);
+
+var_dump(event_buffer_add_file($bevent, $file, 0, 10));
+var_dump(event_buffer_write($bevent, "|"));
+var_dump(event_buffer_add_file($bevent, $file, 16));
+var_dump(event_buffer_add_file($bevent, $file, strlen($contents)));
+
+/* the output holds its own descriptor */
+fclose($file);
+
+$reader = event_new();
+event_set($reader, $remote, EV_READ | EV_PERSIST, function ($fd) use ($base, $contents, &$received) {
+	$received .= fread($fd, 65536);
+	if (strlen($received) == 11 + strlen($contents) - 16) {
+		event_base_loopexit($base);
+	}
+});
+event_base_set($reader, $base);
+event_add($reader);
+event_base_loop($base);
+
+var_dump($received === "0123456789|" . substr($contents, 16));
+
+$file = fopen($path, "r");
+var_dump(event_buffer_add_file($bevent, $file, -1));
+var_dump(event_buffer_add_file($bevent, $file, 10, strlen($contents)));
+var_dump(event_buffer_add_file($bevent, $file, strlen($contents) + 1, 0));
+fclose($file);
+unlink($path);
+echo "done\n";
+?>
+--EXPECTF--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+drained
+bool(true)
+
+Warning: event_buffer_add_file(): offset cannot be less than zero in %s on line %d
+bool(false)
+
+Warning: event_buffer_add_file(): segment exceeds the end of the file in %s on line %d
+bool(false)
+
+Warning: event_buffer_add_file(): segment exceeds the end of the file in %s on line %d
+bool(false)
+done
@@ -0,0 +1,92 @@
+--TEST--
+event_buffer_pipe() pauses reading while the peer is backed up and resumes once it drained
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_buffer_pipe")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+$base = event_base_new();
+list($a1, $a2) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+list($b1, $b2) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+foreach (array($a1, $a2, $b1, $b2) as $stream) {
+	stream_set_blocking($stream, 0);
+}
+
+$error = function ($bevent, $what, $arg) {
+	echo "error $what\n";
+};
+$a = event_buffer_new($a2, NULL, NULL, $error);
+$b = event_buffer_new($b2, NULL, NULL, $error);
+event_buffer_base_set($a, $base);
+event_buffer_base_set($b, $base);
+event_buffer_watermark_set($b, EV_WRITE, 100, 0);
+
+$pipe = event_buffer_pipe($a, $b, function ($pipe, $bevent, $what, $arg) {
+	echo "pipe callback $what\n";
+}, NULL, 65536, 16384);
+
+/* far more than the socket buffers and the high watermark hold */
+$payload = str_repeat("0123456789abcdef", 1 << 17);
+$written = 0;
+$received = "";
+$paused = false;
+
+$writer = event_new();
+event_set($writer, $a1, EV_WRITE | EV_PERSIST, function ($fd) use ($payload, &$written, &$writer) {
+	$written += (int)fwrite($fd, substr($payload, $written, 65536));
+	if ($written == strlen($payload)) {
+		event_del($writer);
+	}
+});
+event_base_set($writer, $base);
+event_add($writer);
+
+$reader = event_new();
+event_set($reader, $b1, EV_READ | EV_PERSIST, function ($fd) use ($base, $payload, &$received) {
+	$received .= fread($fd, 65536);
+	if (strlen($received) == strlen($payload)) {
+		event_base_loopexit($base);
+	}
+});
+event_base_set($reader, $base);
+
+/* the sink is only read once the pipe has stopped reading from a */
+$check = event_new();
+event_timer_set($check, function () use ($pipe, $reader, &$check, &$paused) {
+	$stats = event_buffer_pipe_stats($pipe);
+	if ($stats["a_paused"]) {
+		$paused = true;
+		event_add($reader);
+		return;
+	}
+	event_add($check, 10000);
+});
+event_base_set($check, $base);
+event_add($check, 10000);
+
+$timeout = event_new();
+event_timer_set($timeout, function () use ($base) {
+	echo "timed out\n";
+	event_base_loopexit($base);
+});
+event_base_set($timeout, $base);
+event_add($timeout, 10000000);
+
+event_base_loop($base);
+
+$stats = event_buffer_pipe_stats($pipe);
+var_dump($paused, $received === $payload);
+var_dump($stats["a_to_b"] == strlen($payload), $stats["pauses"] > 0, $stats["a_paused"]);
+
+event_buffer_pipe_free($pipe);
+echo "done\n";
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+done
@@ -0,0 +1,81 @@
+--TEST--
+event_buffer_set_rate_limit() and rate limit groups keep throughput at the configured rate
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_buffer_set_rate_limit")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+define("RATE", 200000);
+define("BURST", 20000);
+define("TOTAL", 200000);
+
+function transfer($base, array $readers, $limit)
+{
+	$pending = count($readers);
+	$got = 0;
+	$seen = array();
+	$bevents = array();
+
+	foreach ($readers as $i => $bytes) {
+		list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+		stream_set_blocking($a, 0);
+		stream_set_blocking($b, 0);
+
+		$writer = event_buffer_new($a, null, null, function () {});
+		event_buffer_base_set($writer, $base);
+		event_buffer_write($writer, str_repeat("x", $bytes));
+
+		$reader = event_buffer_new($b, function ($bevent) use ($base, $bytes, &$got, &$seen, &$pending) {
+			$id = (int)$bevent;
+			while (($data = event_buffer_read($bevent, 65536)) != "") {
+				$got += strlen($data);
+				$seen[$id] = (isset($seen[$id]) ? $seen[$id] : 0) + strlen($data);
+			}
+			if ($seen[$id] >= $bytes && --$pending == 0) {
+				event_base_loopexit($base);
+			}
+		}, null, function () {});
+		event_buffer_base_set($reader, $base);
+		$limit($reader);
+		event_buffer_enable($reader, EV_READ);
+
+		$bevents[] = array($writer, $reader, $a, $b);
+	}
+
+	$start = microtime(true);
+	event_base_loop($base);
+	$elapsed = microtime(true) - $start;
+
+	/* the first burst is available at once, the rest comes in at the rate */
+	$rate = ($got - BURST) / $elapsed;
+	if ($got == TOTAL && abs($rate - RATE) < RATE * 0.2) {
+		echo "ok\n";
+	} else {
+		printf("got %d bytes in %.3fs, %d bytes/s\n", $got, $elapsed, $rate);
+	}
+}
+
+$base = event_base_new();
+
+transfer($base, array(TOTAL), function ($reader) {
+	var_dump(event_buffer_set_rate_limit($reader, RATE, BURST, 0, 0));
+});
+
+/* two members share the rate of their group */
+$group = event_rate_limit_group_new($base, RATE, BURST, 0, 0);
+transfer($base, array(TOTAL / 2, TOTAL / 2), function ($reader) use ($group) {
+	var_dump(event_buffer_set_rate_limit_group($reader, $group));
+});
+
+$stats = event_rate_limit_group_stats($group);
+var_dump($stats["read"]);
+?>
+--EXPECT--
+bool(true)
+ok
+bool(true)
+bool(true)
+ok
+int(200000)
@@ -0,0 +1,59 @@
+--TEST--
+event_buffer_write_array() sends the parts in order and keeps queued strings intact
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_buffer_write_array")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+$base = event_base_new();
+list($local, $remote) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+stream_set_blocking($remote, 0);
+
+$bevent = event_buffer_new($local, NULL, function ($bevent, $arg) use ($base) {
+	event_base_loopexit($base);
+}, function ($bevent, $what, $arg) {
+	echo "error $what\n";
+});
+event_buffer_base_set($bevent, $base);
+
+/* large parts are queued by reference, small ones and non-strings are copied */
+$big = str_repeat("b", 300000);
+$ref = str_repeat("r", 2048);
+$parts = array("head:", $big, 42, ":", &$ref, ":tail");
+var_dump(event_buffer_write_array($bevent, $parts));
+var_dump(event_buffer_write_array($bevent, array()));
+
+/* changing the strings afterwards must not change what goes out */
+$big[0] = "X";
+$ref[0] = "X";
+unset($parts);
+
+$received = "";
+$reader = event_new();
+event_set($reader, $remote, EV_READ | EV_PERSIST, function ($fd) use (&$received) {
+	$received .= fread($fd, 65536);
+});
+event_base_set($reader, $base);
+event_add($reader);
+event_base_loop($base);
+
+/* whatever the socket did not take yet is still on the way */
+stream_set_blocking($remote, 1);
+$expected = "head:" . str_repeat("b", 300000) . "42:" . str_repeat("r", 2048) . ":tail";
+while (strlen($received) < strlen($expected)) {
+	$received .= fread($remote, 65536);
+}
+var_dump($received === $expected);
+
+/* queued parts are released with the bufferevent */
+var_dump(event_buffer_write_array($bevent, array(str_repeat("x", 1 << 20))));
+event_buffer_free($bevent);
+echo "done\n";
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+done
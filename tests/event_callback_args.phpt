@@ -0,0 +1,46 @@
+--TEST--
+Callback arguments kept by the callee are not reused by later callbacks
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+$base = event_base_new();
+$kept = array();
+$streams = array();
+
+foreach (array("one", "two", "three") as $name) {
+	list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	fwrite($a, $name);
+
+	$event = event_new();
+	event_set($event, $b, EV_READ | EV_PERSIST, function ($fd, $events, $arg) use (&$kept) {
+		$kept[$arg[0]] = array($fd, $events, $arg);
+		fread($fd, 16);
+		event_del($arg[1]);
+	}, array($name, $event));
+	event_base_set($event, $base);
+	event_add($event);
+
+	$streams[$name] = array($a, $b);
+}
+
+$timer = event_new();
+event_timer_set($timer, function ($fd, $events, $arg) use (&$kept) {
+	$kept["timer"] = array($fd, $events, array($arg));
+}, "timer");
+event_base_set($timer, $base);
+event_add($timer, 10000);
+
+event_base_loop($base);
+
+ksort($kept);
+foreach ($kept as $name => $args) {
+	list($fd, $events, $arg) = $args;
+	printf("%s: %s %d %s\n", $name, is_resource($fd) ? ($fd === $streams[$name][1] ? "stream" : "other stream") : var_export($fd, true), $events, $arg[0]);
+}
+?>
+--EXPECT--
+one: stream 2 one
+three: stream 2 three
+timer: NULL 1 timer
+two: stream 2 two
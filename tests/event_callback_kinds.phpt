@@ -0,0 +1,95 @@
+--TEST--
+Callbacks of every kind are resolved once and keep working across dispatches
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+function plain($fd, $events, $arg)
+{
+	echo "function $arg\n";
+}
+
+class Handler
+{
+	public static function stat($fd, $events, $arg)
+	{
+		echo "static $arg\n";
+	}
+
+	public function method($fd, $events, $arg)
+	{
+		echo "method $arg\n";
+	}
+
+	public function __invoke($fd, $events, $arg)
+	{
+		echo "invoke $arg\n";
+	}
+
+	public function __call($name, $args)
+	{
+		echo "__call $name {$args[2]}\n";
+	}
+}
+
+$base = event_base_new();
+$handler = new Handler;
+$callbacks = array(
+	"plain",
+	"Handler::stat",
+	array("Handler", "stat"),
+	array($handler, "method"),
+	$handler,
+	array($handler, "missing"),
+	function ($fd, $events, $arg) {
+		echo "closure $arg\n";
+	},
+);
+
+/* every callback fires twice, __call() trampolines are looked up again each time */
+foreach ($callbacks as $i => $callback) {
+	$event = event_new();
+	event_timer_set($event, $callback, 1);
+	event_base_set($event, $base);
+	event_add($event, 1000 * ($i + 1));
+	event_base_loop($base);
+	event_timer_set($event, $callback, 2);
+	event_add($event, 1000);
+	event_base_loop($base);
+	event_free($event);
+}
+
+/* a callback replacing itself keeps running to its end */
+$event = event_new();
+event_timer_set($event, function ($fd, $events, $event) {
+	event_timer_set($event, "plain", "replaced");
+	echo "replacing done\n";
+}, $event);
+event_base_set($event, $base);
+event_add($event, 1000);
+event_base_loop($base);
+event_add($event, 1000);
+event_base_loop($base);
+
+var_dump(event_timer_set($event, "missing_function"));
+?>
+--EXPECTF--
+function 1
+function 2
+static 1
+static 2
+static 1
+static 2
+method 1
+method 2
+invoke 1
+invoke 2
+__call missing 1
+__call missing 2
+closure 1
+closure 2
+replacing done
+function replaced
+
+Warning: event_timer_set(): 'missing_function' is not a valid callback in %s on line %d
+bool(false)
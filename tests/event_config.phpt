@@ -0,0 +1,44 @@
+--TEST--
+event_config_*() choose the backend of a base
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_config_new")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+$config = event_config_new();
+var_dump(event_config_avoid_method($config, "select"));
+$base = event_base_new_with_config($config);
+var_dump(is_resource($base), event_base_get_method($base) != "select");
+event_config_free($config);
+
+/* a backend able to watch any fd, such as files */
+$config = event_config_new();
+var_dump(event_config_require_features($config, EV_FEATURE_FDS));
+$base = event_base_new_with_config($config);
+var_dump((event_base_get_features($base) & EV_FEATURE_FDS) != 0);
+$method = event_base_get_method($base);
+
+/* nothing is left once those are avoided as well */
+var_dump(event_config_avoid_method($config, $method));
+foreach (array("select", "poll", "win32") as $fallback) {
+	event_config_avoid_method($config, $fallback);
+}
+var_dump(event_base_new_with_config($config));
+event_config_free($config);
+
+/* phpinfo() names the default backend */
+ob_start();
+phpinfo(INFO_MODULES);
+var_dump((bool)preg_match("/default backend( => |<\/td><td class=\"v\">)\w+/", ob_get_clean()));
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(false)
+bool(true)
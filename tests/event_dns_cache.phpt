@@ -0,0 +1,158 @@
+--TEST--
+event_dns_resolve() caches answers for their TTL and coalesces concurrent lookups
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_dns_base_new")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+/* a stub nameserver answering A and PTR queries from a table, on the same loop */
+$zone = array(
+	"a.test" => array("127.0.0.2", 300),
+	"b.test" => array("127.0.0.3", 1),
+	"2.0.0.127.in-addr.arpa" => array("a.test", 300),
+);
+$queries = array();
+
+$server = stream_socket_server("udp://127.0.0.1:0", $errno, $errstr, STREAM_SERVER_BIND);
+$address = stream_socket_get_name($server, false);
+
+$base = event_base_new();
+
+$stub = event_new();
+event_set($stub, $server, EV_READ | EV_PERSIST, function ($fd, $events) use ($zone, &$queries) {
+	$packet = stream_socket_recvfrom($fd, 512, 0, $peer);
+
+	$labels = array();
+	for ($pos = 12; ($len = ord($packet[$pos])) > 0; $pos += $len + 1) {
+		$labels[] = substr($packet, $pos + 1, $len);
+	}
+	$question = substr($packet, 12, $pos + 5 - 12);
+	$qtype = ord($packet[$pos + 2]);
+
+	/* the resolver may randomize the case of the name */
+	$name = strtolower(implode(".", $labels));
+	$queries[$name] = isset($queries[$name]) ? $queries[$name] + 1 : 1;
+
+	if (!isset($zone[$name])) {
+		$reply = substr($packet, 0, 2) . "\x81\x83\x00\x01\x00\x00\x00\x00\x00\x00" . $question;
+	} else {
+		list($data, $ttl) = $zone[$name];
+		if ($qtype == 12) {
+			$rdata = "";
+			foreach (explode(".", $data) as $label) {
+				$rdata .= chr(strlen($label)) . $label;
+			}
+			$rdata .= "\x00";
+		} else {
+			$rdata = inet_pton($data);
+		}
+		$reply = substr($packet, 0, 2) . "\x81\x80\x00\x01\x00\x01\x00\x00\x00\x00" . $question
+			. "\xc0\x0c\x00" . chr($qtype) . "\x00\x01" . pack("N", $ttl) . pack("n", strlen($rdata)) . $rdata;
+	}
+	stream_socket_sendto($fd, $reply, 0, $peer);
+});
+event_base_set($stub, $base);
+event_add($stub);
+
+$conf = tempnam(sys_get_temp_dir(), "resolv");
+file_put_contents($conf, "nameserver $address\n");
+
+$dns = event_dns_base_new($base, $conf, 16);
+unlink($conf);
+
+$answers = array();
+$record = function ($result, $error, $ttl, $tag) use (&$answers) {
+	$answers[] = array($tag, $result, $error, $ttl);
+};
+
+/* two lookups of one name share a single query */
+var_dump(event_dns_resolve($dns, "a.test", EVENT_DNS_IPv4_A, $record, "a1", EVENT_DNS_QUERY_NO_SEARCH));
+var_dump(event_dns_resolve($dns, "A.test", EVENT_DNS_IPv4_A, $record, "a2", EVENT_DNS_QUERY_NO_SEARCH));
+var_dump(event_dns_resolve($dns, "b.test", EVENT_DNS_IPv4_A, $record, "b1", EVENT_DNS_QUERY_NO_SEARCH));
+var_dump(event_dns_resolve($dns, "missing.test", EVENT_DNS_IPv4_A, $record, "m1", EVENT_DNS_QUERY_NO_SEARCH));
+var_dump(event_dns_resolve($dns, "127.0.0.2", EVENT_DNS_PTR, $record, "p1", EVENT_DNS_QUERY_NO_SEARCH));
+
+$timeout = event_new();
+event_timer_set($timeout, function () use ($base) {
+	echo "timed out\n";
+	event_base_loopexit($base);
+});
+event_base_set($timeout, $base);
+event_add($timeout, 5000000);
+
+$step = event_new();
+event_timer_set($step, function () use ($base, $dns, $record, &$answers, $step) {
+	static $round = 0;
+
+	if (count($answers) < 5) {
+		event_add($step, 10000);
+		return;
+	}
+
+	switch ($round++) {
+		case 0:
+			/* answered from the cache, failures are not cached */
+			event_dns_resolve($dns, "a.test", EVENT_DNS_IPv4_A, $record, "a3", EVENT_DNS_QUERY_NO_SEARCH);
+			event_dns_resolve($dns, "missing.test", EVENT_DNS_IPv4_A, $record, "m2", EVENT_DNS_QUERY_NO_SEARCH);
+			/* other flags make another query */
+			event_dns_resolve($dns, "a.test", EVENT_DNS_IPv4_A, $record, "a4", 0);
+			/* wait for b.test to expire */
+			event_add($step, 1200000);
+			break;
+		case 1:
+			event_dns_resolve($dns, "b.test", EVENT_DNS_IPv4_A, $record, "b2", EVENT_DNS_QUERY_NO_SEARCH);
+			event_add($step, 10000);
+			break;
+		default:
+			if (count($answers) < 9) {
+				event_add($step, 10000);
+				return;
+			}
+			event_base_loopexit($base);
+	}
+});
+event_base_set($step, $base);
+event_add($step, 10000);
+
+event_base_loop($base);
+
+usort($answers, function ($x, $y) { return strcmp($x[0], $y[0]); });
+foreach ($answers as $answer) {
+	list($tag, $result, $error, $ttl) = $answer;
+	printf("%s %s %d %s\n", $tag, $result ? implode(",", $result) : "false", $error, $ttl > 0 ? "ttl" : "no-ttl");
+}
+
+ksort($queries);
+var_dump($queries);
+
+$stats = event_dns_cache_stats($dns);
+printf("hits=%d misses=%d coalesced=%d expired=%d\n", $stats["hits"], $stats["misses"], $stats["coalesced"], $stats["expired"]);
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+a1 127.0.0.2 0 ttl
+a2 127.0.0.2 0 ttl
+a3 127.0.0.2 0 ttl
+a4 127.0.0.2 0 ttl
+b1 127.0.0.3 0 ttl
+b2 127.0.0.3 0 ttl
+m1 false 3 no-ttl
+m2 false 3 no-ttl
+p1 a.test 0 ttl
+array(4) {
+  ["2.0.0.127.in-addr.arpa"]=>
+  int(1)
+  ["a.test"]=>
+  int(2)
+  ["b.test"]=>
+  int(2)
+  ["missing.test"]=>
+  int(2)
+}
+hits=1 misses=7 coalesced=1 expired=1
@@ -0,0 +1,113 @@
+--TEST--
+event_http_new() parses requests, answers them now, later or chunked, and survives clients leaving early
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_http_accept")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+$base = event_base_new();
+$server = stream_socket_server("tcp://127.0.0.1:0", $errno, $errstr);
+$addr = stream_socket_get_name($server, false);
+
+$dropped = $timer = null;
+$http = event_http_new($base, function ($req, $arg) use ($base, &$dropped, &$timer) {
+	switch (event_http_request_get_uri($req)) {
+		case "/now?x=1":
+			$headers = event_http_request_get_headers($req);
+			event_http_request_add_header($req, "X-Arg", $arg);
+			event_http_send_reply($req, 200, event_http_request_get_method($req) . " " . $headers["X-Test"] . " " . event_http_request_get_body($req));
+			break;
+
+		case "/chunked":
+			event_http_send_reply_start($req, 200);
+			event_http_send_reply_chunk($req, "a");
+			event_http_send_reply_chunk($req, "bc");
+			event_http_send_reply_end($req);
+			break;
+
+		case "/later":
+			/* the handler keeps the request and answers from a timer */
+			$timer = event_new();
+			event_timer_set($timer, function ($fd, $events, $req) {
+				event_http_send_reply($req, 202, "later");
+			}, $req);
+			event_base_set($timer, $base);
+			event_add($timer, 10000);
+			break;
+
+		case "/drop":
+			$dropped = $req;
+			break;
+	}
+}, "arg");
+var_dump(event_http_accept($http, $server));
+var_dump(event_http_set_max_body_size($http, 64));
+
+function request($base, $addr, $raw)
+{
+	$fp = stream_socket_client("tcp://$addr");
+	stream_set_blocking($fp, 0);
+	fwrite($fp, $raw);
+
+	$response = "";
+	$deadline = microtime(true) + 5;
+	while (!feof($fp) && microtime(true) < $deadline) {
+		event_base_loop($base, EVLOOP_NONBLOCK);
+		$response .= fread($fp, 65536);
+		usleep(1000);
+	}
+	fclose($fp);
+
+	list($head, $body) = explode("\r\n\r\n", $response, 2);
+	$lines = explode("\r\n", $head);
+	$extra = preg_grep("/^(X-Arg|Transfer-Encoding):/i", $lines);
+	echo $lines[0], "\n", implode("\n", $extra), ($extra ? "\n" : ""), json_encode($body), "\n";
+}
+
+request($base, $addr, "POST /now?x=1 HTTP/1.1\r\nHost: test\r\nX-Test: yes\r\nConnection: close\r\nContent-Length: 4\r\n\r\nbody");
+request($base, $addr, "GET /chunked HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n");
+request($base, $addr, "GET /later HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n");
+request($base, $addr, "POST /now?x=1 HTTP/1.1\r\nHost: test\r\nConnection: close\r\nContent-Length: 100\r\n\r\n");
+
+/* the client goes away before the deferred answer */
+$fp = stream_socket_client("tcp://$addr");
+fwrite($fp, "GET /drop HTTP/1.1\r\nHost: test\r\n\r\n");
+while (!$dropped) {
+	event_base_loop($base, EVLOOP_ONCE);
+}
+fclose($fp);
+for ($i = 0; $i < 50; $i++) {
+	event_base_loop($base, EVLOOP_NONBLOCK);
+	usleep(1000);
+}
+var_dump(event_http_send_reply($dropped, 200, "too late"));
+$dropped = null;
+
+/* the server keeps serving */
+request($base, $addr, "GET /now?x=1 HTTP/1.1\r\nHost: test\r\nX-Test: again\r\nConnection: close\r\n\r\n");
+
+event_http_free($http);
+echo "done\n";
+?>
+--EXPECTF--
+bool(true)
+bool(true)
+HTTP/1.1 200 OK
+X-Arg: arg
+"POST yes body"
+HTTP/1.1 200 OK
+Transfer-Encoding: chunked
+"1\r\na\r\n2\r\nbc\r\n0\r\n\r\n"
+HTTP/1.1 202 Accepted
+"later"
+HTTP/1.1 413 %s
+%s
+
+Warning: event_http_send_reply(): the request has already been answered or its connection closed in %s on line %d
+bool(false)
+HTTP/1.1 200 OK
+X-Arg: arg
+"GET again "
+done
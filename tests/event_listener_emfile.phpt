@@ -0,0 +1,61 @@
+--TEST--
+event_listener_new() accepts in batches and is disabled on EMFILE until enabled again
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("posix_getrlimit")) print "skip posix extension not available";
+else {
+	$limits = posix_getrlimit();
+	if ($limits["soft openfiles"] === "unlimited" || $limits["soft openfiles"] > 65536) print "skip file descriptor limit too high";
+}
+?>
+--FILE--
+<?php
+$base = event_base_new();
+$server = stream_socket_server("tcp://127.0.0.1:0", $errno, $errstr);
+$addr = stream_socket_get_name($server, false);
+
+$listener = event_listener_new($base, $server, function ($listener, $conns, $arg, $errno) {
+	foreach ($conns as $conn) {
+		if (!is_resource($conn[0]) || strncmp($conn[1], "127.0.0.1:", 10) != 0) {
+			echo "bad connection\n";
+		}
+	}
+	printf("%s: %d connection(s), errno %s\n", $arg, count($conns), $errno ? "set" : "0");
+}, NULL, NULL, NULL, "accept", 16, 0);
+
+/* connections queued before the loop runs are handed out by one callback */
+$clients = array();
+for ($i = 0; $i < 3; $i++) {
+	$clients[] = stream_socket_client("tcp://$addr");
+}
+event_base_loop($base, EVLOOP_ONCE);
+
+/* run out of descriptors with a connection waiting in the backlog */
+$clients[] = stream_socket_client("tcp://$addr");
+$fillers = array();
+while ($fp = @fopen(__FILE__, "r")) {
+	$fillers[] = $fp;
+}
+event_base_loop($base, EVLOOP_ONCE);
+
+/* the listener stays off, so the readable backlog doesn't spin the loop */
+event_base_loop($base, EVLOOP_NONBLOCK);
+echo "disabled\n";
+
+$fillers = array();
+var_dump(event_listener_enable($listener));
+event_base_loop($base, EVLOOP_ONCE);
+
+event_listener_free($listener);
+echo "done\n";
+?>
+--EXPECTF--
+accept: 3 connection(s), errno 0
+
+Warning: event_base_loop(): accept() failed: %s in %s on line %d
+accept: 0 connection(s), errno set
+disabled
+bool(true)
+accept: 1 connection(s), errno 0
+done
@@ -0,0 +1,84 @@
+--TEST--
+event_add_many(), event_del_many() and event_priority_set_many() report a result per key
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+$base = event_base_new();
+var_dump(event_base_priority_init($base, 4));
+
+$fired = array();
+$events = array();
+foreach (array("a", "b") as $name) {
+	$events[$name] = event_new();
+	event_timer_set($events[$name], function ($fd, $what, $name) use (&$fired) {
+		$fired[] = $name;
+	}, $name);
+	event_base_set($events[$name], $base);
+}
+
+$unattached = event_new();
+event_timer_set($unattached, function () {});
+
+$list = array("a" => $events["a"], "none" => $unattached, 7 => $events["b"], "string" => "not an event");
+
+var_dump(event_priority_set_many($list, 1));
+var_dump(event_priority_set_many(array($events["a"]), 10));
+var_dump(event_add_many($list, 10000));
+var_dump(event_del_many(array("b" => $events["b"], "none" => $unattached)));
+
+/* Event objects are taken as well */
+$object = new Event();
+$object->setTimer(function () use (&$fired) {
+	$fired[] = "object";
+});
+$object->setBase($base);
+var_dump(event_add_many(array("object" => $object, "unset" => new Event()), 20000));
+
+event_base_loop($base);
+var_dump($fired);
+?>
+--EXPECT--
+bool(true)
+array(4) {
+  ["a"]=>
+  bool(true)
+  ["none"]=>
+  bool(false)
+  [7]=>
+  bool(true)
+  ["string"]=>
+  bool(false)
+}
+array(1) {
+  [0]=>
+  bool(false)
+}
+array(4) {
+  ["a"]=>
+  bool(true)
+  ["none"]=>
+  bool(false)
+  [7]=>
+  bool(true)
+  ["string"]=>
+  bool(false)
+}
+array(2) {
+  ["b"]=>
+  bool(true)
+  ["none"]=>
+  bool(false)
+}
+array(2) {
+  ["object"]=>
+  bool(true)
+  ["unset"]=>
+  bool(false)
+}
+array(2) {
+  [0]=>
+  string(1) "a"
+  [1]=>
+  string(6) "object"
+}
@@ -0,0 +1,86 @@
+--TEST--
+EventBase, Event and BufferEvent objects work with the methods and the functions alike
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+class LazyBase extends EventBase
+{
+	public function __construct()
+	{
+	}
+}
+
+$base = new EventBase();
+list($a, $b) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+list($c, $d) = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+
+/* the functions take the objects in place of the resources */
+$event = new Event();
+var_dump(event_set($event, $b, EV_READ, function ($fd, $events, $arg) use ($b) {
+	var_dump($fd === $b, $events == EV_READ, $arg, fread($fd, 16));
+}, "event"));
+var_dump(event_base_set($event, $base));
+var_dump($event->add());
+fwrite($a, "ping");
+var_dump($base->loop(EVLOOP_ONCE));
+
+/* callbacks are handed the object itself */
+$bevent = new BufferEvent($c, function ($bev, $arg) use (&$bevent) {
+	var_dump($bev === $bevent, $arg, $bev->read(16));
+}, NULL, function ($bev, $what, $arg) {
+	echo "error $what\n";
+}, "bevent");
+var_dump($bevent->setBase($base));
+var_dump(event_buffer_enable($bevent, EV_READ));
+fwrite($d, "pong");
+var_dump(event_base_loop($base, EVLOOP_ONCE));
+
+/* what is attached keeps the base alive */
+$timer = new Event();
+$timer->setTimer(function () {});
+$timer->setBase($base);
+unset($base);
+var_dump($timer->add(1000));
+var_dump($timer->del());
+unset($timer);
+
+var_dump(event_base_loop(new LazyBase()));
+
+try {
+	new BufferEvent($c, NULL, NULL, "no_such_function");
+} catch (Exception $e) {
+	echo "exception\n";
+}
+
+$base = new EventBase();
+try {
+	$base->__construct();
+} catch (Exception $e) {
+	echo $e->getMessage(), "\n";
+}
+echo "done\n";
+?>
+--EXPECTF--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+string(5) "event"
+string(4) "ping"
+int(0)
+bool(true)
+bool(true)
+bool(true)
+string(6) "bevent"
+string(4) "pong"
+int(0)
+bool(true)
+bool(true)
+
+Warning: event_base_loop(): LazyBase object has not been constructed in %s on line %d
+bool(false)
+exception
+EventBase has already been constructed
+done
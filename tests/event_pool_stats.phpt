@@ -0,0 +1,49 @@
+--TEST--
+event_new() reuses blocks of the event pool once events are freed
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+$before = event_pool_stats();
+
+$events = array();
+for ($i = 0; $i < 100; $i++) {
+	$events[] = event_new();
+}
+$full = event_pool_stats();
+var_dump($full["used"] - $before["used"]);
+
+foreach ($events as $event) {
+	event_free($event);
+}
+$events = array();
+$freed = event_pool_stats();
+var_dump($freed["used"] == $before["used"]);
+
+/* the freed blocks come back before any new one is carved out */
+for ($i = 0; $i < 100; $i++) {
+	$events[] = event_new();
+}
+$again = event_pool_stats();
+var_dump($again["hits"] - $freed["hits"], $again["misses"] == $freed["misses"], $again["slabs"] == $freed["slabs"]);
+
+/* events work the same out of a reused block */
+$base = event_base_new();
+event_timer_set($events[50], function ($fd, $what, $arg) {
+	echo "fired $arg\n";
+}, "reused");
+event_base_set($events[50], $base);
+event_add($events[50], 1000);
+event_base_loop($base);
+
+var_dump($again["block_size"] > 0, $again["slab_size"] > $again["block_size"]);
+?>
+--EXPECT--
+int(100)
+bool(true)
+int(100)
+bool(true)
+bool(true)
+fired reused
+bool(true)
+bool(true)
@@ -0,0 +1,65 @@
+--TEST--
+Profiling a callback that frees or resets its own event
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_base_profile_enable")) print "skip libevent 2.x only";
+?>
+--FILE--
+<?php
+function replaced($fd, $events, $arg)
+{
+	echo "replaced\n";
+}
+
+function resets($fd, $events, $event)
+{
+	echo "resets\n";
+	/* drops the last reference to this callable while it runs */
+	event_set($event, 0, EV_TIMEOUT, "replaced");
+}
+
+$base = event_base_new();
+$slow = array();
+var_dump(event_base_profile_enable($base, 0, function ($name, $fd, $duration, $rsrc_id) use (&$slow) {
+	$slow[] = $name;
+}));
+
+/* the usual one-shot pattern, the closure and its event are gone once it returns */
+$once = event_new();
+event_timer_set($once, function ($fd, $events, $arg) use (&$once) {
+	echo "once\n";
+	event_free($once);
+	$once = null;
+});
+event_base_set($once, $base);
+event_add($once, 1000);
+
+$reset = event_new();
+event_timer_set($reset, "resets", $reset);
+event_base_set($reset, $base);
+event_add($reset, 5000);
+
+event_base_loop($base);
+
+sort($slow);
+var_dump($slow);
+
+$histograms = event_base_get_histograms($base);
+ksort($histograms["callables"]);
+foreach ($histograms["callables"] as $name => $histogram) {
+	echo $name, " ", $histogram["count"], "\n";
+}
+?>
+--EXPECT--
+bool(true)
+once
+resets
+array(2) {
+  [0]=>
+  string(6) "resets"
+  [1]=>
+  string(9) "{closure}"
+}
+resets 1
+{closure} 1
@@ -0,0 +1,48 @@
+--TEST--
+event_read_drain() of plain and filtered streams
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("stream_socket_pair")) print "skip stream_socket_pair() not available";
+?>
+--FILE--
+<?php
+$pair = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+stream_set_blocking($pair[0], 0);
+
+/* more than one chunk at once, then nothing without blocking */
+fwrite($pair[1], str_repeat("x", 20000));
+var_dump(strlen(event_read_drain($pair[0], 1 << 20, $eof)), $eof);
+var_dump(event_read_drain($pair[0], 1 << 20, $eof), $eof);
+
+fwrite($pair[1], "abcdef");
+var_dump(event_read_drain($pair[0], 4), event_read_drain($pair[0]));
+
+/* bytes buffered by the stream layer come first */
+fwrite($pair[1], "line\nrest");
+usleep(10000);
+var_dump(fgets($pair[0]), event_read_drain($pair[0]));
+
+/* filters see the data before it is handed out */
+stream_filter_append($pair[0], "string.toupper", STREAM_FILTER_READ);
+fwrite($pair[1], "hello");
+usleep(10000);
+var_dump(event_read_drain($pair[0], 1 << 20, $eof), $eof);
+
+fclose($pair[1]);
+var_dump(event_read_drain($pair[0], 1 << 20, $eof), $eof);
+?>
+--EXPECT--
+int(20000)
+bool(false)
+string(0) ""
+bool(false)
+string(4) "abcd"
+string(2) "ef"
+string(5) "line
+"
+string(4) "rest"
+string(5) "HELLO"
+bool(false)
+string(0) ""
+bool(true)
@@ -0,0 +1,100 @@
+--TEST--
+event_relay_new() passes half closes on and reports EOF and errors once
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_relay_new")) print "skip Linux only";
+?>
+--FILE--
+<?php
+$base = event_base_new();
+
+function pair()
+{
+	$pair = stream_socket_pair(STREAM_PF_UNIX, STREAM_SOCK_STREAM, STREAM_IPPROTO_IP);
+	stream_set_blocking($pair[0], 0);
+	return $pair;
+}
+
+/* runs the loop until $len bytes or EOF arrived on $fp */
+function receive($base, $fp, $len)
+{
+	$data = "";
+	for ($i = 0; $i < 1000 && strlen($data) < $len && !feof($fp); $i++) {
+		event_base_loop($base, EVLOOP_NONBLOCK);
+		$data .= fread($fp, 65536);
+		usleep(1000);
+	}
+	return json_encode($data) . (feof($fp) ? " eof" : "");
+}
+
+$closed = function ($relay, $what, $stats, $arg) {
+	printf("%s: eof %d error %d, a_to_b %d b_to_a %d pending %d errno %d\n", $arg,
+		(bool)($what & EVBUFFER_EOF), (bool)($what & EVBUFFER_ERROR),
+		$stats["a_to_b"], $stats["b_to_a"], $stats["pending"], $stats["error"]);
+};
+
+list($client, $a) = pair();
+list($b, $server) = pair();
+stream_set_blocking($client, 0);
+stream_set_blocking($server, 0);
+
+/* what the stream layer buffered before the relay started goes out first */
+fwrite($client, "first\nsecond");
+usleep(10000);
+stream_set_blocking($a, 1);
+var_dump(fgets($a));
+$relay = event_relay_new($base, $a, $b, $closed, "relay");
+echo receive($base, $server, 6), "\n";
+
+fwrite($client, "hello");
+echo receive($base, $server, 5), "\n";
+fwrite($server, "world");
+echo receive($base, $client, 5), "\n";
+
+/* the client is done sending but still reads */
+stream_socket_shutdown($client, STREAM_SHUT_WR);
+echo receive($base, $server, 1), "\n";
+fwrite($server, "bye");
+echo receive($base, $client, 3), "\n";
+var_dump(event_relay_stats($relay));
+
+/* the callback runs once both directions saw EOF */
+stream_socket_shutdown($server, STREAM_SHUT_WR);
+echo receive($base, $client, 1), "\n";
+
+/* writing towards a closed peer ends the relay with an error */
+list($client, $a) = pair();
+list($b, $server) = pair();
+$relay = event_relay_new($base, $a, $b, $closed, "broken");
+fclose($client);
+fwrite($server, "lost");
+for ($i = 0; $i < 50; $i++) {
+	event_base_loop($base, EVLOOP_NONBLOCK);
+	usleep(1000);
+}
+event_relay_free($relay);
+echo "done\n";
+?>
+--EXPECT--
+string(6) "first
+"
+"second"
+"hello"
+"world"
+"" eof
+"bye"
+array(4) {
+  ["a_to_b"]=>
+  int(11)
+  ["b_to_a"]=>
+  int(8)
+  ["pending"]=>
+  int(0)
+  ["error"]=>
+  int(0)
+}
+relay: eof 1 error 0, a_to_b 11 b_to_a 8 pending 0 errno 0
+"" eof
+broken: eof 0 error 1, a_to_b 0 b_to_a 0 pending 4 errno 32
+done
@@ -0,0 +1,50 @@
+--TEST--
+event_signal_watch() delivers the signals pending at a wakeup in one call
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_signal_watch")) print "skip signalfd not supported";
+else if (!function_exists("posix_kill")) print "skip posix extension required";
+?>
+--FILE--
+<?php
+$base = event_base_new();
+$calls = array();
+
+$watcher = event_signal_watch($base, array(SIGUSR1, SIGUSR2), function ($watcher, $signals, $arg) use (&$calls, $base) {
+	$signos = array();
+	foreach ($signals as $signal) {
+		$signos[] = $signal["signo"] == SIGUSR1 ? "USR1" : "USR2";
+		if ($signal["pid"] != getmypid()) {
+			echo "wrong pid\n";
+		}
+	}
+	sort($signos);
+	$calls[] = $arg . ": " . implode(" ", $signos);
+	event_base_loopexit($base);
+}, "batch");
+
+/* raised before the loop runs, the second SIGUSR1 is merged with the first one */
+posix_kill(getmypid(), SIGUSR1);
+posix_kill(getmypid(), SIGUSR2);
+posix_kill(getmypid(), SIGUSR1);
+
+event_base_loop($base);
+var_dump($calls);
+var_dump(event_signal_watcher_stats($watcher));
+
+event_signal_watcher_free($watcher);
+echo "done\n";
+?>
+--EXPECT--
+array(1) {
+  [0]=>
+  string(16) "batch: USR1 USR2"
+}
+array(2) {
+  ["wakeups"]=>
+  int(1)
+  ["received"]=>
+  int(2)
+}
+done
@@ -0,0 +1,73 @@
+--TEST--
+event_supervisor_run() drains workers on SIGHUP and replaces them
+--SKIPIF--
+<?php
+if (!extension_loaded("libevent")) print "skip";
+else if (!function_exists("event_supervisor_run")) print "skip not supported on this platform";
+else if (!function_exists("posix_kill")) print "skip posix extension required";
+?>
+--FILE--
+<?php
+$log = tempnam(sys_get_temp_dir(), "supervisor");
+
+function worker_log($log, $line)
+{
+	file_put_contents($log, "$line\n", FILE_APPEND | LOCK_EX);
+}
+
+function worker_starts($log)
+{
+	return substr_count(file_get_contents($log), "start");
+}
+
+$base = event_base_new();
+
+$started = microtime(true);
+var_dump(event_supervisor_run($base, 2, function ($base, $listener, $worker, $log) {
+	worker_log($log, "start $worker");
+	register_shutdown_function("worker_log", $log, "exit $worker");
+
+	/* keeps the loop of every worker busy until it is told otherwise */
+	$poll = event_new();
+	event_timer_set($poll, function () use ($worker, $log, &$poll) {
+		$starts = worker_starts($log);
+
+		if ($worker == 0 && $starts == 2) {
+			/* the first generation is drained and replaced */
+			posix_kill(posix_getppid(), SIGHUP);
+		} else if ($worker == 0 && $starts == 4) {
+			posix_kill(posix_getppid(), SIGTERM);
+			return;
+		}
+		event_add($poll, 10000);
+	});
+	event_base_set($poll, $base);
+	event_add($poll, 10000);
+}, null, $log));
+$elapsed = microtime(true) - $started;
+
+$lines = file($log, FILE_IGNORE_NEW_LINES);
+sort($lines);
+var_dump($lines);
+
+/* workers living shorter than a second are respawned after a delay */
+var_dump($elapsed >= 1);
+unlink($log);
+?>
+--EXPECT--
+bool(true)
+array(6) {
+  [0]=>
+  string(6) "exit 0"
+  [1]=>
+  string(6) "exit 1"
+  [2]=>
+  string(7) "start 0"
+  [3]=>
+  string(7) "start 0"
+  [4]=>
+  string(7) "start 1"
+  [5]=>
+  string(7) "start 1"
+}
+bool(true)
@@ -0,0 +1,54 @@
+--TEST--
+event_timer_wheel_add(), event_timer_wheel_reset() and event_timer_wheel_cancel()
+--SKIPIF--
+<?php if (!extension_loaded("libevent")) print "skip"; ?>
+--FILE--
+<?php
+$base = event_base_new();
+$fired = array();
+
+$wheel = event_timer_wheel_new($base, 10000, 8, function ($expired, $wheel) use (&$fired) {
+	foreach ($expired as $handle => $name) {
+		$fired[] = $name;
+	}
+});
+
+$a = event_timer_wheel_add($wheel, 20000, "a");
+$b = event_timer_wheel_add($wheel, 50000, "b");
+$c = event_timer_wheel_add($wheel, 30000, "c");
+var_dump(is_int($a) && $a != $b && $b != $c);
+
+var_dump(event_timer_wheel_cancel($wheel, $c));
+var_dump(event_timer_wheel_cancel($wheel, $c));
+var_dump(event_timer_wheel_reset($wheel, $c, 10000));
+
+/* more than a turn of the wheel, the slot is passed once before it is due */
+$start = microtime(true);
+var_dump(event_timer_wheel_reset($wheel, $a, 150000));
+
+event_base_loop($base);
+$elapsed = microtime(true) - $start;
+
+var_dump($fired);
+/* never early, even when added in the middle of a tick */
+var_dump($elapsed >= 0.15);
+
+/* handles of expired timers are stale */
+var_dump(event_timer_wheel_cancel($wheel, $a));
+var_dump(event_timer_wheel_reset($wheel, $b, 10000));
+?>
+--EXPECT--
+bool(true)
+bool(true)
+bool(false)
+bool(false)
+bool(true)
+array(2) {
+  [0]=>
+  string(1) "b"
+  [1]=>
+  string(1) "a"
+}
+bool(true)
+bool(false)
+bool(false)